@@ -39,6 +39,14 @@ void Camera::updateEulerAngles(float xpos, float ypos) {
 	computeBasis();
 }
 
+void Camera::set_pose(const glm::vec3& pos, float newYaw, float newPitch) {
+	m_pos = pos;
+	yaw = newYaw;
+	pitch = newPitch;
+
+	computeBasis();
+}
+
 void Camera::computeBasis() {
 	// compute gaze direction using euler angles
 	m_gazeDir.x = cos(glm::radians(yaw)) * cos(glm::radians(pitch));
@@ -34,6 +34,21 @@ public:
 		return m_pos;
 	}
 
+	glm::vec3 get_gaze_dir() const {
+		return m_gazeDir;
+	}
+
+	float get_yaw() const {
+		return yaw;
+	}
+
+	float get_pitch() const {
+		return pitch;
+	}
+
+	// places the camera directly, used to replay recorded camera paths
+	void set_pose(const glm::vec3& pos, float newYaw, float newPitch);
+
 	void moveCameraPosition(CameraMoveFlags direction, float deltaTime);
 	void updateEulerAngles(float xpos, float ypos);
 
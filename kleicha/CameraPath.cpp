@@ -0,0 +1,78 @@
+#include "CameraPath.h"
+
+#pragma warning(push, 0)
+#pragma warning(disable : 6285 26498)
+#include "format.h"
+#pragma warning(pop)
+
+#include <algorithm>
+#include <cmath>
+#include <fstream>
+#include <sstream>
+#include <stdexcept>
+
+bool CameraPath::load(const std::string& path) {
+	std::ifstream ifstrm{ path };
+	if (!ifstrm.is_open())
+		return false;
+
+	m_keyframes.clear();
+	std::string line{};
+	while (std::getline(ifstrm, line)) {
+		if (line.empty() || line[0] == '#')
+			continue;
+
+		std::istringstream values{ line };
+		Keyframe keyframe{};
+		if (!(values >> keyframe.m_fTime >> keyframe.m_v3Position.x >> keyframe.m_v3Position.y >> keyframe.m_v3Position.z >> keyframe.m_fYaw >> keyframe.m_fPitch))
+			throw std::runtime_error{ "[Kleicha] Malformed camera path keyframe in " + path + ": " + line };
+
+		if (!m_keyframes.empty() && keyframe.m_fTime < m_keyframes.back().m_fTime)
+			throw std::runtime_error{ "[Kleicha] Camera path keyframes are out of order in " + path };
+
+		m_keyframes.push_back(keyframe);
+	}
+
+	fmt::println("[Kleicha] Loaded camera path {} with {} keyframes over {:.2f} s.", path, m_keyframes.size(), get_duration());
+	return !m_keyframes.empty();
+}
+
+void CameraPath::save(const std::string& path) const {
+	std::ofstream ofstrm{ path };
+	if (!ofstrm.is_open())
+		throw std::runtime_error{ "[Kleicha] Failed to open camera path output file: " + path };
+
+	ofstrm << "# time x y z yaw pitch\n";
+	for (const auto& keyframe : m_keyframes)
+		ofstrm << fmt::format("{:.4f} {:.4f} {:.4f} {:.4f} {:.4f} {:.4f}\n", keyframe.m_fTime, keyframe.m_v3Position.x, keyframe.m_v3Position.y,
+			keyframe.m_v3Position.z, keyframe.m_fYaw, keyframe.m_fPitch);
+
+	fmt::println("[Kleicha] Saved camera path with {} keyframes to {}.", m_keyframes.size(), path);
+}
+
+CameraPath::Keyframe CameraPath::sample(float time) const {
+	if (m_keyframes.size() < 2 || get_duration() <= 0.0f)
+		return m_keyframes.empty() ? Keyframe{} : m_keyframes.front();
+
+	time = std::fmod(time, get_duration());
+
+	// first keyframe after time, the keyframe before it starts the segment
+	auto next{ std::upper_bound(m_keyframes.begin(), m_keyframes.end(), time,
+		[](float t, const Keyframe& keyframe) { return t < keyframe.m_fTime; }) };
+	if (next == m_keyframes.begin())
+		return m_keyframes.front();
+	if (next == m_keyframes.end())
+		return m_keyframes.back();
+
+	const Keyframe& a{ *(next - 1) };
+	const Keyframe& b{ *next };
+	float segment{ b.m_fTime - a.m_fTime };
+	float t{ segment > 0.0f ? (time - a.m_fTime) / segment : 0.0f };
+
+	return Keyframe{
+		.m_fTime = time,
+		.m_v3Position = a.m_v3Position + (b.m_v3Position - a.m_v3Position) * t,
+		.m_fYaw = a.m_fYaw + (b.m_fYaw - a.m_fYaw) * t,
+		.m_fPitch = a.m_fPitch + (b.m_fPitch - a.m_fPitch) * t
+	};
+}
@@ -0,0 +1,47 @@
+#ifndef CAMERAPATH_H
+#define CAMERAPATH_H
+
+#include <glm/vec3.hpp>
+
+#include <string>
+#include <vector>
+
+// a camera path made of timed keyframes holding the camera position and its euler angles. paths are stored as text, one
+// keyframe per line: time x y z yaw pitch.
+class CameraPath {
+public:
+	struct Keyframe {
+		float m_fTime{};
+		glm::vec3 m_v3Position{};
+		float m_fYaw{};
+		float m_fPitch{};
+	};
+
+	bool load(const std::string& path);
+	void save(const std::string& path) const;
+
+	// keyframes must be added in time order
+	void add_keyframe(const Keyframe& keyframe) {
+		m_keyframes.push_back(keyframe);
+	}
+
+	// linearly interpolates between the keyframes around time, wrapping around once the path has ended
+	Keyframe sample(float time) const;
+
+	float get_duration() const {
+		return m_keyframes.empty() ? 0.0f : m_keyframes.back().m_fTime;
+	}
+
+	bool is_empty() const {
+		return m_keyframes.empty();
+	}
+
+	std::size_t get_keyframe_count() const {
+		return m_keyframes.size();
+	}
+
+private:
+	std::vector<Keyframe> m_keyframes{};
+};
+
+#endif // !CAMERAPATH_H
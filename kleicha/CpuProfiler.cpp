@@ -0,0 +1,139 @@
+#include "CpuProfiler.h"
+
+#pragma warning(push, 0)
+#pragma warning(disable : 6285 26498)
+#include "format.h"
+#pragma warning(pop)
+
+#include <algorithm>
+#include <array>
+#include <fstream>
+#include <limits>
+#include <memory>
+#include <mutex>
+#include <stdexcept>
+#include <vector>
+
+namespace {
+	struct Event {
+		const char* m_name{};
+		int64_t m_begin{};
+		int64_t m_end{};
+	};
+
+	// a seqlock per slot, the sequence is odd while the slot is written and 2 * (index + 1) once event index is complete.
+	// the fields are atomics so write_trace can copy slots the thread is overwriting, it drops those copies
+	struct Slot {
+		std::atomic<uint64_t> m_sequence{};
+		std::atomic<const char*> m_name{};
+		std::atomic<int64_t> m_begin{};
+		std::atomic<int64_t> m_end{};
+	};
+
+	// written only by its thread, the head is published after the event so a reader never sees an unwritten slot
+	struct ThreadRing {
+		uint32_t m_uiThreadId{};
+		std::string m_name{};
+		std::atomic<uint64_t> m_head{};
+		std::array<Slot, CpuProfiler::RING_CAPACITY> m_slots{};
+	};
+
+	// rings outlive their threads so that the zones of joined workers still end up in the trace
+	std::mutex g_ringsMutex{};
+	std::vector<std::unique_ptr<ThreadRing>> g_rings{};
+
+	thread_local ThreadRing* t_ring{};
+	// kept until the thread records its first zone, threads that never record while profiling don't get a ring
+	thread_local const char* t_threadName{};
+
+	// rings are only created by record, so they're only allocated once profiling has been enabled
+	ThreadRing* get_thread_ring() {
+		if (!t_ring) {
+			std::lock_guard<std::mutex> lock{ g_ringsMutex };
+			g_rings.push_back(std::make_unique<ThreadRing>());
+			t_ring = g_rings.back().get();
+			t_ring->m_uiThreadId = static_cast<uint32_t>(g_rings.size() - 1);
+			t_ring->m_name = t_threadName ? t_threadName : fmt::format("thread {}", t_ring->m_uiThreadId);
+		}
+		return t_ring;
+	}
+}
+
+void CpuProfiler::set_thread_name(const char* name) {
+	t_threadName = name;
+	if (t_ring) {
+		std::lock_guard<std::mutex> lock{ g_ringsMutex };
+		t_ring->m_name = name;
+	}
+}
+
+void CpuProfiler::record(const char* name, int64_t begin, int64_t end) {
+	ThreadRing* ring{ get_thread_ring() };
+	uint64_t head{ ring->m_head.load(std::memory_order_relaxed) };
+	Slot& slot{ ring->m_slots[head % RING_CAPACITY] };
+	slot.m_sequence.store(2 * head + 1, std::memory_order_relaxed);
+	std::atomic_thread_fence(std::memory_order_release);
+	slot.m_name.store(name, std::memory_order_relaxed);
+	slot.m_begin.store(begin, std::memory_order_relaxed);
+	slot.m_end.store(end, std::memory_order_relaxed);
+	slot.m_sequence.store(2 * (head + 1), std::memory_order_release);
+	ring->m_head.store(head + 1, std::memory_order_release);
+}
+
+void CpuProfiler::write_trace(const std::string& path) {
+	struct ThreadEvents {
+		uint32_t m_uiThreadId{};
+		std::string m_name{};
+		std::vector<Event> m_events{};
+	};
+
+	std::vector<ThreadEvents> threads{};
+	int64_t traceStart{ std::numeric_limits<int64_t>::max() };
+	std::size_t eventCount{};
+	{
+		std::lock_guard<std::mutex> lock{ g_ringsMutex };
+		for (const auto& ring : g_rings) {
+			ThreadEvents& thread{ threads.emplace_back(ThreadEvents{ .m_uiThreadId = ring->m_uiThreadId, .m_name = ring->m_name }) };
+
+			uint64_t head{ ring->m_head.load(std::memory_order_acquire) };
+			uint64_t first{ head > RING_CAPACITY ? head - RING_CAPACITY : 0 };
+			for (uint64_t i{ first }; i < head; ++i) {
+				const Slot& slot{ ring->m_slots[i % RING_CAPACITY] };
+				uint64_t sequence{ slot.m_sequence.load(std::memory_order_acquire) };
+				Event event{ .m_name = slot.m_name.load(std::memory_order_relaxed), .m_begin = slot.m_begin.load(std::memory_order_relaxed),
+					.m_end = slot.m_end.load(std::memory_order_relaxed) };
+				std::atomic_thread_fence(std::memory_order_acquire);
+
+				// the thread wrapped around onto this slot while it was copied, the event is dropped
+				if (sequence != 2 * (i + 1) || slot.m_sequence.load(std::memory_order_relaxed) != sequence)
+					continue;
+				thread.m_events.push_back(event);
+			}
+
+			for (const auto& event : thread.m_events)
+				traceStart = std::min(traceStart, event.m_begin);
+			eventCount += thread.m_events.size();
+		}
+	}
+
+	std::ofstream ofstrm{ path };
+	if (!ofstrm.is_open())
+		throw std::runtime_error{ "[CpuProfiler] Failed to open trace output file: " + path };
+
+	// complete events in microseconds, nested zones of a thread are stacked by their time ranges
+	ofstrm << "{\"displayTimeUnit\":\"ms\",\"traceEvents\":[\n";
+	bool firstEvent{ true };
+	for (const auto& thread : threads) {
+		ofstrm << fmt::format("{}{{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":0,\"tid\":{},\"args\":{{\"name\":\"{}\"}}}}",
+			firstEvent ? "" : ",\n", thread.m_uiThreadId, thread.m_name);
+		firstEvent = false;
+
+		for (const auto& event : thread.m_events) {
+			ofstrm << fmt::format(",\n{{\"name\":\"{}\",\"ph\":\"X\",\"pid\":0,\"tid\":{},\"ts\":{:.3f},\"dur\":{:.3f}}}", event.m_name, thread.m_uiThreadId,
+				static_cast<double>(event.m_begin - traceStart) / 1000.0, static_cast<double>(event.m_end - event.m_begin) / 1000.0);
+		}
+	}
+	ofstrm << "\n]}\n";
+
+	fmt::println("[CpuProfiler] Wrote {} zones from {} threads to {}.", eventCount, threads.size(), path);
+}
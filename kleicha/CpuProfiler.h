@@ -0,0 +1,72 @@
+#ifndef CPUPROFILER_H
+#define CPUPROFILER_H
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <string>
+
+// records named cpu zones and writes them as a chrome://tracing / perfetto json trace. every thread records into its own
+// ring, so recording a zone takes no locks and the oldest zones are overwritten once a ring is full. while the profiler is
+// disabled a zone costs a relaxed load. zone names must be string literals, only the pointer is stored.
+class CpuProfiler {
+public:
+	// zones kept per thread
+	static constexpr uint32_t RING_CAPACITY{ 1 << 16 };
+
+	class Zone {
+	public:
+		explicit Zone(const char* name)
+			: m_name{ CpuProfiler::is_enabled() ? name : nullptr } {
+			if (m_name)
+				m_begin = CpuProfiler::now();
+		}
+
+		~Zone() {
+			if (m_name)
+				CpuProfiler::record(m_name, m_begin, CpuProfiler::now());
+		}
+
+		Zone(const Zone&) = delete;
+		Zone& operator=(const Zone&) = delete;
+
+	private:
+		const char* m_name{};
+		int64_t m_begin{};
+	};
+
+	static void set_enabled(bool enabled) {
+		s_bEnabled.store(enabled, std::memory_order_relaxed);
+	}
+
+	static bool is_enabled() {
+		return s_bEnabled.load(std::memory_order_relaxed);
+	}
+
+	// names the calling thread in the trace
+	static void set_thread_name(const char* name);
+
+	// writes the zones every thread has recorded so far, threads may keep recording while the trace is written
+	static void write_trace(const std::string& path);
+
+private:
+	static inline std::atomic<bool> s_bEnabled{ false };
+
+	static int64_t now() {
+		return std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now().time_since_epoch()).count();
+	}
+
+	static void record(const char* name, int64_t begin, int64_t end);
+};
+
+#define CPU_PROFILER_CONCAT_IMPL(a, b) a##b
+#define CPU_PROFILER_CONCAT(a, b) CPU_PROFILER_CONCAT_IMPL(a, b)
+
+// times the rest of the enclosing block, defining KLEICHA_NO_PROFILER compiles every zone out
+#ifdef KLEICHA_NO_PROFILER
+#define PROFILE_ZONE(name)
+#else
+#define PROFILE_ZONE(name) CpuProfiler::Zone CPU_PROFILER_CONCAT(profileZone, __LINE__){ name }
+#endif
+
+#endif // !CPUPROFILER_H
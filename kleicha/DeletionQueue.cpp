@@ -0,0 +1,83 @@
+#include "DeletionQueue.h"
+#include "Utils.h"
+
+#include <cassert>
+
+void DeletionQueue::init(VkDevice device, MemoryTracker* memoryTracker) {
+	m_device = device;
+	m_memoryTracker = memoryTracker;
+}
+
+void DeletionQueue::push(uint32_t frameNumber, const vkt::Buffer& buffer) {
+	push(Entry{ .m_uiFrameNumber = frameNumber, .m_type = Type::BUFFER, .m_buffer = buffer });
+}
+
+void DeletionQueue::push(uint32_t frameNumber, const vkt::Image& image) {
+	push(Entry{ .m_uiFrameNumber = frameNumber, .m_type = Type::IMAGE, .m_image = image });
+}
+
+void DeletionQueue::push(uint32_t frameNumber, VkImageView imageView) {
+	push(Entry{ .m_uiFrameNumber = frameNumber, .m_type = Type::IMAGE_VIEW, .m_imageView = imageView });
+}
+
+void DeletionQueue::push(uint32_t frameNumber, VkPipeline pipeline) {
+	push(Entry{ .m_uiFrameNumber = frameNumber, .m_type = Type::PIPELINE, .m_pipeline = pipeline });
+}
+
+void DeletionQueue::push(uint32_t frameNumber, VmaAllocation allocation) {
+	push(Entry{ .m_uiFrameNumber = frameNumber, .m_type = Type::ALLOCATION, .m_allocation = allocation });
+}
+
+void DeletionQueue::push(uint32_t frameNumber, VkDescriptorPool descriptorPool, VkDescriptorSet descriptorSet) {
+	push(Entry{ .m_uiFrameNumber = frameNumber, .m_type = Type::DESCRIPTOR_SET, .m_descriptorPool = descriptorPool, .m_descriptorSet = descriptorSet });
+}
+
+void DeletionQueue::push(Entry entry) {
+	// keeps the queue sorted by frame so that flushing only ever looks at the front
+	assert(m_entries.empty() || m_entries.back().m_uiFrameNumber <= entry.m_uiFrameNumber);
+	m_entries.push_back(entry);
+}
+
+std::size_t DeletionQueue::flush(uint32_t completedFrame) {
+	std::size_t destroyed{};
+	while (!m_entries.empty() && m_entries.front().m_uiFrameNumber <= completedFrame) {
+		destroy(m_entries.front());
+		m_entries.pop_front();
+		++destroyed;
+	}
+	return destroyed;
+}
+
+std::size_t DeletionQueue::flush_all() {
+	std::size_t destroyed{ m_entries.size() };
+	for (const auto& entry : m_entries)
+		destroy(entry);
+
+	m_entries.clear();
+	return destroyed;
+}
+
+void DeletionQueue::destroy(const Entry& entry) const {
+	switch (entry.m_type) {
+	case Type::BUFFER:
+		m_memoryTracker->destroy(entry.m_buffer);
+		break;
+	case Type::IMAGE:
+		if (entry.m_image.imageView)
+			vkDestroyImageView(m_device, entry.m_image.imageView, nullptr);
+		m_memoryTracker->destroy(entry.m_image);
+		break;
+	case Type::IMAGE_VIEW:
+		vkDestroyImageView(m_device, entry.m_imageView, nullptr);
+		break;
+	case Type::PIPELINE:
+		vkDestroyPipeline(m_device, entry.m_pipeline, nullptr);
+		break;
+	case Type::ALLOCATION:
+		m_memoryTracker->free(entry.m_allocation);
+		break;
+	case Type::DESCRIPTOR_SET:
+		VK_CHECK(vkFreeDescriptorSets(m_device, entry.m_descriptorPool, 1, &entry.m_descriptorSet));
+		break;
+	}
+}
@@ -0,0 +1,65 @@
+#ifndef DELETIONQUEUE_H
+#define DELETIONQUEUE_H
+
+#include "Types.h"
+#include "MemoryTracker.h"
+
+#include <deque>
+
+// defers destroying resources until the frames that may still use them have completed. a resource is queued with the
+// number of the last frame that may use it and destroyed by the first flush that finds that frame completed. buffers and
+// images are destroyed through the memory tracker so their allocations leave its categories.
+class DeletionQueue {
+public:
+	void init(VkDevice device, MemoryTracker* memoryTracker);
+
+	// frame numbers must not decrease from one push to the next. an image's view is destroyed along with it.
+	void push(uint32_t frameNumber, const vkt::Buffer& buffer);
+	void push(uint32_t frameNumber, const vkt::Image& image);
+	void push(uint32_t frameNumber, VkImageView imageView);
+	void push(uint32_t frameNumber, VkPipeline pipeline);
+	// memory resources were bound to, queue those resources before it so that they are destroyed first
+	void push(uint32_t frameNumber, VmaAllocation allocation);
+	// the pool must have been created with VK_DESCRIPTOR_POOL_CREATE_FREE_DESCRIPTOR_SET_BIT
+	void push(uint32_t frameNumber, VkDescriptorPool descriptorPool, VkDescriptorSet descriptorSet);
+
+	// destroys everything queued for frames up to and including completedFrame, returns the number of resources destroyed
+	std::size_t flush(uint32_t completedFrame);
+	// destroys everything, only once the device is idle
+	std::size_t flush_all();
+
+	std::size_t size() const {
+		return m_entries.size();
+	}
+
+private:
+	enum class Type {
+		BUFFER,
+		IMAGE,
+		IMAGE_VIEW,
+		PIPELINE,
+		ALLOCATION,
+		DESCRIPTOR_SET
+	};
+
+	struct Entry {
+		uint32_t m_uiFrameNumber{};
+		Type m_type{};
+		vkt::Buffer m_buffer{};
+		vkt::Image m_image{};
+		VkImageView m_imageView{};
+		VkPipeline m_pipeline{};
+		VmaAllocation m_allocation{};
+		VkDescriptorPool m_descriptorPool{};
+		VkDescriptorSet m_descriptorSet{};
+	};
+
+	VkDevice m_device{};
+	MemoryTracker* m_memoryTracker{};
+	std::deque<Entry> m_entries{};
+
+	void push(Entry entry);
+	void destroy(const Entry& entry) const;
+};
+
+#endif // !DELETIONQUEUE_H
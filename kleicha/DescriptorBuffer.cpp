@@ -0,0 +1,88 @@
+#include "DescriptorBuffer.h"
+#include "Utils.h"
+
+#include <algorithm>
+#include <cassert>
+#include <cstddef>
+
+void DescriptorBuffer::init(const vkt::Device& device, VmaAllocator allocator, MemoryTracker* memoryTracker) {
+	m_device = device.device;
+	m_allocator = allocator;
+	m_memoryTracker = memoryTracker;
+
+	// extension entry points aren't exported by the loader
+	m_pfnGetLayoutSize = reinterpret_cast<PFN_vkGetDescriptorSetLayoutSizeEXT>(vkGetDeviceProcAddr(m_device, "vkGetDescriptorSetLayoutSizeEXT"));
+	m_pfnGetBindingOffset = reinterpret_cast<PFN_vkGetDescriptorSetLayoutBindingOffsetEXT>(vkGetDeviceProcAddr(m_device, "vkGetDescriptorSetLayoutBindingOffsetEXT"));
+	m_pfnGetDescriptor = reinterpret_cast<PFN_vkGetDescriptorEXT>(vkGetDeviceProcAddr(m_device, "vkGetDescriptorEXT"));
+	m_pfnCmdBindBuffers = reinterpret_cast<PFN_vkCmdBindDescriptorBuffersEXT>(vkGetDeviceProcAddr(m_device, "vkCmdBindDescriptorBuffersEXT"));
+	m_pfnCmdSetOffsets = reinterpret_cast<PFN_vkCmdSetDescriptorBufferOffsetsEXT>(vkGetDeviceProcAddr(m_device, "vkCmdSetDescriptorBufferOffsetsEXT"));
+	if (!m_pfnGetLayoutSize || !m_pfnGetBindingOffset || !m_pfnGetDescriptor || !m_pfnCmdBindBuffers || !m_pfnCmdSetOffsets)
+		throw std::runtime_error{ "[DescriptorBuffer] Failed to load the VK_EXT_descriptor_buffer entry points." };
+
+	VkPhysicalDeviceProperties2 properties{ .sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_PROPERTIES_2, .pNext = &m_properties };
+	vkGetPhysicalDeviceProperties2(device.physicalDevice.device, &properties);
+}
+
+void DescriptorBuffer::create(VkDescriptorSetLayout setLayout) {
+	m_setLayout = setLayout;
+	m_pfnGetLayoutSize(m_device, m_setLayout, &m_layoutSize);
+
+	// written by the host and read by the device, so device local memory is only used when it's mappable
+	m_buffer = utils::create_buffer(m_allocator, m_layoutSize, VK_BUFFER_USAGE_SAMPLER_DESCRIPTOR_BUFFER_BIT_EXT | VK_BUFFER_USAGE_SHADER_DEVICE_ADDRESS_BIT,
+		VMA_MEMORY_USAGE_AUTO_PREFER_DEVICE, VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT, VMA_ALLOCATION_CREATE_HOST_ACCESS_SEQUENTIAL_WRITE_BIT | VMA_ALLOCATION_CREATE_MAPPED_BIT);
+	m_memoryTracker->track(m_buffer, MemoryTracker::DESCRIPTORS, "descriptor_buffer");
+	m_buffer.deviceAddress = utils::get_buffer_device_address(m_device, m_buffer.buffer);
+	assert(m_buffer.deviceAddress % m_properties.descriptorBufferOffsetAlignment == 0);
+
+	fmt::println("[DescriptorBuffer] Created a {:.2f} KiB descriptor buffer, {} bytes per combined image sampler.",
+		static_cast<double>(m_layoutSize) / 1024.0, m_properties.combinedImageSamplerDescriptorSize);
+}
+
+void DescriptorBuffer::destroy() {
+	if (m_buffer.buffer)
+		m_memoryTracker->destroy(m_buffer);
+	m_buffer = {};
+}
+
+void DescriptorBuffer::write_combined_image_sampler(uint32_t binding, uint32_t arrayElement, VkSampler sampler, VkImageView imageView, VkImageLayout imageLayout) {
+	VkDeviceSize bindingOffset{};
+	m_pfnGetBindingOffset(m_device, m_setLayout, binding, &bindingOffset);
+
+	std::size_t descriptorSize{ m_properties.combinedImageSamplerDescriptorSize };
+	VkDeviceSize offset{ bindingOffset + arrayElement * descriptorSize };
+	assert(offset + descriptorSize <= m_layoutSize);
+
+	VkDescriptorImageInfo imageInfo{ .sampler = sampler, .imageView = imageView, .imageLayout = imageLayout };
+	VkDescriptorGetInfoEXT getInfo{ .sType = VK_STRUCTURE_TYPE_DESCRIPTOR_GET_INFO_EXT };
+	getInfo.type = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
+	getInfo.data.pCombinedImageSampler = &imageInfo;
+	m_pfnGetDescriptor(m_device, &getInfo, descriptorSize, static_cast<std::byte*>(m_buffer.allocationInfo.pMappedData) + offset);
+
+	m_dirtyBegin = std::min(m_dirtyBegin, offset);
+	m_dirtyEnd = std::max(m_dirtyEnd, offset + descriptorSize);
+}
+
+void DescriptorBuffer::flush() {
+	if (m_dirtyBegin >= m_dirtyEnd)
+		return;
+
+	// a no-op on host coherent memory
+	VK_CHECK(vmaFlushAllocation(m_allocator, m_buffer.allocation, m_dirtyBegin, m_dirtyEnd - m_dirtyBegin));
+	m_dirtyBegin = VK_WHOLE_SIZE;
+	m_dirtyEnd = 0;
+}
+
+void DescriptorBuffer::bind(VkCommandBuffer cmdBuffer, VkPipelineLayout pipelineLayout, uint32_t set) const {
+	VkDescriptorBufferBindingInfoEXT bindingInfo{ .sType = VK_STRUCTURE_TYPE_DESCRIPTOR_BUFFER_BINDING_INFO_EXT };
+	bindingInfo.address = m_buffer.deviceAddress;
+	bindingInfo.usage = VK_BUFFER_USAGE_SAMPLER_DESCRIPTOR_BUFFER_BIT_EXT;
+	m_pfnCmdBindBuffers(cmdBuffer, 1, &bindingInfo);
+
+	uint32_t bufferIndex{ 0 };
+	VkDeviceSize offset{ 0 };
+	m_pfnCmdSetOffsets(cmdBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, pipelineLayout, set, 1, &bufferIndex, &offset);
+}
+
+uint32_t DescriptorBuffer::get_max_combined_image_samplers() const {
+	return static_cast<uint32_t>(m_properties.maxSamplerDescriptorBufferRange / m_properties.combinedImageSamplerDescriptorSize);
+}
@@ -0,0 +1,52 @@
+#ifndef DESCRIPTORBUFFER_H
+#define DESCRIPTORBUFFER_H
+
+#include "Types.h"
+#include "MemoryTracker.h"
+
+// VK_EXT_descriptor_buffer backend for a single descriptor set. descriptors are fetched from the driver with vkGetDescriptorEXT
+// and copied straight into persistently mapped memory at the offsets the set layout defines, the set is bound by the buffer's
+// address instead of from a pool. like update after bind, slots that no frame in flight samples may be rewritten at any time.
+class DescriptorBuffer {
+public:
+	// the device must have VK_EXT_descriptor_buffer and its descriptorBuffer feature enabled
+	void init(const vkt::Device& device, VmaAllocator allocator, MemoryTracker* memoryTracker);
+	// the layout must have been created with VK_DESCRIPTOR_SET_LAYOUT_CREATE_DESCRIPTOR_BUFFER_BIT_EXT
+	void create(VkDescriptorSetLayout setLayout);
+	void destroy();
+
+	// descriptors become visible to the device with the next flush
+	void write_combined_image_sampler(uint32_t binding, uint32_t arrayElement, VkSampler sampler, VkImageView imageView, VkImageLayout imageLayout);
+	void flush();
+
+	// binds the buffer as the given set, pipelines using it must have been created with VK_PIPELINE_CREATE_DESCRIPTOR_BUFFER_BIT_EXT
+	void bind(VkCommandBuffer cmdBuffer, VkPipelineLayout pipelineLayout, uint32_t set) const;
+
+	VkDeviceSize get_size() const {
+		return m_layoutSize;
+	}
+
+	// upper bound of the combined image samplers a single bound buffer can address
+	uint32_t get_max_combined_image_samplers() const;
+
+private:
+	VkDevice m_device{};
+	VmaAllocator m_allocator{};
+	MemoryTracker* m_memoryTracker{};
+	VkPhysicalDeviceDescriptorBufferPropertiesEXT m_properties{ .sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_DESCRIPTOR_BUFFER_PROPERTIES_EXT };
+
+	PFN_vkGetDescriptorSetLayoutSizeEXT m_pfnGetLayoutSize{};
+	PFN_vkGetDescriptorSetLayoutBindingOffsetEXT m_pfnGetBindingOffset{};
+	PFN_vkGetDescriptorEXT m_pfnGetDescriptor{};
+	PFN_vkCmdBindDescriptorBuffersEXT m_pfnCmdBindBuffers{};
+	PFN_vkCmdSetDescriptorBufferOffsetsEXT m_pfnCmdSetOffsets{};
+
+	VkDescriptorSetLayout m_setLayout{};
+	VkDeviceSize m_layoutSize{};
+	vkt::Buffer m_buffer{};
+	// byte range written since the last flush
+	VkDeviceSize m_dirtyBegin{ VK_WHOLE_SIZE };
+	VkDeviceSize m_dirtyEnd{};
+};
+
+#endif // !DESCRIPTORBUFFER_H
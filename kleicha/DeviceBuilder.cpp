@@ -11,13 +11,43 @@ vkt::Device DeviceBuilder::build() {
 	queueInfo.queueCount = 1;
 	queueInfo.pQueuePriorities = &queuePriority;
 
+	// enable the optional core features the selected device supports, walked as a VkBool32 array like check_features_struct
+	VkPhysicalDeviceFeatures supportedCoreFeatures{};
+	vkGetPhysicalDeviceFeatures(physicalDevice.device, &supportedCoreFeatures);
+	const VkBool32* pOptional{ reinterpret_cast<const VkBool32*>(&m_optionalFeatures) };
+	const VkBool32* pSupported{ reinterpret_cast<const VkBool32*>(&supportedCoreFeatures) };
+	VkBool32* pEnabled{ reinterpret_cast<VkBool32*>(&m_requestedFeatures.VkFeatures.features) };
+	for (std::size_t i{ 0 }; i < sizeof(VkPhysicalDeviceFeatures) / sizeof(VkBool32); ++i) {
+		if (pOptional[i] && pSupported[i])
+			pEnabled[i] = VK_TRUE;
+	}
+
+	// add the optional extensions the selected device supports, their feature structs are chained in front of the requested features
+	std::vector<const char*> extensions{ m_extensions };
+	void* pNext{ &m_requestedFeatures.VkFeatures };
+	for (const auto& optionalExtensions : m_optionalExtensions) {
+		if (!are_extensions_supported(physicalDevice.device, optionalExtensions.extensions))
+			continue;
+
+		extensions.insert(extensions.end(), optionalExtensions.extensions.begin(), optionalExtensions.extensions.end());
+
+		if (optionalExtensions.pFeatures) {
+			VkBaseOutStructure* pFeatures{ static_cast<VkBaseOutStructure*>(optionalExtensions.pFeatures) };
+			pFeatures->pNext = nullptr;
+			VkPhysicalDeviceFeatures2 supportedFeatures{ .sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_FEATURES_2, .pNext = pFeatures };
+			vkGetPhysicalDeviceFeatures2(physicalDevice.device, &supportedFeatures);
+			pFeatures->pNext = static_cast<VkBaseOutStructure*>(pNext);
+			pNext = pFeatures;
+		}
+	}
+
 	// create logical device along with the queues detailed above
 	VkDeviceCreateInfo deviceInfo{ .sType = VK_STRUCTURE_TYPE_DEVICE_CREATE_INFO };
-	deviceInfo.pNext = &m_requestedFeatures.VkFeatures;
+	deviceInfo.pNext = pNext;
 	deviceInfo.queueCreateInfoCount = 1;
 	deviceInfo.pQueueCreateInfos = &queueInfo;
-	deviceInfo.enabledExtensionCount = static_cast<uint32_t>(m_extensions.size());
-	deviceInfo.ppEnabledExtensionNames = m_extensions.data();
+	deviceInfo.enabledExtensionCount = static_cast<uint32_t>(extensions.size());
+	deviceInfo.ppEnabledExtensionNames = extensions.data();
 	deviceInfo.pEnabledFeatures = nullptr; // we are using VkPhysicalDeviceFeatures2
 
 	VkDevice device{};
@@ -29,13 +59,18 @@ vkt::Device DeviceBuilder::build() {
 	VkQueue queue{};
 	vkGetDeviceQueue(device, physicalDevice.queueFamilyIndex, 0, &queue);
 
-	return vkt::Device{ .physicalDevice = physicalDevice, .device = device, .queue = queue };
+	return vkt::Device{ .physicalDevice = physicalDevice, .device = device, .queue = queue, .enabledExtensions = { extensions.begin(), extensions.end() },
+		.enabledFeatures = m_requestedFeatures.VkFeatures.features };
 }
 
 // checks if the device supports the requested extensions
 bool DeviceBuilder::are_extensions_supported(VkPhysicalDevice device) const {
+	return are_extensions_supported(device, m_extensions);
+}
+
+bool DeviceBuilder::are_extensions_supported(VkPhysicalDevice device, const std::vector<const char*>& extensions) const {
 
-	if (m_extensions.size() == 0)
+	if (extensions.size() == 0)
 		return true;
 
 	uint32_t extensionsCount{};
@@ -43,7 +78,7 @@ bool DeviceBuilder::are_extensions_supported(VkPhysicalDevice device) const {
 	std::vector<VkExtensionProperties> extensionProperties(extensionsCount);
 	VK_CHECK(vkEnumerateDeviceExtensionProperties(device, nullptr, &extensionsCount, extensionProperties.data()));
 
-	for (const auto& requestedExtension : m_extensions) {
+	for (const auto& requestedExtension : extensions) {
 		bool extensionFound{ false };
 		for (const auto& extensionProperty : extensionProperties) {
 			if (strcmp(requestedExtension, extensionProperty.extensionName) == 0) {
@@ -104,6 +139,10 @@ std::optional<uint32_t> DeviceBuilder::get_queue_family(VkPhysicalDevice device)
 	// we're going to avoid using separate queue families for graphics, transfer, and presentation. Compute support is guaranteed if graphics commands are supported
 	for (uint32_t i{ 0 }; i < queueFamilyProperties.size(); ++i) {
 		if (queueFamilyProperties[i].queueFlags & VK_QUEUE_GRAPHICS_BIT && queueFamilyProperties[i].queueFlags & VK_QUEUE_TRANSFER_BIT) {
+			// headless rendering never presents
+			if (!m_surface)
+				return i;
+
 			// check for presentation support
 			VkBool32 presentSupported{ VK_FALSE };
 			VK_CHECK(vkGetPhysicalDeviceSurfaceSupportKHR(device, i, m_surface, &presentSupported));
@@ -141,6 +180,22 @@ std::optional<vkt::SurfaceSupportDetails> DeviceBuilder::get_surface_support_det
 	return vkt::SurfaceSupportDetails{ .capabilities = surfaceCapabilities, .formats = surfaceFormats, .presentModes = presentModes };
 }
 
+// higher is preferred
+static uint32_t device_type_rank(VkPhysicalDeviceType deviceType) {
+	switch (deviceType) {
+		case VK_PHYSICAL_DEVICE_TYPE_DISCRETE_GPU:
+			return 4;
+		case VK_PHYSICAL_DEVICE_TYPE_INTEGRATED_GPU:
+			return 3;
+		case VK_PHYSICAL_DEVICE_TYPE_VIRTUAL_GPU:
+			return 2;
+		case VK_PHYSICAL_DEVICE_TYPE_CPU:
+			return 1;
+		default:
+			return 0;
+	}
+}
+
 vkt::PhysicalDevice DeviceBuilder::select_physical_device(VkInstance instance) const {
 
 	// get all physical devices supported by the implementation
@@ -154,8 +209,10 @@ vkt::PhysicalDevice DeviceBuilder::select_physical_device(VkInstance instance) c
 	VK_CHECK(vkEnumeratePhysicalDevices(instance, &deviceCount, devices.data()));
 
 	bool foundCompatibleDevice{ false };
+	uint32_t selectedRank{ 0 };
 	vkt::PhysicalDevice physicalDevice{};
-	// traverse physical devices and find one that is discrete and supports the requested extensions and features
+	// traverse physical devices and find one that is discrete and supports the requested extensions and features. without a surface
+	// any device type is accepted, including software implementations like lavapipe, but the highest ranked type is still preferred.
 	for (const auto& device : devices) {
 		// get device properties -- using physical device properties 2 here as we plan to use ray tracing in the future and will need to check for ext feature support.
 		VkPhysicalDeviceProperties2 deviceProperties{ .sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_PROPERTIES_2 };
@@ -164,9 +221,11 @@ vkt::PhysicalDevice DeviceBuilder::select_physical_device(VkInstance instance) c
 		// attempt to get a queue family index that supports graphics, compute, transfer, and presentation
 		std::optional<uint32_t> queueFamilyIndex{ get_queue_family(device) };
 		// attempt to get physical device surface support details
-		std::optional<vkt::SurfaceSupportDetails> surfaceSupportDetails{ get_surface_support_details(device) };
+		std::optional<vkt::SurfaceSupportDetails> surfaceSupportDetails{ m_surface ? get_surface_support_details(device) : vkt::SurfaceSupportDetails{} };
 
-		if (deviceProperties.properties.deviceType == VK_PHYSICAL_DEVICE_TYPE_DISCRETE_GPU)
+		uint32_t rank{ device_type_rank(deviceProperties.properties.deviceType) };
+		bool acceptedType{ m_surface ? deviceProperties.properties.deviceType == VK_PHYSICAL_DEVICE_TYPE_DISCRETE_GPU : true };
+		if (acceptedType && (!foundCompatibleDevice || rank > selectedRank))
 		{
 			// check for graphics, transfer, compute, and presentation queue family support
 			if (!queueFamilyIndex.has_value())
@@ -184,18 +243,19 @@ vkt::PhysicalDevice DeviceBuilder::select_physical_device(VkInstance instance) c
 			if (!are_features_supported(device))
 				continue;
 
-			// physical device passed all checks, encapsulate all data and return to caller as this is the physical device we'll be using
+			// physical device passed all checks, encapsulate all data. it's the device we'll be using unless a higher ranked one follows
 			foundCompatibleDevice = true;
+			selectedRank = rank;
 			physicalDevice.device = device;
 			physicalDevice.deviceProperties = deviceProperties;
 			physicalDevice.queueFamilyIndex = queueFamilyIndex.value();
 			physicalDevice.surfaceSupportDetails = surfaceSupportDetails.value();
-			fmt::println("[DeviceBuilder] Physical device selected: {0}", physicalDevice.deviceProperties.properties.deviceName);
-			break;
 		}
 	}
 	if (!foundCompatibleDevice)
 		throw std::runtime_error{ "[DeviceBuilder] Failed to find a compatible physical device." };
 
+	fmt::println("[DeviceBuilder] Physical device selected: {0}", physicalDevice.deviceProperties.properties.deviceName);
+
 	return physicalDevice;
 }
\ No newline at end of file
@@ -22,13 +22,34 @@ public:
 		return *this;
 	}
 
+	// enabled only if the selected device supports every extension of the group, a physical device is never rejected over them.
+	// the optional feature struct is filled with what the device supports and enabled as is, it must outlive build().
+	DeviceBuilder& request_optional_extensions(const std::vector<const char*>& extensions, void* pFeatures = nullptr) {
+		m_optionalExtensions.push_back(OptionalExtensions{ .extensions = extensions, .pFeatures = pFeatures });
+		return *this;
+	}
+
+	// core features enabled only where the selected device supports them, the result is reported in vkt::Device::enabledFeatures
+	DeviceBuilder& request_optional_features(const VkPhysicalDeviceFeatures& features) {
+		m_optionalFeatures = features;
+		return *this;
+	}
+
 	std::optional<vkt::SurfaceSupportDetails> get_surface_support_details(VkPhysicalDevice device) const;
 private:
+	struct OptionalExtensions {
+		std::vector<const char*> extensions{};
+		void* pFeatures{};
+	};
+
 	std::vector<const char*> m_extensions{};
+	std::vector<OptionalExtensions> m_optionalExtensions{};
 	vkt::DeviceFeatures m_requestedFeatures{};
+	VkPhysicalDeviceFeatures m_optionalFeatures{};
 	VkInstance m_instance{};
 	VkSurfaceKHR m_surface{};
 	bool are_extensions_supported(VkPhysicalDevice device) const;
+	bool are_extensions_supported(VkPhysicalDevice device, const std::vector<const char*>& extensions) const;
 	bool are_features_supported(VkPhysicalDevice device) const;
 	std::optional<uint32_t> get_queue_family(VkPhysicalDevice device) const;
 	bool check_features_struct(const VkBool32* p_reqFeaturesStart, const VkBool32* p_reqFeaturesEnd, const VkBool32* p_DeviceFeaturesStart) const;
@@ -0,0 +1,33 @@
+#include "DynamicResolution.h"
+
+#include <algorithm>
+#include <cmath>
+
+void DynamicResolution::init(float targetFrameTime) {
+	m_fTargetFrameTime = targetFrameTime;
+	m_fScale = MAX_SCALE;
+	m_fFullResolutionTime = 0.0f;
+}
+
+void DynamicResolution::record_frame(float gpuFrameTime, float renderScale) {
+	if (gpuFrameTime <= 0.0f || renderScale <= 0.0f || m_fTargetFrameTime <= 0.0f)
+		return;
+
+	float fullResolutionTime{ gpuFrameTime / (renderScale * renderScale) };
+	m_fFullResolutionTime = m_fFullResolutionTime == 0.0f ? fullResolutionTime : m_fFullResolutionTime + (fullResolutionTime - m_fFullResolutionTime) * SMOOTHING;
+
+	// the frame time the estimate predicts at the current scale
+	float predictedTime{ m_fFullResolutionTime * m_fScale * m_fScale };
+	if (std::abs(predictedTime - m_fTargetFrameTime) <= m_fTargetFrameTime * DEAD_BAND)
+		return;
+
+	float desiredScale{ std::clamp(std::sqrt(m_fTargetFrameTime / m_fFullResolutionTime), MIN_SCALE, MAX_SCALE) };
+	m_fScale += std::clamp(desiredScale - m_fScale, -MAX_STEP, MAX_STEP);
+}
+
+VkExtent2D DynamicResolution::get_render_extent(VkExtent2D outputExtent) const {
+	return VkExtent2D{
+		.width = std::max(static_cast<uint32_t>(std::lround(outputExtent.width * m_fScale)), 1u),
+		.height = std::max(static_cast<uint32_t>(std::lround(outputExtent.height * m_fScale)), 1u)
+	};
+}
@@ -0,0 +1,48 @@
+#ifndef DYNAMICRESOLUTION_H
+#define DYNAMICRESOLUTION_H
+
+#include <vulkan/vulkan.h>
+
+// picks the fraction of the output resolution the scene is rendered at so that the gpu frame time settles at a target.
+// a frame's cost is assumed to scale with its pixel count, so every measured frame is divided by the area it was rendered
+// at to estimate the cost of a full resolution frame. the scale only moves once the estimate leaves a band around the target
+// and by a bounded step per frame, timing noise and the frames in flight that still use the old scale don't make it oscillate.
+class DynamicResolution {
+public:
+	// per axis, the render targets are allocated at the full output extent
+	static constexpr float MIN_SCALE{ 0.5f };
+	static constexpr float MAX_SCALE{ 1.0f };
+	// relative deviation from the target frame time that is tolerated before the scale changes
+	static constexpr float DEAD_BAND{ 0.05f };
+	static constexpr float MAX_STEP{ 0.02f };
+	// weight of the newest frame in the estimated full resolution frame time
+	static constexpr float SMOOTHING{ 0.1f };
+
+	// seconds
+	void init(float targetFrameTime);
+
+	// the gpu time of a completed frame in seconds and the scale it was rendered at
+	void record_frame(float gpuFrameTime, float renderScale);
+
+	float get_scale() const {
+		return m_fScale;
+	}
+
+	float get_target_frame_time() const {
+		return m_fTargetFrameTime;
+	}
+
+	void set_target_frame_time(float targetFrameTime) {
+		m_fTargetFrameTime = targetFrameTime;
+	}
+
+	// the extent rendered at for the given output extent, never empty
+	VkExtent2D get_render_extent(VkExtent2D outputExtent) const;
+
+private:
+	float m_fTargetFrameTime{};
+	float m_fScale{ MAX_SCALE };
+	float m_fFullResolutionTime{};
+};
+
+#endif // !DYNAMICRESOLUTION_H
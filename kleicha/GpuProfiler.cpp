@@ -0,0 +1,195 @@
+#include "GpuProfiler.h"
+#include "Utils.h"
+
+#include <algorithm>
+#include <cstring>
+
+// the frame scope plus every pass scope, each with a begin and end timestamp
+static constexpr uint32_t TIMESTAMPS_PER_FRAME{ 2 * (GpuProfiler::MAX_SCOPES + 1) };
+
+void GpuProfiler::init(VkDevice device, const VkPhysicalDeviceProperties& deviceProperties, uint32_t framesInFlight, bool usePipelineStatistics) {
+	m_device = device;
+	m_bEnabled = deviceProperties.limits.timestampComputeAndGraphics;
+	if (!m_bEnabled) {
+		fmt::println("[Kleicha] Timestamps aren't supported on the graphics queue, gpu timings won't be recorded.");
+		return;
+	}
+
+	m_bUsePipelineStatistics = usePipelineStatistics;
+	m_timestampPeriod = deviceProperties.limits.timestampPeriod;
+	m_frames.assign(framesInFlight, FrameQueries{});
+
+	VkQueryPoolCreateInfo timestampPoolInfo{ .sType = VK_STRUCTURE_TYPE_QUERY_POOL_CREATE_INFO };
+	timestampPoolInfo.queryType = VK_QUERY_TYPE_TIMESTAMP;
+	timestampPoolInfo.queryCount = TIMESTAMPS_PER_FRAME * framesInFlight;
+	VK_CHECK(vkCreateQueryPool(m_device, &timestampPoolInfo, nullptr, &m_timestampPool));
+
+	if (m_bUsePipelineStatistics) {
+		VkQueryPoolCreateInfo statisticsPoolInfo{ .sType = VK_STRUCTURE_TYPE_QUERY_POOL_CREATE_INFO };
+		statisticsPoolInfo.queryType = VK_QUERY_TYPE_PIPELINE_STATISTICS;
+		statisticsPoolInfo.queryCount = MAX_SCOPES * framesInFlight;
+		// the results are returned in the order of the flag bits, matching the Statistic enum
+		statisticsPoolInfo.pipelineStatistics = VK_QUERY_PIPELINE_STATISTIC_INPUT_ASSEMBLY_PRIMITIVES_BIT |
+			VK_QUERY_PIPELINE_STATISTIC_VERTEX_SHADER_INVOCATIONS_BIT |
+			VK_QUERY_PIPELINE_STATISTIC_CLIPPING_PRIMITIVES_BIT |
+			VK_QUERY_PIPELINE_STATISTIC_FRAGMENT_SHADER_INVOCATIONS_BIT;
+		VK_CHECK(vkCreateQueryPool(m_device, &statisticsPoolInfo, nullptr, &m_statisticsPool));
+	}
+}
+
+void GpuProfiler::destroy() const {
+	vkDestroyQueryPool(m_device, m_timestampPool, nullptr);
+	vkDestroyQueryPool(m_device, m_statisticsPool, nullptr);
+}
+
+void GpuProfiler::enable_calibration(VkInstance instance, VkPhysicalDevice physicalDevice) {
+	if (!m_bEnabled)
+		return;
+
+	auto pfnGetTimeDomains{ reinterpret_cast<PFN_vkGetPhysicalDeviceCalibrateableTimeDomainsKHR>(
+		vkGetInstanceProcAddr(instance, "vkGetPhysicalDeviceCalibrateableTimeDomainsKHR")) };
+	if (!pfnGetTimeDomains)
+		return;
+
+	uint32_t domainCount{};
+	VK_CHECK(pfnGetTimeDomains(physicalDevice, &domainCount, nullptr));
+	std::vector<VkTimeDomainKHR> domains(domainCount);
+	VK_CHECK(pfnGetTimeDomains(physicalDevice, &domainCount, domains.data()));
+	if (std::find(domains.begin(), domains.end(), VK_TIME_DOMAIN_DEVICE_KHR) == domains.end()) {
+		fmt::println("[Kleicha] The device time domain can't be calibrated, gpu completion times won't be recorded.");
+		return;
+	}
+
+	m_pfnGetCalibratedTimestamps = reinterpret_cast<PFN_vkGetCalibratedTimestampsKHR>(vkGetDeviceProcAddr(m_device, "vkGetCalibratedTimestampsKHR"));
+}
+
+void GpuProfiler::begin_frame(VkCommandBuffer cmdBuffer, uint32_t frameNumber) {
+	if (!m_bEnabled)
+		return;
+
+	m_uiCurrentSlot = frameNumber % static_cast<uint32_t>(m_frames.size());
+	FrameQueries& frame{ m_frames[m_uiCurrentSlot] };
+	frame.m_uiFrameNumber = frameNumber;
+	frame.m_bRecorded = true;
+	frame.m_uiStatisticsCount = 0;
+	frame.m_scopes.clear();
+
+	vkCmdResetQueryPool(cmdBuffer, m_timestampPool, m_uiCurrentSlot * TIMESTAMPS_PER_FRAME, TIMESTAMPS_PER_FRAME);
+	if (m_bUsePipelineStatistics)
+		vkCmdResetQueryPool(cmdBuffer, m_statisticsPool, m_uiCurrentSlot * MAX_SCOPES, MAX_SCOPES);
+
+	write_begin(cmdBuffer, find_scope("frame"), false);
+}
+
+void GpuProfiler::end_frame(VkCommandBuffer cmdBuffer) {
+	if (!m_bEnabled)
+		return;
+
+	write_end(cmdBuffer, 0);
+}
+
+void GpuProfiler::begin_scope(VkCommandBuffer cmdBuffer, const char* name, bool collectStatistics) {
+	if (!m_bEnabled || m_frames[m_uiCurrentSlot].m_scopes.size() > MAX_SCOPES)
+		return;
+
+	write_begin(cmdBuffer, find_scope(name), collectStatistics);
+	m_uiOpenScope = static_cast<uint32_t>(m_frames[m_uiCurrentSlot].m_scopes.size() - 1);
+}
+
+void GpuProfiler::end_scope(VkCommandBuffer cmdBuffer) {
+	if (!m_bEnabled || m_uiOpenScope == UINT32_MAX)
+		return;
+
+	write_end(cmdBuffer, m_uiOpenScope);
+	m_uiOpenScope = UINT32_MAX;
+}
+
+bool GpuProfiler::read_frame(uint32_t frameNumber) {
+	if (!m_bEnabled)
+		return false;
+
+	uint32_t slot{ frameNumber % static_cast<uint32_t>(m_frames.size()) };
+	FrameQueries& frame{ m_frames[slot] };
+	if (!frame.m_bRecorded || frame.m_uiFrameNumber != frameNumber)
+		return false;
+
+	uint64_t timestamps[TIMESTAMPS_PER_FRAME]{};
+	uint32_t timestampCount{ static_cast<uint32_t>(frame.m_scopes.size()) * 2 };
+	if (vkGetQueryPoolResults(m_device, m_timestampPool, slot * TIMESTAMPS_PER_FRAME, timestampCount, sizeof(timestamps), timestamps,
+		sizeof(uint64_t), VK_QUERY_RESULT_64_BIT) != VK_SUCCESS)
+		return false;
+
+	std::vector<uint64_t> statistics(static_cast<std::size_t>(frame.m_uiStatisticsCount) * STATISTICS_COUNT);
+	if (frame.m_uiStatisticsCount > 0 && vkGetQueryPoolResults(m_device, m_statisticsPool, slot * MAX_SCOPES, frame.m_uiStatisticsCount,
+		statistics.size() * sizeof(uint64_t), statistics.data(), STATISTICS_COUNT * sizeof(uint64_t), VK_QUERY_RESULT_64_BIT) != VK_SUCCESS)
+		return false;
+
+	for (std::size_t i{ 0 }; i < frame.m_scopes.size(); ++i) {
+		const RecordedScope& recordedScope{ frame.m_scopes[i] };
+		Scope& scope{ m_scopes[recordedScope.m_uiScope] };
+
+		// timestamp ticks are converted to seconds
+		scope.m_fTime = static_cast<float>(static_cast<double>(timestamps[2 * i + 1] - timestamps[2 * i]) * m_timestampPeriod * 1e-9);
+		scope.m_fSmoothedTime = scope.m_fSmoothedTime == 0.0f ? scope.m_fTime : scope.m_fSmoothedTime + (scope.m_fTime - scope.m_fSmoothedTime) * SMOOTHING;
+		scope.m_uiFrameNumber = frameNumber;
+
+		if (recordedScope.m_uiStatisticsQuery != UINT32_MAX) {
+			scope.m_bHasStatistics = true;
+			std::memcpy(scope.m_statistics, &statistics[recordedScope.m_uiStatisticsQuery * STATISTICS_COUNT], sizeof(scope.m_statistics));
+		}
+	}
+
+	// the device clock is sampled between two reads of the cpu clock, the frame's end is placed that many ticks before
+	// their midpoint. the error is half the call's duration, a few microseconds.
+	m_frameEndTime.reset();
+	if (m_pfnGetCalibratedTimestamps) {
+		VkCalibratedTimestampInfoKHR timestampInfo{ .sType = VK_STRUCTURE_TYPE_CALIBRATED_TIMESTAMP_INFO_KHR, .timeDomain = VK_TIME_DOMAIN_DEVICE_KHR };
+		uint64_t deviceTime{};
+		uint64_t maxDeviation{};
+		auto before{ std::chrono::steady_clock::now() };
+		VkResult result{ m_pfnGetCalibratedTimestamps(m_device, 1, &timestampInfo, &deviceTime, &maxDeviation) };
+		auto after{ std::chrono::steady_clock::now() };
+		if (result == VK_SUCCESS && deviceTime >= timestamps[1]) {
+			auto sinceEnd{ std::chrono::nanoseconds{ static_cast<int64_t>(static_cast<double>(deviceTime - timestamps[1]) * m_timestampPeriod) } };
+			m_frameEndTime = before + (after - before) / 2 - std::chrono::duration_cast<std::chrono::steady_clock::duration>(sinceEnd);
+		}
+	}
+
+	frame.m_bRecorded = false;
+	return true;
+}
+
+uint32_t GpuProfiler::find_scope(const char* name) {
+	for (std::size_t i{ 0 }; i < m_scopes.size(); ++i) {
+		if (m_scopes[i].m_name == name)
+			return static_cast<uint32_t>(i);
+	}
+
+	m_scopes.push_back(Scope{ .m_name = name });
+	return static_cast<uint32_t>(m_scopes.size() - 1);
+}
+
+void GpuProfiler::write_begin(VkCommandBuffer cmdBuffer, uint32_t scope, bool collectStatistics) {
+	FrameQueries& frame{ m_frames[m_uiCurrentSlot] };
+	RecordedScope recordedScope{ .m_uiScope = scope };
+
+	uint32_t query{ m_uiCurrentSlot * TIMESTAMPS_PER_FRAME + static_cast<uint32_t>(frame.m_scopes.size()) * 2 };
+	vkCmdWriteTimestamp2(cmdBuffer, VK_PIPELINE_STAGE_2_TOP_OF_PIPE_BIT, m_timestampPool, query);
+
+	if (collectStatistics && m_bUsePipelineStatistics && frame.m_uiStatisticsCount < MAX_SCOPES) {
+		recordedScope.m_uiStatisticsQuery = frame.m_uiStatisticsCount++;
+		vkCmdBeginQuery(cmdBuffer, m_statisticsPool, m_uiCurrentSlot * MAX_SCOPES + recordedScope.m_uiStatisticsQuery, 0);
+	}
+
+	frame.m_scopes.push_back(recordedScope);
+}
+
+void GpuProfiler::write_end(VkCommandBuffer cmdBuffer, uint32_t recordedScope) {
+	const RecordedScope& scope{ m_frames[m_uiCurrentSlot].m_scopes[recordedScope] };
+
+	if (scope.m_uiStatisticsQuery != UINT32_MAX)
+		vkCmdEndQuery(cmdBuffer, m_statisticsPool, m_uiCurrentSlot * MAX_SCOPES + scope.m_uiStatisticsQuery);
+
+	uint32_t query{ m_uiCurrentSlot * TIMESTAMPS_PER_FRAME + recordedScope * 2 + 1 };
+	vkCmdWriteTimestamp2(cmdBuffer, VK_PIPELINE_STAGE_2_BOTTOM_OF_PIPE_BIT, m_timestampPool, query);
+}
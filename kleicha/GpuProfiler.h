@@ -0,0 +1,110 @@
+#ifndef GPUPROFILER_H
+#define GPUPROFILER_H
+
+#include <vulkan/vulkan.h>
+
+#include <chrono>
+#include <cstdint>
+#include <optional>
+#include <string>
+#include <vector>
+
+// times the passes of a frame with timestamp queries and optionally counts their work with pipeline statistics queries.
+// every frame in flight has its own range of queries, a frame's results are read once its fence has signaled so reading
+// them never stalls. scopes are matched across frames by name and their times are smoothed for display. with calibrated
+// timestamps the gpu clock is mapped onto the cpu's, which tells when the gpu actually finished a frame.
+class GpuProfiler {
+public:
+	static constexpr uint32_t MAX_SCOPES{ 16 };
+	// weight of the newest frame in the smoothed times
+	static constexpr float SMOOTHING{ 0.05f };
+
+	enum Statistic {
+		INPUT_ASSEMBLY_PRIMITIVES,
+		VERTEX_SHADER_INVOCATIONS,
+		CLIPPING_PRIMITIVES,
+		FRAGMENT_SHADER_INVOCATIONS,
+		STATISTICS_COUNT
+	};
+
+	struct Scope {
+		std::string m_name{};
+		// seconds, as of the last frame that was read back
+		float m_fTime{};
+		float m_fSmoothedTime{};
+		// frame the time was read from, a scope that's skipped in a frame keeps its last time
+		uint32_t m_uiFrameNumber{};
+		bool m_bHasStatistics{ false };
+		uint64_t m_statistics[STATISTICS_COUNT]{};
+	};
+
+	// the profiler stays disabled and every call is a no-op if the queue can't write timestamps
+	void init(VkDevice device, const VkPhysicalDeviceProperties& deviceProperties, uint32_t framesInFlight, bool usePipelineStatistics);
+	void destroy() const;
+	// needs VK_KHR_calibrated_timestamps enabled on the device, stays off if the device time domain can't be calibrated
+	void enable_calibration(VkInstance instance, VkPhysicalDevice physicalDevice);
+
+	bool is_enabled() const {
+		return m_bEnabled;
+	}
+
+	// resets the queries of the frame's slot and opens the scope that spans the whole frame
+	void begin_frame(VkCommandBuffer cmdBuffer, uint32_t frameNumber);
+	void end_frame(VkCommandBuffer cmdBuffer);
+
+	// scopes can't nest inside each other, only inside the frame. statistics can only be collected outside of rendering.
+	void begin_scope(VkCommandBuffer cmdBuffer, const char* name, bool collectStatistics = false);
+	void end_scope(VkCommandBuffer cmdBuffer);
+
+	// reads back the results of frameNumber, the fence of the frame must have signaled. returns false if nothing was read.
+	bool read_frame(uint32_t frameNumber);
+
+	// the first scope always spans the whole frame
+	const std::vector<Scope>& get_scopes() const {
+		return m_scopes;
+	}
+
+	float get_frame_time() const {
+		return m_scopes.empty() ? 0.0f : m_scopes[0].m_fTime;
+	}
+
+	// when the gpu finished the last frame that was read back, empty without calibrated timestamps
+	std::optional<std::chrono::steady_clock::time_point> get_frame_end_time() const {
+		return m_frameEndTime;
+	}
+
+private:
+	struct RecordedScope {
+		uint32_t m_uiScope{};
+		// index into the slot's statistics queries, UINT32_MAX without statistics
+		uint32_t m_uiStatisticsQuery{ UINT32_MAX };
+	};
+
+	struct FrameQueries {
+		uint32_t m_uiFrameNumber{};
+		bool m_bRecorded{ false };
+		uint32_t m_uiStatisticsCount{};
+		std::vector<RecordedScope> m_scopes{};
+	};
+
+	VkDevice m_device{};
+	bool m_bEnabled{ false };
+	bool m_bUsePipelineStatistics{ false };
+	double m_timestampPeriod{};
+	VkQueryPool m_timestampPool{};
+	VkQueryPool m_statisticsPool{};
+	PFN_vkGetCalibratedTimestampsKHR m_pfnGetCalibratedTimestamps{};
+	std::optional<std::chrono::steady_clock::time_point> m_frameEndTime{};
+
+	std::vector<FrameQueries> m_frames{};
+	std::vector<Scope> m_scopes{};
+	// slot of the frame being recorded and its open scope
+	uint32_t m_uiCurrentSlot{};
+	uint32_t m_uiOpenScope{ UINT32_MAX };
+
+	uint32_t find_scope(const char* name);
+	void write_begin(VkCommandBuffer cmdBuffer, uint32_t scope, bool collectStatistics);
+	void write_end(VkCommandBuffer cmdBuffer, uint32_t recordedScope);
+};
+
+#endif // !GPUPROFILER_H
@@ -1,9 +1,13 @@
+#ifndef KLEICHA_HEADLESS_ONLY
 #define GLFW_INCLUDE_VULKAN
 #include <GLFW/glfw3.h>
+#endif
 #include "InstanceBuilder.h"
 #include "Initializers.h"
 #include "Utils.h"
 
+#include <algorithm>
+
 
 // debug messenger callback function
 #ifdef _DEBUG 
@@ -72,12 +76,42 @@ void InstanceBuilder::check_extensions_support() const {
 
 // adds default extensions to the user specified extensions
 void InstanceBuilder::add_glfw_instance_extensions() {
+#ifndef KLEICHA_HEADLESS_ONLY
 	// add glfw extensions
 	uint32_t glfwExtensionCount{};
 	const char** glfwExtensions{ glfwGetRequiredInstanceExtensions(&glfwExtensionCount) };
 
 	for (uint32_t i{ 0 }; i < glfwExtensionCount; ++i)
 		m_extensions.emplace_back(glfwExtensions[i]);
+#endif
+}
+
+std::vector<std::string> InstanceBuilder::add_optional_instance_extensions() {
+	uint32_t extensionCount{};
+	VK_CHECK(vkEnumerateInstanceExtensionProperties(nullptr, &extensionCount, nullptr));
+	std::vector<VkExtensionProperties> supportedExtensions(extensionCount);
+	VK_CHECK(vkEnumerateInstanceExtensionProperties(nullptr, &extensionCount, supportedExtensions.data()));
+
+	auto is_supported{ [&supportedExtensions](const char* extension) {
+		for (const auto& supportedExt : supportedExtensions) {
+			if (strcmp(extension, supportedExt.extensionName) == 0)
+				return true;
+		}
+		return false;
+	} };
+
+	std::vector<std::string> enabled{};
+	for (const auto& group : m_optionalExtensions) {
+		if (!std::all_of(group.begin(), group.end(), is_supported)) {
+			fmt::println("[InstanceBuilder] Optional extension {0} is not supported by this implementation.", group.front());
+			continue;
+		}
+		for (const char* extension : group) {
+			m_extensions.emplace_back(extension);
+			enabled.emplace_back(extension);
+		}
+	}
+	return enabled;
 }
 
 vkt::Instance InstanceBuilder::build() {
@@ -111,8 +145,10 @@ vkt::Instance InstanceBuilder::build() {
 	instanceInfo.enabledLayerCount = static_cast<uint32_t>(m_layers.size());
 	instanceInfo.ppEnabledLayerNames = m_layers.data();
 
-	add_glfw_instance_extensions();
+	if (!m_headless)
+		add_glfw_instance_extensions();
 	check_extensions_support();
+	std::vector<std::string> optionalExtensions{ add_optional_instance_extensions() };
 	instanceInfo.enabledExtensionCount = static_cast<uint32_t>(m_extensions.size());
 	instanceInfo.ppEnabledExtensionNames = m_extensions.data();
 
@@ -133,5 +169,6 @@ vkt::Instance InstanceBuilder::build() {
 	VK_CHECK(pfnCreateMessenger(instance, &debugMessengerInfo, nullptr, &debugMessenger));
 #endif
 
-	return vkt::Instance{ .instance = instance, .debugMessenger = debugMessenger, .pfnCreateMessenger = pfnCreateMessenger, .pfnDestroyMessenger = pfnDestroyMessenger };
+	return vkt::Instance{ .instance = instance, .debugMessenger = debugMessenger, .pfnCreateMessenger = pfnCreateMessenger, .pfnDestroyMessenger = pfnDestroyMessenger,
+		.enabledOptionalExtensions = std::move(optionalExtensions) };
 }
\ No newline at end of file
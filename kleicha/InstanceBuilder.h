@@ -16,19 +16,35 @@ public:
 		return *this;
 	}
 
+	// enabled only if the implementation supports every extension of the group, never a reason for the build to fail
+	InstanceBuilder& add_optional_extensions(const std::vector<const char*>& extensions) {
+		m_optionalExtensions.push_back(extensions);
+		return *this;
+	}
+
 	InstanceBuilder& use_validation_layer() {
 		m_useValidationLayer = true;
 		return *this;
 	}
 
+	// no window will be created, skips the surface extensions glfw asks for
+	InstanceBuilder& use_headless() {
+		m_headless = true;
+		return *this;
+	}
+
 private:
 	std::vector<const char*> m_layers{};
 	std::vector<const char*> m_extensions{};
+	std::vector<std::vector<const char*>> m_optionalExtensions{};
 	bool m_useValidationLayer{ false };
+	bool m_headless{ false };
 
 	void check_layers_support() const;
 	void add_glfw_instance_extensions();
 	void check_extensions_support() const;
+	// moves the supported optional groups into the enabled extensions, returns their names
+	std::vector<std::string> add_optional_instance_extensions();
 };
 
 #endif // !INSTANCEBUILDER_H
@@ -2,12 +2,20 @@
 #include "Utils.h"
 #include "InstanceBuilder.h"
 #include "DeviceBuilder.h"
+#ifndef KLEICHA_HEADLESS_ONLY
 #include "SwapchainBuilder.h"
+#endif
 #include "PipelineBuilder.h"
 #include "Initializers.h"
 #include "Types.h"
 #include "Scene.h"
 
+#include <algorithm>
+#include <bit>
+#include <chrono>
+#include <thread>
+#include <random>
+
 #pragma warning(push)
 #pragma warning(disable : 26819 6262 26110 26813 26495 6386 4100 4365 4127 4189 6387 33010)
 #define VMA_IMPLEMENTATION
@@ -17,13 +25,15 @@
 
 #include <ktxvulkan.h>
 
+#ifndef KLEICHA_HEADLESS_ONLY
 #include "../imgui/imgui.h"
 #include "../imgui/imgui_impl_glfw.h"
 #include "../imgui/imgui_impl_vulkan.h"
+#endif
 #pragma warning(pop)
 
 
-
+#ifndef KLEICHA_HEADLESS_ONLY
 static void key_callback(GLFWwindow* window, int key, [[maybe_unused]]int scancode, int action, [[maybe_unused]]int mods) {
 
 	if (key == GLFW_KEY_ESCAPE && action == GLFW_PRESS)
@@ -37,6 +47,16 @@ static void key_callback(GLFWwindow* window, int key, [[maybe_unused]]int scanco
 			glfwSetInputMode(window, GLFW_CURSOR, GLFW_CURSOR_DISABLED);
 
 	}
+
+	if (key == GLFW_KEY_F2 && action == GLFW_PRESS) {
+		Kleicha* kleicha{ reinterpret_cast<Kleicha*>(glfwGetWindowUserPointer(window)) };
+		kleicha->m_bWriteCpuTrace = true;
+	}
+
+	if (key == GLFW_KEY_F3 && action == GLFW_PRESS) {
+		Kleicha* kleicha{ reinterpret_cast<Kleicha*>(glfwGetWindowUserPointer(window)) };
+		kleicha->m_bWriteMemoryStats = true;
+	}
 }
 
 static void cursor_callback(GLFWwindow* window, double xpos, double ypos) {
@@ -47,29 +67,67 @@ static void cursor_callback(GLFWwindow* window, double xpos, double ypos) {
 		kleicha->m_camera.updateEulerAngles(static_cast<float>(xpos), static_cast<float>(ypos));
 	}
 }
+#endif
 
 // init calls the required functions to initialize vulkan
-void Kleicha::init() {
-	if (!glfwInit()) {
-		throw std::runtime_error{ "[Kleicha] GLFW failed to initialize." };
-	}
-	// disable context creation (used for opengl)
-	glfwWindowHint(GLFW_CLIENT_API, GLFW_NO_API);
-	// set glfw key callback function
-	//m_window = glfwCreateWindow(static_cast<int>(m_windowExtent.width), static_cast<int>(m_windowExtent.height), "kleicha", glfwGetPrimaryMonitor(), NULL);
-	m_window = glfwCreateWindow(static_cast<int>(m_windowExtent.width), static_cast<int>(m_windowExtent.height), "kleicha", NULL, NULL);
-	glfwSetInputMode(m_window, GLFW_CURSOR, GLFW_CURSOR_DISABLED);
-	glfwSetWindowUserPointer(m_window, this);
-	glfwSetCursorPos(m_window, m_windowExtent.width / 2.0f, m_windowExtent.height / 2.0f);
-	glfwSetCursorPosCallback(m_window, cursor_callback);
-	glfwSetKeyCallback(m_window, key_callback);
+void Kleicha::init(const vkt::Config& config) {
+	m_config = config;
+#ifdef KLEICHA_HEADLESS_ONLY
+	// built without glfw and imgui, there is nothing to present to
+	if (!m_config.m_bHeadless) {
+		fmt::println("[Kleicha] Built without window support, running headless.");
+		m_config.m_bHeadless = true;
+	}
+#endif
+	CpuProfiler::set_enabled(m_config.m_bCpuTrace);
+	CpuProfiler::set_thread_name("main");
+	PROFILE_ZONE("init");
+
+	if (m_config.m_uiFramesInFlight < 1 || m_config.m_uiFramesInFlight > MAX_FRAMES_IN_FLIGHT)
+		throw std::runtime_error{ fmt::format("[Kleicha] Frames in flight must be between 1 and {}, got {}.", MAX_FRAMES_IN_FLIGHT, m_config.m_uiFramesInFlight) };
+	m_framesInFlight = m_config.m_uiFramesInFlight;
+	m_frames.resize(m_framesInFlight);
+	m_slotStartTimes.resize(m_framesInFlight);
+	m_slotInputTimes.resize(m_framesInFlight);
+	m_slotRenderScales.resize(m_framesInFlight, 1.0f);
+	m_bLateLatch = m_config.m_bLateLatch;
+	if (m_bLateLatch && m_config.m_bLightBenchmark) {
+		fmt::println("[Kleicha] Late latching disables clustered lighting, it stays off for the light benchmark.");
+		m_bLateLatch = false;
+	}
+	else if (m_bLateLatch)
+		fmt::println("[Kleicha] Late latching, clustered lighting is disabled while it's on.");
+	m_bUseDepthPrepass = m_config.m_bDepthPrepass;
+	m_bDynamicResolution = m_config.m_uiDynamicResolutionFps > 0;
+	m_dynamicResolution.init(1.0f / (m_bDynamicResolution ? m_config.m_uiDynamicResolutionFps : DEFAULT_DYNAMIC_RESOLUTION_FPS));
+	fmt::println("[Kleicha] Rendering with {} frames in flight.", m_framesInFlight);
+
+	// headless runs render into the raster image only, there's no window, surface, swapchain or ui
+#ifndef KLEICHA_HEADLESS_ONLY
+	if (!m_config.m_bHeadless) {
+		if (!glfwInit()) {
+			throw std::runtime_error{ "[Kleicha] GLFW failed to initialize." };
+		}
+		// disable context creation (used for opengl)
+		glfwWindowHint(GLFW_CLIENT_API, GLFW_NO_API);
+		// set glfw key callback function
+		//m_window = glfwCreateWindow(static_cast<int>(m_windowExtent.width), static_cast<int>(m_windowExtent.height), "kleicha", glfwGetPrimaryMonitor(), NULL);
+		m_window = glfwCreateWindow(static_cast<int>(m_windowExtent.width), static_cast<int>(m_windowExtent.height), "kleicha", NULL, NULL);
+		glfwSetInputMode(m_window, GLFW_CURSOR, GLFW_CURSOR_DISABLED);
+		glfwSetWindowUserPointer(m_window, this);
+		glfwSetCursorPos(m_window, m_windowExtent.width / 2.0f, m_windowExtent.height / 2.0f);
+		glfwSetCursorPosCallback(m_window, cursor_callback);
+		glfwSetKeyCallback(m_window, key_callback);
+	}
+#endif
 
 	init_vulkan();
 	init_swapchain();
 	init_command_buffers();
 	init_sync_primitives();
 	init_vma();
-	init_imgui();
+	if (!m_config.m_bHeadless)
+		init_imgui();
 	init_load_scene();
 	init_lights();
 	init_image_buffers();
@@ -78,46 +136,116 @@ void Kleicha::init() {
 	init_descriptors();
 	init_graphics_pipelines();
 	init_write_descriptor_sets();
+	if (m_config.m_uiDescriptorBenchmarkRounds > 0)
+		run_descriptor_benchmark();
+
+	if (m_config.m_bLightBenchmark) {
+		// shadows stay off so that the sweep measures the cost of shading alone
+		m_bUseShadows = false;
+		m_benchmarkLights = m_pointLights;
+		m_lightBenchmark.init(static_cast<uint32_t>(m_benchmarkLights.size()));
+		apply_light_benchmark_step();
+	}
+
+	if (!m_config.m_cameraPath.empty()) {
+		if (!m_cameraPath.load(m_config.m_cameraPath))
+			throw std::runtime_error{ "[Kleicha] Failed to load camera path " + m_config.m_cameraPath };
+		m_pathBenchmark.init(m_config.m_uiBenchmarkFrames, m_framesInFlight, m_bUseDepthPrepass);
+	}
 }
 
 // core vulkan init
 void Kleicha::init_vulkan() {
+	PROFILE_ZONE("init_vulkan");
 	/*		create instance		*/	
 	InstanceBuilder instanceBuilder{};
 	std::vector<const char*> layers{};
 	std::vector<const char*> instanceExtensions{};
-	m_instance = instanceBuilder.add_layers(layers).add_extensions(instanceExtensions).use_validation_layer().build();
+	instanceBuilder.add_layers(layers).add_extensions(instanceExtensions).use_validation_layer();
+	if (m_config.m_bHeadless)
+		instanceBuilder.use_headless();
+	else
+		// needed by swapchain maintenance, which tells when a present is done with its semaphore and swapchain
+		instanceBuilder.add_optional_extensions({ VK_KHR_GET_SURFACE_CAPABILITIES_2_EXTENSION_NAME, VK_EXT_SURFACE_MAINTENANCE_1_EXTENSION_NAME });
+	m_instance = instanceBuilder.build();
 
 	/*		create surface		*/
-	VK_CHECK(glfwCreateWindowSurface(m_instance.instance, m_window, nullptr, &m_surface));
+#ifndef KLEICHA_HEADLESS_ONLY
+	if (!m_config.m_bHeadless)
+		VK_CHECK(glfwCreateWindowSurface(m_instance.instance, m_window, nullptr, &m_surface));
+#endif
 
 	/*		create logical device		*/		
-	std::vector<const char*> deviceExtensions{ VK_KHR_SWAPCHAIN_EXTENSION_NAME };
+	// without a surface the device builder skips presentation support and accepts any device type
+	std::vector<const char*> deviceExtensions{};
+	if (!m_config.m_bHeadless)
+		deviceExtensions.push_back(VK_KHR_SWAPCHAIN_EXTENSION_NAME);
 	vkt::DeviceFeatures deviceFeatures{};
 	deviceFeatures.VkFeatures.features.samplerAnisotropy = true;
 	deviceFeatures.VkFeatures.features.multiDrawIndirect = true;
 	deviceFeatures.VkFeatures.features.tessellationShader = true;
-	deviceFeatures.Vk11Features.multiview = true;
 	deviceFeatures.Vk12Features.runtimeDescriptorArray = true;
 	deviceFeatures.Vk12Features.bufferDeviceAddress = true;
 	deviceFeatures.Vk12Features.descriptorIndexing = true;
 	deviceFeatures.Vk12Features.descriptorBindingPartiallyBound = true;
 	deviceFeatures.Vk12Features.descriptorBindingVariableDescriptorCount = true;
+	deviceFeatures.Vk12Features.descriptorBindingSampledImageUpdateAfterBind = true;
+	deviceFeatures.Vk12Features.descriptorBindingUpdateUnusedWhilePending = true;
 	deviceFeatures.Vk13Features.dynamicRendering = true;
 	deviceFeatures.Vk13Features.synchronization2 = true;
+	// shader permutations are fast-linked from separately compiled pipeline parts when the driver supports it
+	VkPhysicalDeviceGraphicsPipelineLibraryFeaturesEXT pipelineLibraryFeatures{ .sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_GRAPHICS_PIPELINE_LIBRARY_FEATURES_EXT };
+	VkPhysicalDeviceSwapchainMaintenance1FeaturesEXT swapchainMaintenanceFeatures{ .sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_SWAPCHAIN_MAINTENANCE_1_FEATURES_EXT };
+	// descriptor buffers are only requested when selected, the descriptor set path is kept otherwise
+	VkPhysicalDeviceDescriptorBufferFeaturesEXT descriptorBufferFeatures{ .sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_DESCRIPTOR_BUFFER_FEATURES_EXT };
+	// pipeline statistics are only collected on request and only if the device can count them
+	VkPhysicalDeviceFeatures optionalFeatures{};
+	optionalFeatures.pipelineStatisticsQuery = m_config.m_bPipelineStatistics;
 	DeviceBuilder device{m_instance.instance, m_surface};
-	m_device = device.request_extensions(deviceExtensions).request_features(deviceFeatures).build();
+	device.request_extensions(deviceExtensions).request_features(deviceFeatures).request_optional_features(optionalFeatures)
+		.request_optional_extensions({ VK_KHR_PIPELINE_LIBRARY_EXTENSION_NAME, VK_EXT_GRAPHICS_PIPELINE_LIBRARY_EXTENSION_NAME }, &pipelineLibraryFeatures)
+		.request_optional_extensions({ VK_EXT_MEMORY_BUDGET_EXTENSION_NAME })
+		.request_optional_extensions({ VK_KHR_CALIBRATED_TIMESTAMPS_EXTENSION_NAME });
+	if (m_config.m_bDescriptorBuffer)
+		device.request_optional_extensions({ VK_EXT_DESCRIPTOR_BUFFER_EXTENSION_NAME }, &descriptorBufferFeatures);
+	if (m_instance.is_extension_enabled(VK_EXT_SURFACE_MAINTENANCE_1_EXTENSION_NAME))
+		device.request_optional_extensions({ VK_EXT_SWAPCHAIN_MAINTENANCE_1_EXTENSION_NAME }, &swapchainMaintenanceFeatures);
+	m_device = device.build();
+	m_bUsePipelineLibraries = m_device.is_extension_enabled(VK_EXT_GRAPHICS_PIPELINE_LIBRARY_EXTENSION_NAME) && pipelineLibraryFeatures.graphicsPipelineLibrary;
+	fmt::println("[Kleicha] Graphics pipeline libraries {}.", m_bUsePipelineLibraries ? "enabled" : "unsupported, compiling whole pipelines");
+	m_bUseDescriptorBuffer = m_device.is_extension_enabled(VK_EXT_DESCRIPTOR_BUFFER_EXTENSION_NAME) && descriptorBufferFeatures.descriptorBuffer;
+	if (m_config.m_bDescriptorBuffer)
+		fmt::println("[Kleicha] Descriptor buffers {}.", m_bUseDescriptorBuffer ? "enabled" : "unsupported, binding descriptor sets");
+	m_bUsePresentFences = m_device.is_extension_enabled(VK_EXT_SWAPCHAIN_MAINTENANCE_1_EXTENSION_NAME) && swapchainMaintenanceFeatures.swapchainMaintenance1;
+	if (!m_config.m_bHeadless)
+		fmt::println("[Kleicha] Present fences {}.", m_bUsePresentFences ? "enabled" : "unsupported, retired swapchains are kept for a fixed number of frames");
 }
 
 void Kleicha::init_swapchain() {
+	PROFILE_ZONE("init_swapchain");
+	// the frame size that would otherwise come from the swapchain
+	if (m_config.m_bHeadless) {
+		m_swapchain.imageExtent = m_windowExtent;
+		return;
+	}
+
+#ifndef KLEICHA_HEADLESS_ONLY
 	// create swapchain
 	SwapchainBuilder swapchainBuilder{ m_instance.instance, m_window, m_surface, m_device };
 	VkSurfaceFormatKHR surfaceFormat{ .format = VK_FORMAT_B8G8R8A8_SRGB, .colorSpace = VK_COLOR_SPACE_SRGB_NONLINEAR_KHR };
-	m_swapchain = swapchainBuilder.desired_image_usage(VK_IMAGE_USAGE_TRANSFER_DST_BIT).desired_image_format(surfaceFormat).desired_present_mode(VK_PRESENT_MODE_FIFO_KHR).build();
+	// frame times are meaningless when capped by vsync, benchmarks ask for an uncapped present mode and fall back to FIFO without it
+	bool benchmark{ m_config.m_bLightBenchmark || !m_config.m_cameraPath.empty() };
+	VkPresentModeKHR presentMode{ benchmark ? VK_PRESENT_MODE_IMMEDIATE_KHR : VK_PRESENT_MODE_FIFO_KHR };
+	// one image more than the frames in flight so that acquiring never waits on the presentation engine for an image the cpu could use
+	// on recreation the current swapchain is handed over as the old one
+	m_swapchain = swapchainBuilder.desired_image_usage(VK_IMAGE_USAGE_TRANSFER_DST_BIT).desired_image_format(surfaceFormat).desired_present_mode(presentMode)
+		.desired_min_image_count(m_framesInFlight + 1).old_swapchain(m_swapchain.swapchain).build();
+#endif
 }
 
 // creates a command pool and command buffers for each frame
 void Kleicha::init_command_buffers() {
+	PROFILE_ZONE("init_command_buffers");
 	VkCommandPoolCreateInfo cmdPoolInfo{ .sType = VK_STRUCTURE_TYPE_COMMAND_POOL_CREATE_INFO };
 	cmdPoolInfo.flags = VK_COMMAND_POOL_CREATE_RESET_COMMAND_BUFFER_BIT;
 	cmdPoolInfo.queueFamilyIndex = m_device.physicalDevice.queueFamilyIndex;
@@ -140,6 +268,7 @@ void Kleicha::init_command_buffers() {
 
 void Kleicha::init_sync_primitives() {
 
+	PROFILE_ZONE("init_sync_primitives");
 	// create fence in signaled state as we will wait at the beginning of the render loop
 	VkFenceCreateInfo fenceInfo{ .sType = VK_STRUCTURE_TYPE_FENCE_CREATE_INFO };
 	fenceInfo.pNext = nullptr;
@@ -155,19 +284,45 @@ void Kleicha::init_sync_primitives() {
 	// create immediate submit fence
 	VK_CHECK(vkCreateFence(m_device.device, &fenceInfo, nullptr, &m_immFence));
 
+	init_present_sync();
+
+	// each frame in flight gets its own range of timestamp and pipeline statistics queries
+	m_gpuProfiler.init(m_device.device, m_device.physicalDevice.deviceProperties.properties, m_framesInFlight,
+		m_device.enabledFeatures.pipelineStatisticsQuery);
+	if (m_device.is_extension_enabled(VK_KHR_CALIBRATED_TIMESTAMPS_EXTENSION_NAME))
+		m_gpuProfiler.enable_calibration(m_instance.instance, m_device.physicalDevice.device);
+}
+
+void Kleicha::init_present_sync() {
+	VkSemaphoreCreateInfo semaphoreInfo{ .sType = VK_STRUCTURE_TYPE_SEMAPHORE_CREATE_INFO };
+
 	//allocate present semaphores for each swap chain image
 	m_renderedSemaphores.resize(m_swapchain.imageCount);
 	for (auto& renderedSemaphore : m_renderedSemaphores) {
 		VK_CHECK(vkCreateSemaphore(m_device.device, &semaphoreInfo, nullptr, &renderedSemaphore));
 	}
+
+	if (!m_bUsePresentFences)
+		return;
+
+	// signaled so that the first present of each image doesn't wait
+	VkFenceCreateInfo fenceInfo{ .sType = VK_STRUCTURE_TYPE_FENCE_CREATE_INFO };
+	fenceInfo.flags = VK_FENCE_CREATE_SIGNALED_BIT;
+	m_presentFences.resize(m_swapchain.imageCount);
+	for (auto& presentFence : m_presentFences)
+		VK_CHECK(vkCreateFence(m_device.device, &fenceInfo, nullptr, &presentFence));
 }
 
 void Kleicha::init_graphics_pipelines() {
 
+	PROFILE_ZONE("init_graphics_pipelines");
+	auto startTime{ std::chrono::steady_clock::now() };
+	bool warmCache{ m_pipelineCache.init(m_device.device, m_device.physicalDevice.deviceProperties.properties, PIPELINE_CACHE_PATH) };
+
 	// create dummy shader modules to test pipeline builder.
 	VkPushConstantRange pushConstantRange{ .stageFlags = VK_SHADER_STAGE_ALL, .offset = 0, .size = sizeof(vkt::PushConstants) };
 
-	VkDescriptorSetLayout setLayouts[]{ m_globDescSetLayout, m_frameDescSetLayout };
+	VkDescriptorSetLayout setLayouts[]{ m_globDescSetLayout };
 
 	VkPipelineLayoutCreateInfo pipelineLayoutInfo{ .sType = VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO };
 	pipelineLayoutInfo.pushConstantRangeCount = 1;
@@ -181,7 +336,7 @@ void Kleicha::init_graphics_pipelines() {
 	blinnMapEntry.offset = 0;
 	blinnMapEntry.size = sizeof(uint32_t);
 
-	// create specialization constant that'll allow the compiler to remove the alpha testing discard rather than introducing a new shader
+	// create specialization constant that selects blinn-phong or GGX, the compiler removes the other path rather than introducing a new shader
 	uint32_t useBlinn{ 0 };
 	VkSpecializationInfo blinnSpecializationInfo{};
 	blinnSpecializationInfo.mapEntryCount = 1;
@@ -189,17 +344,24 @@ void Kleicha::init_graphics_pipelines() {
 	blinnSpecializationInfo.dataSize = sizeof(uint32_t);
 	blinnSpecializationInfo.pData = &useBlinn;
 
-	VkShaderModule lightVertModule{ utils::create_shader_module(m_device.device, "../shaders/vert_light.spv") };
-	VkShaderModule lightFragModule{ utils::create_shader_module(m_device.device, "../shaders/frag_light.spv") };
+	// leave one core to the main thread which keeps loading while the workers compile
+	m_pipelineCompiler.init(m_device.device, &m_pipelineCache, std::max(std::thread::hardware_concurrency(), 2u) - 1, m_bUsePipelineLibraries);
 
-	VkShaderModule shadowVertModule{ utils::create_shader_module(m_device.device, "../shaders/vert_shadow.spv") };
-	VkShaderModule shadowFragModule{ utils::create_shader_module(m_device.device, "../shaders/frag_shadow.spv") };
+	// pipelines compiled lazily still reference their modules, the shader manager keeps them alive until cleanup
+	m_shaderManager.init(m_device.device, SHADER_SOURCE_DIR, SHADER_CACHE_DIR);
+	VkShaderModule lightVertModule{ m_shaderManager.get("light.vert") };
+	VkShaderModule lightFragModule{ m_shaderManager.get("light.frag") };
 
-	VkShaderModule cubeShadowVertModule{ utils::create_shader_module(m_device.device, "../shaders/vert_omniShadow.spv") };
-	VkShaderModule cubeShadowFragModule{ utils::create_shader_module(m_device.device, "../shaders/frag_omniShadow.spv") };
+	VkShaderModule shadowVertModule{ m_shaderManager.get("omniShadow.vert") };
+	VkShaderModule shadowFragModule{ m_shaderManager.get("omniShadow.frag") };
+	VkShaderModule depthPrepassVertModule{ m_shaderManager.get("depthPrepass.vert") };
+	fmt::println("[Kleicha] Shaders: {} compiled, {} loaded from cache.", m_shaderManager.get_compiled_count(), m_shaderManager.get_cached_count());
 
-	PipelineBuilder pipelineBuilder{ m_device.device };
+	PipelineBuilder pipelineBuilder{ m_device.device, m_pipelineCache.get() };
 	pipelineBuilder.pipelineLayout = m_dummyPipelineLayout;
+	// pipelines are bound either to descriptor sets or to descriptor buffers, never both
+	if (m_bUseDescriptorBuffer)
+		pipelineBuilder.set_create_flags(VK_PIPELINE_CREATE_DESCRIPTOR_BUFFER_BIT_EXT);
 	pipelineBuilder.set_input_assembly_state(VK_PRIMITIVE_TOPOLOGY_TRIANGLE_LIST);
 	pipelineBuilder.set_rasterizer_state(VK_POLYGON_MODE_FILL, VK_CULL_MODE_BACK_BIT, VK_FRONT_FACE_COUNTER_CLOCKWISE);
 	pipelineBuilder.set_color_blend_state(VK_COLOR_COMPONENT_R_BIT | VK_COLOR_COMPONENT_G_BIT | VK_COLOR_COMPONENT_B_BIT | VK_COLOR_COMPONENT_A_BIT, false);
@@ -208,95 +370,114 @@ void Kleicha::init_graphics_pipelines() {
 	pipelineBuilder.set_color_attachment_format(INTERMEDIATE_IMAGE_FORMAT);
 
 	pipelineBuilder.set_shaders(&lightVertModule, nullptr, &lightFragModule);
-	m_GGXPipeline = pipelineBuilder.build();
+	PipelineDescription GGXDescription{ pipelineBuilder.describe() };
 
 	useBlinn = 1;
 	pipelineBuilder.set_shaders(&lightVertModule, nullptr, &lightFragModule, &blinnSpecializationInfo);
-	m_blinnPhongPipeline = pipelineBuilder.build();
+	PipelineDescription blinnPhongDescription{ pipelineBuilder.describe() };
 
-	/*pipelineBuilder.set_rasterizer_state(VK_POLYGON_MODE_FILL, VK_CULL_MODE_FRONT_BIT, VK_FRONT_FACE_COUNTER_CLOCKWISE, -1.25f, -1.75f);
+	// after the depth pre-pass the main pass only shades the surface that ended up visible and leaves depth as it is
+	pipelineBuilder.set_depth_stencil_state(VK_TRUE, VK_COMPARE_OP_EQUAL, VK_FALSE);
+	PipelineDescription blinnPhongEqualDescription{ pipelineBuilder.describe() };
+	pipelineBuilder.set_shaders(&lightVertModule, nullptr, &lightFragModule);
+	PipelineDescription GGXEqualDescription{ pipelineBuilder.describe() };
+
+	// position only, no fragment shader runs at all
+	pipelineBuilder.set_depth_stencil_state(VK_TRUE);
+	pipelineBuilder.set_shaders(&depthPrepassVertModule);
+	pipelineBuilder.disable_color_output();
+	std::shared_future<VkPipeline> depthPrepassPipeline{ m_pipelineCompiler.compile(pipelineBuilder.describe()) };
+
+	// depth only pipeline that renders a single cube face into its atlas tile. the fragment shader writes linear distance to
+	// the light so rasterizer depth bias has no effect, the bias is applied when the atlas is sampled instead.
+	pipelineBuilder.set_rasterizer_state(VK_POLYGON_MODE_FILL, VK_CULL_MODE_FRONT_BIT, VK_FRONT_FACE_COUNTER_CLOCKWISE);
 	pipelineBuilder.set_shaders(&shadowVertModule, nullptr, &shadowFragModule);
 	pipelineBuilder.disable_color_output();
-	m_shadowPipeline = pipelineBuilder.build();
-
-	pipelineBuilder.set_shaders(&cubeShadowVertModule, nullptr, &cubeShadowFragModule);
-	pipelineBuilder.set_color_blend_state(VK_COLOR_COMPONENT_R_BIT);
-	pipelineBuilder.set_color_attachment_format(VK_FORMAT_R32_SFLOAT);
-	pipelineBuilder.enable_color_output();
-	pipelineBuilder.set_view_mask(0b111111);
-	m_cubeShadowPipeline = pipelineBuilder.build();*/
-
-	// TO-DO: we should find a better way of doing this. Perhaps pipeline builder should deallocate these automatically after creating the pipeline?
-	// we're free to destroy shader modules after pipeline creation
-
-	vkDestroyShaderModule(m_device.device, lightVertModule, nullptr);
-	vkDestroyShaderModule(m_device.device, lightFragModule, nullptr);
-	vkDestroyShaderModule(m_device.device, shadowVertModule, nullptr);
-	vkDestroyShaderModule(m_device.device, shadowFragModule, nullptr);
-	vkDestroyShaderModule(m_device.device, cubeShadowVertModule, nullptr);
-	vkDestroyShaderModule(m_device.device, cubeShadowFragModule, nullptr);
+	std::shared_future<VkPipeline> shadowAtlasPipeline{ m_pipelineCompiler.compile(pipelineBuilder.describe()) };
+
+	if (m_pipelineCompiler.uses_pipeline_libraries()) {
+		// the permutations only differ in their fragment shader part, the other three are compiled once and shared. both are
+		// fast-linked up front so toggling between them never waits, the optimized links replace them in the background.
+		m_GGXPipeline = m_pipelineCompiler.link(GGXDescription);
+		m_blinnPhongPipeline = m_pipelineCompiler.link(blinnPhongDescription);
+		m_GGXEqualPipeline = m_pipelineCompiler.link(GGXEqualDescription);
+		m_blinnPhongEqualPipeline = m_pipelineCompiler.link(blinnPhongEqualDescription);
+	}
+	else {
+		// the first frame needs GGX, wait for it while it compiles in parallel with the shadow pipeline
+		m_GGXPipeline = AsyncPipeline{ m_pipelineCompiler.compile(std::move(GGXDescription)).get(), {} };
+		// blinn-phong isn't needed until it's selected, GGX is drawn in its place until it has compiled
+		m_blinnPhongPipeline = AsyncPipeline{ &m_pipelineCompiler, std::move(blinnPhongDescription), m_GGXPipeline.get() };
+		// the regular pipelines pass exactly the fragments the equal test would, so GGX stands in for them as well
+		m_GGXEqualPipeline = AsyncPipeline{ &m_pipelineCompiler, std::move(GGXEqualDescription), m_GGXPipeline.get() };
+		m_blinnPhongEqualPipeline = AsyncPipeline{ &m_pipelineCompiler, std::move(blinnPhongEqualDescription), m_GGXPipeline.get() };
+	}
+
+	m_shadowAtlasPipeline = shadowAtlasPipeline.get();
+	m_depthPrepassPipeline = depthPrepassPipeline.get();
+
+	std::chrono::duration<double, std::milli> elapsed{ std::chrono::steady_clock::now() - startTime };
+	fmt::println("[Kleicha] Built startup pipelines in {:.2f} ms on {} threads ({} pipeline cache).", elapsed.count(), m_pipelineCompiler.get_thread_count(), warmCache ? "warm" : "cold");
 }
 
 void Kleicha::init_descriptors() {
 
+	PROFILE_ZONE("init_descriptors");
+	if (m_bUseDescriptorBuffer)
+		m_descriptorBuffer.init(m_device, m_allocator, &m_memoryTracker);
+	// the shadow atlas is the only other descriptor in the set
+	m_textureTable.init(m_device, 1, m_bUseDescriptorBuffer ? &m_descriptorBuffer : nullptr);
 	{			// create global descriptor set layout	
-		VkDescriptorBindingFlags bindingFlags[4]{
-			{},
-			{},
+		// textures are written while frames that bind the set are in flight, slots that aren't in use may hold stale descriptors.
+		// a descriptor buffer needs none of the update after bind flags to allow that and can't have a variable count.
+		VkDescriptorBindingFlags textureBindingFlags{ m_bUseDescriptorBuffer ? VK_DESCRIPTOR_BINDING_PARTIALLY_BOUND_BIT :
+			VK_DESCRIPTOR_BINDING_PARTIALLY_BOUND_BIT | VK_DESCRIPTOR_BINDING_VARIABLE_DESCRIPTOR_COUNT_BIT | VK_DESCRIPTOR_BINDING_UPDATE_AFTER_BIND_BIT |
+				VK_DESCRIPTOR_BINDING_UPDATE_UNUSED_WHILE_PENDING_BIT };
+		VkDescriptorBindingFlags bindingFlags[2]{
 			{},
-			{VK_DESCRIPTOR_BINDING_PARTIALLY_BOUND_BIT | VK_DESCRIPTOR_BINDING_VARIABLE_DESCRIPTOR_COUNT_BIT }
+			textureBindingFlags
 		};
 		VkDescriptorSetLayoutBindingFlagsCreateInfo layoutBindingFlagsInfo{ .sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_BINDING_FLAGS_CREATE_INFO };
 		layoutBindingFlagsInfo.bindingCount = std::size(bindingFlags);
 		layoutBindingFlagsInfo.pBindingFlags = bindingFlags;
 
-		VkDescriptorSetLayoutBinding bindings[4]{
-			{0, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, 1, VK_SHADER_STAGE_ALL, nullptr},
-			{1, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, 1, VK_SHADER_STAGE_ALL, nullptr},
-			{2, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, 1,VK_SHADER_STAGE_ALL, nullptr},
-			{3, VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, 200, VK_SHADER_STAGE_ALL, nullptr}
+		// the variable sized texture array has to be the last binding
+		VkDescriptorSetLayoutBinding bindings[2]{
+			{0, VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, 1, VK_SHADER_STAGE_ALL, nullptr}, // shadow atlas, tiles are looked up through the light buffer
+			{1, VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, m_textureTable.get_capacity(), VK_SHADER_STAGE_ALL, nullptr}
 		};
 
 		// create descriptor set layout
 		VkDescriptorSetLayoutCreateInfo descriptorSetLayoutInfo{ .sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_CREATE_INFO };
 		descriptorSetLayoutInfo.pNext = &layoutBindingFlagsInfo;
+		descriptorSetLayoutInfo.flags = m_bUseDescriptorBuffer ? VK_DESCRIPTOR_SET_LAYOUT_CREATE_DESCRIPTOR_BUFFER_BIT_EXT : VK_DESCRIPTOR_SET_LAYOUT_CREATE_UPDATE_AFTER_BIND_POOL_BIT;
 		descriptorSetLayoutInfo.bindingCount = std::size(bindings);
 		descriptorSetLayoutInfo.pBindings = bindings;
 		VK_CHECK(vkCreateDescriptorSetLayout(m_device.device, &descriptorSetLayoutInfo, nullptr, &m_globDescSetLayout));
 	}
 
-	{		// create per frame descriptor set layout
-		VkDescriptorSetLayoutBinding bindings[5]{
-			{0, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, 1, VK_SHADER_STAGE_ALL, nullptr},
-			{1, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, 1, VK_SHADER_STAGE_ALL, nullptr},
-			{2, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, 1, VK_SHADER_STAGE_ALL, nullptr},
-			{3, VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, static_cast<uint32_t>(m_pointLights.size()), VK_SHADER_STAGE_ALL, nullptr}, // 2D shadow map
-			{4, VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, static_cast<uint32_t>(m_pointLights.size()), VK_SHADER_STAGE_ALL, nullptr}, // cube shadow map
-		};
-
-		VkDescriptorSetLayoutCreateInfo descriptorSetLayoutInfo{ .sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_CREATE_INFO };
-		descriptorSetLayoutInfo.pNext = nullptr;
-		descriptorSetLayoutInfo.bindingCount = std::size(bindings);
-		descriptorSetLayoutInfo.pBindings = bindings;
-		VK_CHECK(vkCreateDescriptorSetLayout(m_device.device, &descriptorSetLayoutInfo, nullptr, &m_frameDescSetLayout));
+	// the set lives in the descriptor buffer, there is no pool to allocate it from
+	if (m_bUseDescriptorBuffer) {
+		m_descriptorBuffer.create(m_globDescSetLayout);
+		return;
 	}
 
 	//create descriptor set pool
-	VkDescriptorPoolSize poolDescriptorSizes[2]{
-		{VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, 5},
-		{VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, 200}	// Textures
+	VkDescriptorPoolSize poolDescriptorSizes[1]{
+		{VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, m_textureTable.get_capacity() + 1}	// Textures and shadow atlas
 	};
 
 	VkDescriptorPoolCreateInfo descriptorPoolInfo{ .sType = VK_STRUCTURE_TYPE_DESCRIPTOR_POOL_CREATE_INFO };
 	descriptorPoolInfo.pNext = nullptr;
-	descriptorPoolInfo.maxSets = 10;
+	descriptorPoolInfo.flags = VK_DESCRIPTOR_POOL_CREATE_UPDATE_AFTER_BIND_BIT;
+	descriptorPoolInfo.maxSets = 1;
 	descriptorPoolInfo.poolSizeCount = std::size(poolDescriptorSizes);
 	descriptorPoolInfo.pPoolSizes = poolDescriptorSizes;
 
 	VK_CHECK(vkCreateDescriptorPool(m_device.device, &descriptorPoolInfo, nullptr, &m_descPool));
 
 	{
-		uint32_t variableSizedDescriptorSize{ 200 };
+		uint32_t variableSizedDescriptorSize{ m_textureTable.get_capacity() };
 		// we must specify the number of descriptors in our variable-sized descriptor binding in the descriptor set we are allocating
 		VkDescriptorSetVariableDescriptorCountAllocateInfo variableDescriptorCountAllocInfo{ .sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_VARIABLE_DESCRIPTOR_COUNT_ALLOCATE_INFO };
 		variableDescriptorCountAllocInfo.descriptorSetCount = 1;
@@ -309,33 +490,32 @@ void Kleicha::init_descriptors() {
 		setAllocInfo.pSetLayouts = &m_globDescSetLayout;
 		VK_CHECK(vkAllocateDescriptorSets(m_device.device, &setAllocInfo, &m_globalDescSet));
 	}
-
-	{
-		VkDescriptorSetAllocateInfo setAllocInfo{ .sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_ALLOCATE_INFO };
-		setAllocInfo.pNext = nullptr;
-		setAllocInfo.descriptorPool = m_descPool;
-		setAllocInfo.descriptorSetCount = 1;
-		setAllocInfo.pSetLayouts = &m_frameDescSetLayout;
-
-		for (auto& frame : m_frames)
-			VK_CHECK(vkAllocateDescriptorSets(m_device.device, &setAllocInfo, &frame.descriptorSet));
-	}
 	
 }
 
 void Kleicha::init_vma() {
+	PROFILE_ZONE("init_vma");
 	VmaAllocatorCreateInfo allocatorInfo{};
 	allocatorInfo.flags = VMA_ALLOCATOR_CREATE_BUFFER_DEVICE_ADDRESS_BIT;
+	// without the extension vma estimates the budget from the heap sizes and its own allocations
+	bool useMemoryBudget{ m_device.is_extension_enabled(VK_EXT_MEMORY_BUDGET_EXTENSION_NAME) };
+	if (useMemoryBudget)
+		allocatorInfo.flags |= VMA_ALLOCATOR_CREATE_EXT_MEMORY_BUDGET_BIT;
 	allocatorInfo.vulkanApiVersion = VK_API_VERSION_1_4;
 	allocatorInfo.physicalDevice = m_device.physicalDevice.device;
 	allocatorInfo.device = m_device.device;
 	allocatorInfo.instance = m_instance.instance;
 
 	VK_CHECK(vmaCreateAllocator(&allocatorInfo, &m_allocator));
+	m_memoryTracker.init(m_allocator, useMemoryBudget);
+	m_deletionQueue.init(m_device.device, &m_memoryTracker);
+	m_renderGraph.init(m_device.device, m_allocator, &m_memoryTracker, &m_deletionQueue);
 }
 
 void Kleicha::init_imgui() {
 
+	PROFILE_ZONE("init_imgui");
+#ifndef KLEICHA_HEADLESS_ONLY
 	// create imgui descriptor pool
 	VkDescriptorPoolSize pool_sizes[] =
 	{
@@ -378,10 +558,12 @@ void Kleicha::init_imgui() {
 	ImGui_ImplVulkan_Init(&init_info);
 
 	ImGui_ImplVulkan_CreateFontsTexture();
+#endif
 }
 
 void Kleicha::init_load_scene() {
 
+	PROFILE_ZONE("init_load_scene");
 	//std::vector<vkt::Mesh> meshes{};
 	std::vector<vkt::DrawData> draws{};
 	std::vector<vkt::Texture> textures{};
@@ -390,9 +572,17 @@ void Kleicha::init_load_scene() {
 	if (!scene.load_scene("../data/Cathedral/TutorialCathedral.fbx", m_draws, draws, m_pointLights, m_meshTransforms, m_materials, textures))
 		throw std::runtime_error{ "[Kleicha] Failed to load scene!" };
 
-	m_vertexBuffer = upload_data(scene.m_unifiedVertices.data(), scene.m_unifiedVertices.size() * sizeof(vkt::Vertex), VK_BUFFER_USAGE_STORAGE_BUFFER_BIT);
+	// vertices are pulled through their address, indices still go through the fixed function index fetch
+	m_vertexBuffer = upload_data(scene.m_unifiedVertices.data(), scene.m_unifiedVertices.size() * sizeof(vkt::Vertex), 0, VK_TRUE);
 	m_indexBuffer = upload_data(scene.m_unifiedTriangles.data(), scene.m_unifiedTriangles.size() * sizeof(glm::uvec3), VK_BUFFER_USAGE_INDEX_BUFFER_BIT);
-	m_drawBuffer = upload_data(draws.data(), sizeof(vkt::DrawData) * draws.size(), VK_BUFFER_USAGE_STORAGE_BUFFER_BIT);
+	m_drawBuffer = upload_data(draws.data(), sizeof(vkt::DrawData) * draws.size(), 0, VK_TRUE);
+
+	for (uint32_t i{ 0 }; i < m_draws.size(); ++i) {
+		if (m_materials[m_draws[i].m_uiMaterialIndex].m_fTransparent)
+			m_transparentDrawIds.push_back(i);
+		else
+			m_opaqueDrawIds.push_back(i);
+	}
 	
 	m_textures.push_back(upload_texture_image("../textures/empty.jpg"));
  	for (std::size_t i{ 0 }; i < textures.size(); ++i) {
@@ -405,123 +595,141 @@ void Kleicha::init_load_scene() {
 	m_textures.push_back(upload_texture_image_ktx(tSkybox));
 }
 
-void Kleicha::init_image_buffers(bool windowResized) {
-
-
-	VkImageCreateInfo rasterImageInfo{ init::create_image_info(INTERMEDIATE_IMAGE_FORMAT, m_swapchain.imageExtent,
-		VK_IMAGE_USAGE_TRANSFER_SRC_BIT | VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT, 1)};
-
-	VkImageCreateInfo depthImageInfo{ init::create_image_info(DEPTH_IMAGE_FORMAT, m_swapchain.imageExtent,
-		VK_IMAGE_USAGE_DEPTH_STENCIL_ATTACHMENT_BIT, 1) };
-
-	VkImageCreateInfo shadowImageInfo{ init::create_image_info(DEPTH_IMAGE_FORMAT, m_swapchain.imageExtent, VK_IMAGE_USAGE_DEPTH_STENCIL_ATTACHMENT_BIT | VK_IMAGE_USAGE_SAMPLED_BIT, 1) };
+// the raster and depth images are transient images of the render graph, only the shadow atlas lives outside of it
+void Kleicha::init_image_buffers() {
+	PROFILE_ZONE("init_image_buffers");
 
 	VmaAllocationCreateInfo allocationInfo{};
 	allocationInfo.usage = VMA_MEMORY_USAGE_AUTO_PREFER_DEVICE;
 	allocationInfo.requiredFlags = VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT;
 
-	VK_CHECK(vmaCreateImage(m_allocator, &rasterImageInfo, &allocationInfo, &rasterImage.image, &rasterImage.allocation, &rasterImage.allocationInfo));
-	VkImageViewCreateInfo rasterViewInfo{ init::create_image_view_info(rasterImage.image, INTERMEDIATE_IMAGE_FORMAT, VK_IMAGE_ASPECT_COLOR_BIT, 1) };
-	VK_CHECK(vkCreateImageView(m_device.device, &rasterViewInfo, nullptr, &rasterImage.imageView));
+	// the atlas doesn't depend on the window extent so it survives swapchain recreation
+	m_shadowAtlas.init(SHADOW_ATLAS_BUDGET, sizeof(float), m_device.physicalDevice.deviceProperties.properties.limits.maxImageDimension2D);
+	VkExtent2D atlasExtent{ m_shadowAtlas.get_extent(), m_shadowAtlas.get_extent() };
 
-	VK_CHECK(vmaCreateImage(m_allocator, &depthImageInfo, &allocationInfo, &depthImage.image, &depthImage.allocation, &depthImage.allocationInfo));
-	VkImageViewCreateInfo depthViewInfo{ init::create_image_view_info(depthImage.image, DEPTH_IMAGE_FORMAT, VK_IMAGE_ASPECT_DEPTH_BIT, 1) };
-	VK_CHECK(vkCreateImageView(m_device.device, &depthViewInfo, nullptr, &depthImage.imageView));
+	VkImageCreateInfo shadowAtlasImageInfo{ init::create_image_info(DEPTH_IMAGE_FORMAT, atlasExtent, VK_IMAGE_USAGE_DEPTH_STENCIL_ATTACHMENT_BIT | VK_IMAGE_USAGE_SAMPLED_BIT, 1) };
+	VK_CHECK(vmaCreateImage(m_allocator, &shadowAtlasImageInfo, &allocationInfo, &m_shadowAtlasImage.image, &m_shadowAtlasImage.allocation, &m_shadowAtlasImage.allocationInfo));
+	m_memoryTracker.track(m_shadowAtlasImage, MemoryTracker::SHADOW_MAPS, "shadow_atlas");
+	VkImageViewCreateInfo shadowAtlasViewInfo{ init::create_image_view_info(m_shadowAtlasImage.image, DEPTH_IMAGE_FORMAT, VK_IMAGE_ASPECT_DEPTH_BIT, 1) };
+	VK_CHECK(vkCreateImageView(m_device.device, &shadowAtlasViewInfo, nullptr, &m_shadowAtlasImage.imageView));
 
-	// allocate per frame shadow maps that'll be used as depth attachments in their own passes
-	for (auto& frame : m_frames) {
-		frame.shadowMaps.resize(m_pointLights.size());
-		for (auto& shadowMap : frame.shadowMaps) {
-			// create regular (depth) shadow maps
-			VK_CHECK(vmaCreateImage(m_allocator, &shadowImageInfo, &allocationInfo, &shadowMap.image, &shadowMap.allocation, &shadowMap.allocationInfo));
-			VkImageViewCreateInfo shadowViewInfo{ init::create_image_view_info(shadowMap.image, DEPTH_IMAGE_FORMAT, VK_IMAGE_ASPECT_DEPTH_BIT, shadowMap.mipLevels)};
-			VK_CHECK(vkCreateImageView(m_device.device, &shadowViewInfo, nullptr, &shadowMap.imageView));
-		}
-	}
+	m_shadowCache.resize(m_pointLights.size());
+	fmt::println("[Kleicha] Created {0}x{0} shadow atlas.", m_shadowAtlas.get_extent());
 
-	if (!windowResized) {
-
-		VkImageCreateInfo cubeShadowColorImageInfo{ init::create_image_info(VK_FORMAT_R32_SFLOAT, SHADOW_CUBE_EXTENT, VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT | VK_IMAGE_USAGE_SAMPLED_BIT, 1, 6) };
-		VkImageCreateInfo cubeShadowDepthImageInfo{ init::create_image_info(DEPTH_IMAGE_FORMAT, SHADOW_CUBE_EXTENT, VK_IMAGE_USAGE_DEPTH_STENCIL_ATTACHMENT_BIT, 1, 6) };
-
-		for (auto& frame : m_frames) {
-			frame.cubeShadowMaps.resize(m_pointLights.size());
-
-			// create cube shadow maps that wioll store world space distance between surface point and light
-			for (auto& cubeShadowMap : frame.cubeShadowMaps) {
-				VK_CHECK(vmaCreateImage(m_allocator, &cubeShadowColorImageInfo, &allocationInfo, &cubeShadowMap.colorImage.image, &cubeShadowMap.colorImage.allocation, &cubeShadowMap.colorImage.allocationInfo));
-				VkImageViewCreateInfo shadowCubeViewInfo{ init::create_image_view_info(cubeShadowMap.colorImage.image, VK_FORMAT_R32_SFLOAT, VK_IMAGE_ASPECT_COLOR_BIT, 1, VK_REMAINING_ARRAY_LAYERS) };
-				VK_CHECK(vkCreateImageView(m_device.device, &shadowCubeViewInfo, nullptr, &cubeShadowMap.colorImage.imageView));
-
-				VK_CHECK(vmaCreateImage(m_allocator, &cubeShadowDepthImageInfo, &allocationInfo, &cubeShadowMap.depthImage.image, &cubeShadowMap.depthImage.allocation, &cubeShadowMap.depthImage.allocationInfo));
-				VkImageViewCreateInfo shadowCubeDepthViewInfo{ init::create_image_view_info(cubeShadowMap.depthImage.image, DEPTH_IMAGE_FORMAT, VK_IMAGE_ASPECT_DEPTH_BIT, cubeShadowMap.depthImage.mipLevels) };
-				vkCreateImageView(m_device.device, &shadowCubeDepthViewInfo, nullptr, &cubeShadowMap.depthImage.imageView);
-
-			}
-		}
-	}
-		// transition depth image layouts
-		immediate_submit([&](VkCommandBuffer cmdBuffer) {
-			utils::image_memory_barrier(cmdBuffer, VK_PIPELINE_STAGE_2_NONE, VK_ACCESS_2_NONE, VK_PIPELINE_STAGE_2_NONE, VK_ACCESS_2_NONE, VK_IMAGE_LAYOUT_UNDEFINED, VK_IMAGE_LAYOUT_DEPTH_ATTACHMENT_OPTIMAL, depthImage.image, depthImage.mipLevels);
-
-			for (auto& frame : m_frames) {
-				for (auto& shadowMap : frame.shadowMaps) {
-					utils::image_memory_barrier(cmdBuffer, VK_PIPELINE_STAGE_2_NONE, VK_ACCESS_2_NONE, VK_PIPELINE_STAGE_2_NONE, VK_ACCESS_2_NONE, VK_IMAGE_LAYOUT_UNDEFINED, VK_IMAGE_LAYOUT_DEPTH_ATTACHMENT_OPTIMAL, shadowMap.image, shadowMap.mipLevels);
-				}
-
-				if (!windowResized) {
-					for (auto& cubeShadowMap : frame.cubeShadowMaps) {
-						utils::image_memory_barrier(cmdBuffer, VK_PIPELINE_STAGE_2_NONE, VK_ACCESS_2_NONE, VK_PIPELINE_STAGE_2_NONE, VK_ACCESS_2_NONE, VK_IMAGE_LAYOUT_UNDEFINED, VK_IMAGE_LAYOUT_DEPTH_ATTACHMENT_OPTIMAL, cubeShadowMap.depthImage.image, cubeShadowMap.depthImage.mipLevels);
-					}
-				}
-				
-			}
-			});
-	}
+	// the atlas rests in a sampled layout between the frames that render into it. its contents are undefined until each light's tiles are first rendered.
+	immediate_submit([&](VkCommandBuffer cmdBuffer) {
+		utils::image_memory_barrier(cmdBuffer, VK_PIPELINE_STAGE_2_NONE, VK_ACCESS_2_NONE, VK_PIPELINE_STAGE_2_NONE, VK_ACCESS_2_NONE, VK_IMAGE_LAYOUT_UNDEFINED, VK_IMAGE_LAYOUT_DEPTH_READ_ONLY_OPTIMAL, m_shadowAtlasImage.image, m_shadowAtlasImage.mipLevels);
+		});
+}
 
 void Kleicha::init_dynamic_buffers() {
 
+	PROFILE_ZONE("init_dynamic_buffers");
 	using namespace vkt;
 	
 	m_globalData.m_uiUseEmissive = true;
 
-	m_globalsBuffer = utils::create_buffer(m_allocator, sizeof(GlobalData), VK_BUFFER_USAGE_STORAGE_BUFFER_BIT,
-		VMA_MEMORY_USAGE_AUTO_PREFER_DEVICE, VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT, VMA_ALLOCATION_CREATE_HOST_ACCESS_SEQUENTIAL_WRITE_BIT | VMA_ALLOCATION_CREATE_MAPPED_BIT);
+	// the camera's near and far planes match the main pass projection
+	m_lightClusters.init(0.1f, CLUSTER_SLICE_NEAR, 1000.0f);
+	m_globalData.m_fClusterNear = m_lightClusters.get_slice_near();
+	m_globalData.m_fClusterSliceScale = m_lightClusters.get_slice_scale();
 
 	// allocate per frame buffers such as transform buffer
 	for (auto& frame : m_frames) {
-		frame.transformBuffer = utils::create_buffer(m_allocator, sizeof(Transform) * m_meshTransforms.size(), VK_BUFFER_USAGE_STORAGE_BUFFER_BIT,
+		frame.globalsBuffer = utils::create_buffer(m_allocator, sizeof(GlobalData), VK_BUFFER_USAGE_SHADER_DEVICE_ADDRESS_BIT,
 			VMA_MEMORY_USAGE_AUTO_PREFER_DEVICE, VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT, VMA_ALLOCATION_CREATE_HOST_ACCESS_SEQUENTIAL_WRITE_BIT | VMA_ALLOCATION_CREATE_MAPPED_BIT);
 
-		frame.lightBuffer = utils::create_buffer(m_allocator, sizeof(vkt::PointLight) * m_pointLights.size(), VK_BUFFER_USAGE_STORAGE_BUFFER_BIT,
+		frame.transformBuffer = utils::create_buffer(m_allocator, sizeof(Transform) * m_meshTransforms.size(), VK_BUFFER_USAGE_SHADER_DEVICE_ADDRESS_BIT,
+			VMA_MEMORY_USAGE_AUTO_PREFER_DEVICE, VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT, VMA_ALLOCATION_CREATE_HOST_ACCESS_SEQUENTIAL_WRITE_BIT | VMA_ALLOCATION_CREATE_MAPPED_BIT);
+
+		create_light_buffer(frame, std::max(MIN_LIGHT_CAPACITY, std::bit_ceil(static_cast<uint32_t>(m_pointLights.size()))));
+
+		frame.materialBuffer = utils::create_buffer(m_allocator, sizeof(Material) * m_materials.size(), VK_BUFFER_USAGE_SHADER_DEVICE_ADDRESS_BIT,
 			VMA_MEMORY_USAGE_AUTO_PREFER_DEVICE, VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT, VMA_ALLOCATION_CREATE_HOST_ACCESS_SEQUENTIAL_WRITE_BIT | VMA_ALLOCATION_CREATE_MAPPED_BIT);
 
-		frame.materialBuffer = utils::create_buffer(m_allocator, sizeof(Material) * m_materials.size(), VK_BUFFER_USAGE_STORAGE_BUFFER_BIT,
+		frame.clusterBuffer = utils::create_buffer(m_allocator, sizeof(Cluster) * LightClusters::CLUSTER_COUNT, VK_BUFFER_USAGE_SHADER_DEVICE_ADDRESS_BIT,
 			VMA_MEMORY_USAGE_AUTO_PREFER_DEVICE, VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT, VMA_ALLOCATION_CREATE_HOST_ACCESS_SEQUENTIAL_WRITE_BIT | VMA_ALLOCATION_CREATE_MAPPED_BIT);
+
+		frame.clusterLightBuffer = utils::create_buffer(m_allocator, sizeof(uint32_t) * LightClusters::MAX_LIGHT_INDICES, VK_BUFFER_USAGE_SHADER_DEVICE_ADDRESS_BIT,
+			VMA_MEMORY_USAGE_AUTO_PREFER_DEVICE, VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT, VMA_ALLOCATION_CREATE_HOST_ACCESS_SEQUENTIAL_WRITE_BIT | VMA_ALLOCATION_CREATE_MAPPED_BIT);
+
+		frame.cameraBuffer = utils::create_buffer(m_allocator, sizeof(vkt::CameraData), VK_BUFFER_USAGE_SHADER_DEVICE_ADDRESS_BIT,
+			VMA_MEMORY_USAGE_AUTO_PREFER_DEVICE, VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT, VMA_ALLOCATION_CREATE_HOST_ACCESS_SEQUENTIAL_WRITE_BIT | VMA_ALLOCATION_CREATE_MAPPED_BIT);
+
+		m_memoryTracker.track(frame.globalsBuffer, MemoryTracker::PER_FRAME, "globals");
+		m_memoryTracker.track(frame.transformBuffer, MemoryTracker::PER_FRAME, "transforms");
+		m_memoryTracker.track(frame.materialBuffer, MemoryTracker::PER_FRAME, "materials");
+		m_memoryTracker.track(frame.clusterBuffer, MemoryTracker::PER_FRAME, "clusters");
+		m_memoryTracker.track(frame.clusterLightBuffer, MemoryTracker::PER_FRAME, "cluster_lights");
+		m_memoryTracker.track(frame.cameraBuffer, MemoryTracker::PER_FRAME, "camera");
+
+		for (vkt::Buffer* buffer : { &frame.globalsBuffer, &frame.transformBuffer, &frame.materialBuffer, &frame.clusterBuffer, &frame.clusterLightBuffer, &frame.cameraBuffer })
+			buffer->deviceAddress = utils::get_buffer_device_address(m_device.device, buffer->buffer);
+
+		frame.sceneBuffer = utils::create_buffer(m_allocator, sizeof(SceneAddresses), VK_BUFFER_USAGE_SHADER_DEVICE_ADDRESS_BIT,
+			VMA_MEMORY_USAGE_AUTO_PREFER_DEVICE, VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT, VMA_ALLOCATION_CREATE_HOST_ACCESS_SEQUENTIAL_WRITE_BIT | VMA_ALLOCATION_CREATE_MAPPED_BIT);
+		m_memoryTracker.track(frame.sceneBuffer, MemoryTracker::PER_FRAME, "scene");
+		frame.sceneBuffer.deviceAddress = utils::get_buffer_device_address(m_device.device, frame.sceneBuffer.buffer);
+		write_scene_addresses(frame);
 	}
 }
 
 void Kleicha::init_lights() {		
+	PROFILE_ZONE("init_lights");
 
 	// this is where we manually add any lights
 
+	if (m_config.m_uiStressLights == 0)
+		return;
+
+	// scatter the stress lights within the bounds of the scene
+	glm::vec3 sceneMin{ std::numeric_limits<float>::max() };
+	glm::vec3 sceneMax{ std::numeric_limits<float>::lowest() };
+	for (const auto& draw : m_draws) {
+		vkt::BoundingSphere bounds{ utils::compute_bounding_sphere(draw.m_v3BoundsMin, draw.m_v3BoundsMax, m_meshTransforms[draw.m_uiTransformIndex].m_m4Model) };
+		sceneMin = glm::min(sceneMin, bounds.m_v3Center - bounds.m_fRadius);
+		sceneMax = glm::max(sceneMax, bounds.m_v3Center + bounds.m_fRadius);
+	}
+	float sceneSize{ glm::length(sceneMax - sceneMin) };
+
+	std::mt19937 generator{ m_config.m_uiStressSeed };
+	std::uniform_real_distribution<float> unit{ 0.0f, 1.0f };
+
+	for (uint32_t i{ 0 }; i < m_config.m_uiStressLights; ++i) {
+		vkt::PointLight light{};
+		light.m_v3Position = sceneMin + glm::vec3{ unit(generator), unit(generator), unit(generator) } * (sceneMax - sceneMin);
+		light.m_v3Color = glm::vec3{ 0.2f } + 0.8f * glm::vec3{ unit(generator), unit(generator), unit(generator) };
+
+		// pick the quadratic falloff that brings the light down to the cutoff intensity at the chosen radius
+		float radius{ sceneSize * (0.02f + 0.06f * unit(generator)) };
+		float intensity{ std::max(light.m_v3Color.r, std::max(light.m_v3Color.g, light.m_v3Color.b)) };
+		light.m_fFalloff = glm::vec3{ 1.0f, 0.0f, (intensity / LIGHT_CUTOFF_INTENSITY - 1.0f) / (radius * radius) };
+
+		m_pointLights.push_back(light);
+	}
+
+	fmt::println("[Kleicha] Spawned {} stress lights.", m_config.m_uiStressLights);
 }
 
 vkt::Buffer Kleicha::upload_data(void* data, VkDeviceSize bufferSize, VkBufferUsageFlags bufferUsage, VkBool32 bdaUsage) {
 
+	if (bdaUsage)
+		bufferUsage |= VK_BUFFER_USAGE_SHADER_DEVICE_ADDRESS_BIT;
+
 	// Create mesh vertex and index buffers
 	vkt::Buffer deviceBuffer{ utils::create_buffer(m_allocator, bufferSize, VK_BUFFER_USAGE_TRANSFER_DST_BIT | bufferUsage,
 		VMA_MEMORY_USAGE_AUTO_PREFER_DEVICE, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT) };
+	m_memoryTracker.track(deviceBuffer, MemoryTracker::GEOMETRY, "geometry");
 
 	// get buffer device address
-	VkBufferDeviceAddressInfo bdaInfo{ .sType = VK_STRUCTURE_TYPE_BUFFER_DEVICE_ADDRESS_INFO, .buffer = deviceBuffer.buffer };
 	if (bdaUsage) {
-		deviceBuffer.deviceAddress = vkGetBufferDeviceAddress(m_device.device, &bdaInfo);
+		deviceBuffer.deviceAddress = utils::get_buffer_device_address(m_device.device, deviceBuffer.buffer);
 	}
 
 	// Create staging buffers
 	vkt::Buffer stageBuffer{ utils::create_buffer(m_allocator, bufferSize, VK_BUFFER_USAGE_TRANSFER_SRC_BIT,  VMA_MEMORY_USAGE_AUTO_PREFER_DEVICE,
 		VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT, VMA_ALLOCATION_CREATE_HOST_ACCESS_SEQUENTIAL_WRITE_BIT | VMA_ALLOCATION_CREATE_MAPPED_BIT) };
+	m_memoryTracker.track(stageBuffer, MemoryTracker::STAGING, "staging");
 
 	// copy to mapped device visible memory
 	memcpy(stageBuffer.allocation->GetMappedData(), data, bufferSize);
@@ -540,38 +748,56 @@ vkt::Buffer Kleicha::upload_data(void* data, VkDeviceSize bufferSize, VkBufferUs
 		   fmt::println("{0} | {1} | {2}", pLocations[i].x, pLocations[i].y, pLocations[i].z);
 	   }
    }*/
-	vmaDestroyBuffer(m_allocator, stageBuffer.buffer, stageBuffer.allocation);
+	m_memoryTracker.destroy(stageBuffer);
 
 	return deviceBuffer;
 }
 
 void Kleicha::init_samplers() {
+	PROFILE_ZONE("init_samplers");
 	VkSamplerCreateInfo textureSamplerInfo{ init::create_sampler_info(m_device, VK_FILTER_LINEAR, VK_FILTER_LINEAR, VK_SAMPLER_MIPMAP_MODE_LINEAR, VK_SAMPLER_ADDRESS_MODE_REPEAT, VK_TRUE, VK_LOD_CLAMP_NONE) };
 	VK_CHECK(vkCreateSampler(m_device.device, &textureSamplerInfo, nullptr, &m_textureSampler));
 
 
-	VkSamplerCreateInfo shadowSamplerInfo{ init::create_sampler_info(m_device, VK_FILTER_LINEAR, VK_FILTER_LINEAR, VK_SAMPLER_MIPMAP_MODE_NEAREST, VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_EDGE) };
+	// the atlas is read with texelFetch, filtering would blend neighbouring tiles
+	VkSamplerCreateInfo shadowSamplerInfo{ init::create_sampler_info(m_device, VK_FILTER_NEAREST, VK_FILTER_NEAREST, VK_SAMPLER_MIPMAP_MODE_NEAREST, VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_EDGE) };
 	VK_CHECK(vkCreateSampler(m_device.device, &shadowSamplerInfo, nullptr, &m_shadowSampler));
 }
 
 void Kleicha::init_write_descriptor_sets() {
 
-	utils::update_set_buffer_descriptor(m_device.device, m_globalDescSet, 0, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, m_vertexBuffer.buffer);
-	utils::update_set_buffer_descriptor(m_device.device, m_globalDescSet, 1, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, m_drawBuffer.buffer);
-	utils::update_set_buffer_descriptor(m_device.device, m_globalDescSet, 2, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, m_globalsBuffer.buffer);
-	utils::update_set_image_sampler_descriptor(m_device.device, m_globalDescSet, 3, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL, m_textureSampler, m_textures);
-
-	// per frame descriptor set writes
-	for (auto& frame : m_frames) {
+	PROFILE_ZONE("init_write_descriptor_sets");
+	// the texture table's flush makes the atlas descriptor visible along with the textures
+	if (m_bUseDescriptorBuffer)
+		m_descriptorBuffer.write_combined_image_sampler(0, 0, m_shadowSampler, m_shadowAtlasImage.imageView, VK_IMAGE_LAYOUT_DEPTH_READ_ONLY_OPTIMAL);
+	else
+		utils::update_set_image_sampler_descriptor(m_device.device, m_globalDescSet, 0, VK_IMAGE_LAYOUT_DEPTH_READ_ONLY_OPTIMAL, m_shadowSampler, { m_shadowAtlasImage });
+	m_textureTable.set_descriptor_set(m_globalDescSet, 1, m_textureSampler);
+	for (std::size_t i{ 0 }; i < m_textures.size(); ++i) {
+		[[maybe_unused]] uint32_t slot{ m_textureTable.add(m_textures[i].imageView) };
+		assert(slot == i);
+	}
+	m_textureTable.flush();
 
-		utils::update_set_buffer_descriptor(m_device.device, frame.descriptorSet, 0, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, frame.transformBuffer.buffer);
-		utils::update_set_buffer_descriptor(m_device.device, frame.descriptorSet, 1, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, frame.materialBuffer.buffer);
-		utils::update_set_buffer_descriptor(m_device.device, frame.descriptorSet, 2, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, frame.lightBuffer.buffer);
+}
 
-		utils::update_set_image_sampler_descriptor(m_device.device, frame.descriptorSet, 3, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL, m_shadowSampler, frame.shadowMaps);
-		utils::update_set_image_sampler_descriptor(m_device.device, frame.descriptorSet, 4, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL, m_shadowSampler, frame.cubeShadowMaps);
+// runs before the first frame is submitted, so every slot may be rewritten regardless of the backend's update rules
+void Kleicha::run_descriptor_benchmark() {
+
+	PROFILE_ZONE("run_descriptor_benchmark");
+	uint32_t rounds{ m_config.m_uiDescriptorBenchmarkRounds };
+	std::size_t written{};
+	auto startTime{ std::chrono::steady_clock::now() };
+	for (uint32_t round{ 0 }; round < rounds; ++round) {
+		for (std::size_t i{ 0 }; i < m_textures.size(); ++i)
+			m_textureTable.replace(static_cast<uint32_t>(i), m_textures[i].imageView);
+		written += m_textureTable.flush();
 	}
+	std::chrono::duration<double, std::nano> elapsed{ std::chrono::steady_clock::now() - startTime };
 
+	fmt::println("[Kleicha] Descriptor benchmark ({}): {} writes in {} rounds, {:.3f} ms, {:.1f} ns per descriptor.",
+		m_bUseDescriptorBuffer ? "descriptor buffer" : "descriptor set", written, rounds, elapsed.count() / 1e6,
+		written > 0 ? elapsed.count() / static_cast<double>(written) : 0.0);
 }
 
 // for uploading texture cube maps
@@ -602,11 +828,13 @@ vkt::Image Kleicha::upload_texture_image(const char** filePaths) {
 	textureImage.mipLevels = 1;
 	VkImageCreateInfo textureImageInfo{ init::create_image_info(VK_FORMAT_R8G8B8A8_SRGB, textureExtent, VK_IMAGE_USAGE_TRANSFER_SRC_BIT | VK_IMAGE_USAGE_TRANSFER_DST_BIT | VK_IMAGE_USAGE_SAMPLED_BIT, textureImage.mipLevels, 6) };
 	VK_CHECK(vmaCreateImage(m_allocator, &textureImageInfo, &allocationInfo, &textureImage.image, &textureImage.allocation, &textureImage.allocationInfo));
+	m_memoryTracker.track(textureImage, MemoryTracker::TEXTURES, "texture");
 	VkImageViewCreateInfo imageViewInfo{ init::create_image_view_info(textureImage.image, VK_FORMAT_R8G8B8A8_SRGB, VK_IMAGE_ASPECT_COLOR_BIT, textureImage.mipLevels, 6) };
 	VK_CHECK(vkCreateImageView(m_device.device, &imageViewInfo, nullptr, &textureImage.imageView));
 
 	vkt::Buffer stagingBuffer{ utils::create_buffer(m_allocator, bufferSize, VK_BUFFER_USAGE_TRANSFER_SRC_BIT, VMA_MEMORY_USAGE_AUTO_PREFER_DEVICE,
 		VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT, VMA_ALLOCATION_CREATE_HOST_ACCESS_SEQUENTIAL_WRITE_BIT | VMA_ALLOCATION_CREATE_MAPPED_BIT) };
+	m_memoryTracker.track(stagingBuffer, MemoryTracker::STAGING, "staging");
 
 	// unify cube texture faces into staging buffer
 	for (std::size_t i{ 0 }; i < 6; ++i) {
@@ -633,7 +861,7 @@ vkt::Image Kleicha::upload_texture_image(const char** filePaths) {
 
 		});
 
-	vmaDestroyBuffer(m_allocator, stagingBuffer.buffer, stagingBuffer.allocation);
+	m_memoryTracker.destroy(stagingBuffer);
 
 	return textureImage;
 }
@@ -665,6 +893,7 @@ vkt::Image Kleicha::upload_texture_image_ktx(const vkt::Texture& texture) {
 	
 	VkImageCreateInfo textureImageInfo{ init::create_image_info(ktxTexFormat, VkExtent2D{uiTexWidth, uiTexHeight}, VK_IMAGE_USAGE_TRANSFER_SRC_BIT | VK_IMAGE_USAGE_TRANSFER_DST_BIT | VK_IMAGE_USAGE_SAMPLED_BIT, textureImage.mipLevels, layerCount)};
 	VK_CHECK(vmaCreateImage(m_allocator, &textureImageInfo, &allocationInfo, &textureImage.image, &textureImage.allocation, &textureImage.allocationInfo));
+	m_memoryTracker.track(textureImage, MemoryTracker::TEXTURES, "texture");
 	VkImageViewCreateInfo imageViewInfo{ init::create_image_view_info(textureImage.image, ktxTexFormat, VK_IMAGE_ASPECT_COLOR_BIT, textureImage.mipLevels, layerCount) };
 	VK_CHECK(vkCreateImageView(m_device.device, &imageViewInfo, nullptr, &textureImage.imageView));
 
@@ -686,6 +915,7 @@ vkt::Image Kleicha::upload_texture_image_ktx(const vkt::Texture& texture) {
 
 			vkt::Buffer stagingBuffer{ utils::create_buffer(m_allocator, uiTexDataSize, VK_BUFFER_USAGE_TRANSFER_SRC_BIT, VMA_MEMORY_USAGE_AUTO_PREFER_DEVICE,
 			VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT, VMA_ALLOCATION_CREATE_HOST_ACCESS_SEQUENTIAL_WRITE_BIT | VMA_ALLOCATION_CREATE_MAPPED_BIT) };
+			m_memoryTracker.track(stagingBuffer, MemoryTracker::STAGING, "staging");
 			memcpy(stagingBuffer.allocationInfo.pMappedData, ktxTexData + offset, uiTexDataSize);
 
 			immediate_submit([&](VkCommandBuffer cmdBuffer) {
@@ -702,7 +932,7 @@ vkt::Image Kleicha::upload_texture_image_ktx(const vkt::Texture& texture) {
 				vkCmdCopyBufferToImage(cmdBuffer, stagingBuffer.buffer, textureImage.image, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, 1, &imageCopy);
 				});
 
-			vmaDestroyBuffer(m_allocator, stagingBuffer.buffer, stagingBuffer.allocation);
+			m_memoryTracker.destroy(stagingBuffer);
 		}
 
 		uiTexWidth = uiTexWidth >> 1;
@@ -745,12 +975,14 @@ vkt::Image Kleicha::upload_texture_image(const char* filePath, VkFormat format)
 	// allocate device_local memory to store the texture image
 	VkImageCreateInfo textureImageInfo{ init::create_image_info(format, textureExtent, VK_IMAGE_USAGE_TRANSFER_SRC_BIT | VK_IMAGE_USAGE_TRANSFER_DST_BIT | VK_IMAGE_USAGE_SAMPLED_BIT, textureImage.mipLevels) };
 	VK_CHECK(vmaCreateImage(m_allocator, &textureImageInfo, &allocationInfo, &textureImage.image, &textureImage.allocation, &textureImage.allocationInfo));
+	m_memoryTracker.track(textureImage, MemoryTracker::TEXTURES, "texture");
 	VkImageViewCreateInfo imageViewInfo{ init::create_image_view_info(textureImage.image, format, VK_IMAGE_ASPECT_COLOR_BIT, textureImage.mipLevels) };
 	VK_CHECK(vkCreateImageView(m_device.device, &imageViewInfo, nullptr, &textureImage.imageView));
 
 	// allocate host visible mapped memory
 	vkt::Buffer stagingBuffer{ utils::create_buffer(m_allocator, bufferSize, VK_BUFFER_USAGE_TRANSFER_SRC_BIT, VMA_MEMORY_USAGE_AUTO_PREFER_DEVICE,
 		VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT, VMA_ALLOCATION_CREATE_HOST_ACCESS_SEQUENTIAL_WRITE_BIT | VMA_ALLOCATION_CREATE_MAPPED_BIT) };
+	m_memoryTracker.track(stagingBuffer, MemoryTracker::STAGING, "staging");
 	memcpy(stagingBuffer.allocationInfo.pMappedData, textureData, bufferSize);
 
 	// safe to deallocate now
@@ -827,27 +1059,10 @@ vkt::Image Kleicha::upload_texture_image(const char* filePath, VkFormat format)
 
 		});
 
-	vmaDestroyBuffer(m_allocator, stagingBuffer.buffer, stagingBuffer.allocation);
+	m_memoryTracker.destroy(stagingBuffer);
 	return textureImage;
 }
 
-void Kleicha::deallocate_frame_images() const {
-
-	vkDestroyImageView(m_device.device, rasterImage.imageView, nullptr);
-	vmaDestroyImage(m_allocator, rasterImage.image, rasterImage.allocation);
-
-	vkDestroyImageView(m_device.device, depthImage.imageView, nullptr);
-	vmaDestroyImage(m_allocator, depthImage.image, depthImage.allocation);
-
-	for (const auto& frame : m_frames) {
-		for (const auto& shadowMap : frame.shadowMaps) {
-			vmaDestroyImage(m_allocator, shadowMap.image, shadowMap.allocation);
-			vkDestroyImageView(m_device.device, shadowMap.imageView, nullptr);
-		}
-	}
-
-}
-
 void Kleicha::immediate_submit(std::function<void(VkCommandBuffer cmdBuffer)>&& func) const {
 	vkResetFences(m_device.device, 1, &m_immFence);
 	vkResetCommandBuffer(m_immCmdBuffer, 0);
@@ -876,6 +1091,8 @@ void Kleicha::immediate_submit(std::function<void(VkCommandBuffer cmdBuffer)>&&
 }
 
 void Kleicha::recreate_swapchain() {
+	PROFILE_ZONE("recreate_swapchain");
+#ifndef KLEICHA_HEADLESS_ONLY
 	// handle case where window is minimized
 	int width{}, height{};
 	glfwGetFramebufferSize(m_window, &width, &height);
@@ -885,17 +1102,16 @@ void Kleicha::recreate_swapchain() {
 		glfwGetFramebufferSize(m_window, &width, &height);
 		glfwPollEvents();
 	}
+#endif
 
-	// host waits for all work in queue to conclude
-	VK_CHECK(vkDeviceWaitIdle(m_device.device));
-
-	// cleanup swapchain and raster images
-	for (const auto& view : m_swapchain.imageViews)
-		vkDestroyImageView(m_device.device, view, nullptr);
-
-	vkDestroySwapchainKHR(m_device.device, m_swapchain.swapchain, nullptr);
-
-	deallocate_frame_images();
+	// frames still in flight may use the old swapchain and presents from it may still wait on its semaphores, so instead of
+	// waiting for the device to idle it's retired. the render graph replaces its images through the deletion queue once it
+	// sees the new extent.
+	RetiredSwapchain retired{ .m_swapchain = m_swapchain.swapchain, .m_imageViews = std::move(m_swapchain.imageViews),
+		.m_renderedSemaphores = std::move(m_renderedSemaphores), .m_presentFences = std::move(m_presentFences) };
+	m_renderedSemaphores.clear();
+	m_presentFences.clear();
+	m_bSwapchainSuboptimal = false;
 
 	// get updated surface support details
 	DeviceBuilder builder{ m_instance.instance, m_surface };
@@ -909,307 +1125,720 @@ void Kleicha::recreate_swapchain() {
 	m_perspProj = utils::orthographicProj(glm::radians(90.0f),
 		static_cast<float>(m_windowExtent.width) / m_windowExtent.height, 1000.0f, 0.1f) * utils::perspective(1000.0f, 0.1f);
 	init_swapchain();
-	init_image_buffers(true);
-
-	// update per frame shadow map descriptors to reference the new image buffers
-	for (const auto& frame : m_frames) {
-		utils::update_set_image_sampler_descriptor(m_device.device, frame.descriptorSet, 3, VK_IMAGE_LAYOUT_DEPTH_READ_ONLY_OPTIMAL, m_shadowSampler, frame.shadowMaps);
-	}
+	init_present_sync();
+
+	// the present fences say when the old presents are done, the frame being drawn may have used the swapchain as well. without
+	// them a pending present is only known to be done once the new swapchain has cycled through its images, which can't
+	// happen before every older present was consumed, plus the frames in flight that may still be queued behind those.
+	retired.m_uiReleaseFrame = m_framesRendered;
+	if (!m_bUsePresentFences)
+		retired.m_uiReleaseFrame += static_cast<uint32_t>(m_swapchain.imageCount) + m_framesInFlight;
+	m_retiredSwapchains.push_back(std::move(retired));
+	fmt::println("[Kleicha] Recreated swapchain at {}x{}, {} swapchains retired, {} resources pending deletion.", m_swapchain.imageExtent.width,
+		m_swapchain.imageExtent.height, m_retiredSwapchains.size(), m_deletionQueue.size());
 }
 
-void Kleicha::update_dynamic_buffers(const vkt::Frame& frame, [[maybe_unused]] float currentTime, [[maybe_unused]] const glm::mat4& shadowCubePerspProj) {
+void Kleicha::collect_retired_swapchains(uint32_t completedFrame) {
+	// retired in order, a later swapchain is never released before an earlier one
+	while (!m_retiredSwapchains.empty()) {
+		const RetiredSwapchain& retired{ m_retiredSwapchains.front() };
+		if (retired.m_uiReleaseFrame > completedFrame)
+			return;
 
-	// update light views
-	/*for (auto& light : m_pointLights) {
-		light.viewProj = m_perspProj * utils::lookAt(light.mPos, glm::vec3{ 0.0f, 0.0f, 0.0f }, WORLD_UP);
+		for (VkFence presentFence : retired.m_presentFences) {
+			if (vkGetFenceStatus(m_device.device, presentFence) != VK_SUCCESS)
+				return;
+		}
 
-		light.cubeViewProjs[1] = shadowCubePerspProj * glm::lookAt(light.mPos, light.mPos + glm::vec3{ 1.0f, 0.0f, 0.0f }, glm::vec3{ 0.0f, 1.0f, 0.0f });	// +X
-		light.cubeViewProjs[0] = shadowCubePerspProj * glm::lookAt(light.mPos, light.mPos + glm::vec3{ -1.0f, 0.0f, 0.0f }, glm::vec3{ 0.0f, 1.0f, 0.0f }); // -X
+		destroy_retired_swapchain(retired);
+		m_retiredSwapchains.pop_front();
+	}
+}
 
-		light.cubeViewProjs[2] = shadowCubePerspProj * glm::lookAt(light.mPos, light.mPos + glm::vec3{ 0.0f, -1.0f, 0.0f }, glm::vec3{ 0.0f, 0.0f, -1.0f });  // +Y
-		light.cubeViewProjs[3] = shadowCubePerspProj * glm::lookAt(light.mPos, light.mPos + glm::vec3{ 0.0f, 1.0f, 0.0f }, glm::vec3{ 0.0f, 0.0f, 1.0f });	  // -Y
+void Kleicha::destroy_retired_swapchain(const RetiredSwapchain& retired) const {
+	for (const auto& view : retired.m_imageViews)
+		vkDestroyImageView(m_device.device, view, nullptr);
+	for (const auto& renderedSemaphore : retired.m_renderedSemaphores)
+		vkDestroySemaphore(m_device.device, renderedSemaphore, nullptr);
+	for (const auto& presentFence : retired.m_presentFences)
+		vkDestroyFence(m_device.device, presentFence, nullptr);
+	vkDestroySwapchainKHR(m_device.device, retired.m_swapchain, nullptr);
+}
 
-		light.cubeViewProjs[5] = shadowCubePerspProj * glm::lookAt(light.mPos, light.mPos + glm::vec3{ 0.0f, 0.0f, 1.0f }, glm::vec3{ 0.0f, 1.0f, 0.0f });	  // -Z
-		light.cubeViewProjs[4] = shadowCubePerspProj * glm::lookAt(light.mPos, light.mPos + glm::vec3{ 0.0f, 0.0f, -1.0f }, glm::vec3{ 0.0f, 1.0f, 0.0f });	  // +Z
-	}*/
+void Kleicha::update_frame_data() {
+	PROFILE_ZONE("update_frame_data");
 
-	m_globalData.m_v3CameraPosition = m_camera.get_world_pos();
 	m_globalData.m_uiNumPointLights = static_cast<uint32_t>(m_pointLights.size());
+	m_globalData.m_uiUseShadows = m_bUseShadows;
+	m_globalData.m_uiUseClusters = use_clusters();
 
 	for (auto& transform : m_meshTransforms) {
 		transform.m_m4ModelInvTr = glm::transpose(glm::inverse(transform.m_m4Model));
 	}
 
-	memcpy(m_globalsBuffer.allocation->GetMappedData(), &m_globalData, sizeof(m_globalData));
+	cull_shadow_casters();
+	// also updates each light's radius which the clusters are built from
+	assign_shadow_tiles();
+
+	if (use_clusters())
+		build_light_clusters();
+
+	for (std::size_t j{ 0 }; j < m_pointLights.size(); ++j) {
+		m_shadowCache.update(j, m_pointLights[j], m_shadowCasters[j], m_draws, m_meshTransforms);
+	}
+}
+
+void Kleicha::upload_frame_data(const vkt::Frame& frame) {
+	PROFILE_ZONE("upload_frame_data");
+
+	memcpy(frame.globalsBuffer.allocation->GetMappedData(), &m_globalData, sizeof(m_globalData));
 
 	// update per frame buffers
 	memcpy(frame.transformBuffer.allocation->GetMappedData(), m_meshTransforms.data(), sizeof(vkt::Transform) * m_meshTransforms.size());
 	memcpy(frame.materialBuffer.allocation->GetMappedData(), m_materials.data(), sizeof(vkt::Material) * m_materials.size());
 	memcpy(frame.lightBuffer.allocation->GetMappedData(), m_pointLights.data(), sizeof(vkt::PointLight) * m_pointLights.size());
 
+	if (use_clusters()) {
+		const std::vector<vkt::Cluster>& clusters{ m_lightClusters.get_clusters() };
+		const std::vector<uint32_t>& lightIndices{ m_lightClusters.get_light_indices() };
+		memcpy(frame.clusterBuffer.allocation->GetMappedData(), clusters.data(), sizeof(vkt::Cluster) * clusters.size());
+		memcpy(frame.clusterLightBuffer.allocation->GetMappedData(), lightIndices.data(), sizeof(uint32_t) * lightIndices.size());
+	}
+
+	// when late latching the camera is written right before submission instead
+	if (!m_bLateLatch)
+		write_camera_data(frame);
+
 	//TODO: On our graphice device, all host-visible device memory is cache coherent. However, this is not guaranteed on other devices. On devices where this memory
 	// does not have the property 'VK_MEMORY_PROPERTY_HOST_COHERENT_BIT', we should make all host writes visible before
 	// the below draw calls using a pipeline barrier.
 }
 
-void Kleicha::record_draws(const vkt::Frame& frame, VkPipeline* opaquePipeline, [[maybe_unused]]VkPipeline* alphaPipeline) {
+void Kleicha::record_draws(const vkt::Frame& frame, VkPipeline* opaquePipeline, VkPipeline* transparentPipeline) {
+	PROFILE_ZONE("record_draws");
 
 	assert(opaquePipeline);
 	vkCmdBindPipeline(frame.cmdBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, *opaquePipeline);
 
-	for (std::uint32_t i{ 0 }; i < m_draws.size(); ++i) {
-		m_pushConstants.drawId = i;
-		vkCmdPushConstants(frame.cmdBuffer, m_dummyPipelineLayout, VK_SHADER_STAGE_ALL, 0, sizeof(vkt::PushConstants), &m_pushConstants);
-		vkCmdDrawIndexed(frame.cmdBuffer, m_draws[i].m_uiIndicesCount, 1, m_draws[i].m_uiIndicesOffset, m_draws[i].m_iVertexOffset, 0);
+	if (!transparentPipeline) {
+		for (std::uint32_t i{ 0 }; i < m_draws.size(); ++i)
+			record_draw(frame, i);
+		return;
 	}
+
+	for (uint32_t drawId : m_opaqueDrawIds)
+		record_draw(frame, drawId);
+
+	vkCmdBindPipeline(frame.cmdBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, *transparentPipeline);
+	for (uint32_t drawId : m_transparentDrawIds)
+		record_draw(frame, drawId);
 }
 
-void Kleicha::shadow_cube_pass(const vkt::Frame& frame) {
+void Kleicha::record_draw(const vkt::Frame& frame, uint32_t drawId) {
+	m_pushConstants.drawId = drawId;
+	vkCmdPushConstants(frame.cmdBuffer, m_dummyPipelineLayout, VK_SHADER_STAGE_ALL, 0, sizeof(vkt::PushConstants), &m_pushConstants);
+	vkCmdDrawIndexed(frame.cmdBuffer, m_draws[drawId].m_uiIndicesCount, 1, m_draws[drawId].m_uiIndicesOffset, m_draws[drawId].m_iVertexOffset, 0);
+	++m_totalDraws;
+}
 
-	utils::set_viewport_scissor(frame, SHADOW_CUBE_EXTENT);
+// builds per light caster lists from a sphere test between each draw's world bounds and the light's effective radius
+void Kleicha::cull_shadow_casters() {
+	PROFILE_ZONE("cull_shadow_casters");
 
-	VkClearValue colorClearValue{ {{FLT_MAX, 0.0f, 0.0f, 1.0f}} };
-	VkClearValue depthClearValue{ .depthStencil = {0.0f, 0U} };
+	m_shadowCasters.resize(m_pointLights.size());
 
-	VkRenderingInfo cubeShadowRenderingInfo{ .sType = VK_STRUCTURE_TYPE_RENDERING_INFO };
-	cubeShadowRenderingInfo.pNext = nullptr;
-	cubeShadowRenderingInfo.renderArea.extent = SHADOW_CUBE_EXTENT;
-	cubeShadowRenderingInfo.renderArea.offset = { 0,0 };
-	cubeShadowRenderingInfo.layerCount = 1;
-	cubeShadowRenderingInfo.viewMask = 0b111111; // each bit of this bitfield specifies which views are active during rendering. our cubemap requires 6 views thus we enable views 0 through to 5.
-	cubeShadowRenderingInfo.colorAttachmentCount = 1;
+	m_drawBounds.resize(m_draws.size());
+	for (std::size_t i{ 0 }; i < m_draws.size(); ++i) {
+		const vkt::HostDrawData& draw{ m_draws[i] };
+		m_drawBounds[i] = utils::compute_bounding_sphere(draw.m_v3BoundsMin, draw.m_v3BoundsMax, m_meshTransforms[draw.m_uiTransformIndex].m_m4Model);
+	}
 
-	vkCmdBindPipeline(frame.cmdBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, m_cubeShadowPipeline);
+	for (std::size_t j{ 0 }; j < m_pointLights.size(); ++j) {
+		const vkt::PointLight& light{ m_pointLights[j] };
+		float lightRadius{ utils::compute_light_radius(light, LIGHT_CUTOFF_INTENSITY) };
 
-	for (uint32_t j{ 0 }; j < m_pointLights.size(); ++j) {
-		VkRenderingAttachmentInfo cubeColorAttachment{ init::create_rendering_attachment_info(frame.cubeShadowMaps[j].colorImage.imageView, VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL, &colorClearValue) };
-		VkRenderingAttachmentInfo cubeDepthAttachment{ init::create_rendering_attachment_info(frame.cubeShadowMaps[j].depthImage.imageView, VK_IMAGE_LAYOUT_DEPTH_ATTACHMENT_OPTIMAL, &depthClearValue) };
+		std::vector<vkt::ShadowCaster>& casters{ m_shadowCasters[j] };
+		casters.clear();
 
-		cubeShadowRenderingInfo.pColorAttachments = &cubeColorAttachment;
-		cubeShadowRenderingInfo.pDepthAttachment = &cubeDepthAttachment;
+		for (uint32_t i{ 0 }; i < m_draws.size(); ++i) {
+			const vkt::BoundingSphere& bounds{ m_drawBounds[i] };
+			glm::vec3 toDraw{ bounds.m_v3Center - light.m_v3Position };
+			float reach{ lightRadius + bounds.m_fRadius };
 
-		//m_pushConstants.lightId = j;
+			// lightRadius may be FLT_MAX for lights without distance attenuation
+			if (lightRadius < std::numeric_limits<float>::max() && glm::dot(toDraw, toDraw) > reach * reach)
+				continue;
 
-		vkCmdBeginRendering(frame.cmdBuffer, &cubeShadowRenderingInfo);
+			uint32_t faceMask{ utils::compute_cube_face_mask(light.m_v3Position, bounds) };
+			if (faceMask == 0)
+				continue;
 
-		for (std::uint32_t i{ 0 }; i < m_draws.size(); ++i) {
-			m_pushConstants.drawId = i;
-			vkCmdPushConstants(frame.cmdBuffer, m_dummyPipelineLayout, VK_SHADER_STAGE_ALL, 0, sizeof(vkt::PushConstants), &m_pushConstants);
-			vkCmdDrawIndexed(frame.cmdBuffer, m_draws[i].m_uiIndicesCount, 1, m_draws[i].m_uiIndicesOffset, m_draws[i].m_iVertexOffset, 0);
+			casters.push_back(vkt::ShadowCaster{ .m_uiDrawIndex = i, .m_uiFaceMask = faceMask });
 		}
+	}
+}
+
+// sizes each light's tiles by its screen space importance, packs them into the atlas and updates the light's face projections
+void Kleicha::assign_shadow_tiles() {
+
+	glm::vec3 cameraPosition{ m_camera.get_world_pos() };
 
-		vkCmdEndRendering(frame.cmdBuffer);
-		// transition shadow cube map
-		utils::image_memory_barrier(frame.cmdBuffer, VK_PIPELINE_STAGE_2_COLOR_ATTACHMENT_OUTPUT_BIT, VK_ACCESS_2_COLOR_ATTACHMENT_WRITE_BIT, VK_PIPELINE_STAGE_2_FRAGMENT_SHADER_BIT,
-			VK_ACCESS_2_SHADER_SAMPLED_READ_BIT, VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL, frame.cubeShadowMaps[j].colorImage.image, 1);
+	std::vector<uint32_t> desiredSizes(m_pointLights.size());
+	for (std::size_t j{ 0 }; j < m_pointLights.size(); ++j) {
+		vkt::PointLight& light{ m_pointLights[j] };
+		// lights without distance attenuation have an unbounded radius, their shadows end at the far plane
+		light.m_fRadius = std::min(utils::compute_light_radius(light, LIGHT_CUTOFF_INTENSITY), SHADOW_MAX_RANGE);
+		desiredSizes[j] = utils::compute_shadow_tile_size(cameraPosition, light.m_v3Position, light.m_fRadius, m_swapchain.imageExtent.height);
+	}
+
+	m_shadowAtlas.pack(desiredSizes);
+
+	for (std::size_t j{ 0 }; j < m_pointLights.size(); ++j) {
+		vkt::PointLight& light{ m_pointLights[j] };
+		utils::compute_cube_face_view_projs(light.m_v3Position, light.m_m4FaceViewProj);
+
+		for (uint32_t face{ 0 }; face < 6; ++face) {
+			const vkt::AtlasTile& tile{ m_shadowAtlas.get_tile(j, face) };
+			light.m_uv4ShadowTiles[face] = glm::uvec4{ tile.m_uiX, tile.m_uiY, tile.m_uiSize, 0 };
+		}
 	}
 }
 
-void Kleicha::shadow_2D_pass(const vkt::Frame& frame) {
+std::vector<uint32_t> Kleicha::collect_stale_shadow_lights() {
+	std::vector<uint32_t> staleLights{};
+	for (uint32_t j{ 0 }; j < m_pointLights.size(); ++j) {
+		if (!m_shadowCache.is_stale(j))
+			continue;
 
-	VkClearValue colorClearValue{ {{0.0f, 0.0f, 0.0f, 1.0f}} };
-	VkClearValue depthClearValue{ .depthStencil = {0.0f, 0U} };
-	utils::set_viewport_scissor(frame, m_swapchain.imageExtent);
+		// lights that weren't given tiles have nothing to render
+		if (m_shadowAtlas.get_tile(j, 0).m_uiSize == 0) {
+			m_shadowCache.mark_rendered(j);
+			continue;
+		}
+
+		staleLights.push_back(j);
+	}
+
+	return staleLights;
+}
+
+void Kleicha::shadow_atlas_pass(const vkt::Frame& frame, const std::vector<uint32_t>& staleLights) {
+	PROFILE_ZONE("shadow_atlas_pass");
+
+	// the atlas is loaded so that cached tiles survive, stale tiles are cleared individually below
+	VkRenderingAttachmentInfo atlasAttachment{ init::create_rendering_attachment_info(m_shadowAtlasImage.imageView, VK_IMAGE_LAYOUT_DEPTH_ATTACHMENT_OPTIMAL, nullptr, VK_TRUE) };
 
 	VkRenderingInfo renderingInfo{ .sType = VK_STRUCTURE_TYPE_RENDERING_INFO };
 	renderingInfo.pNext = nullptr;
-	renderingInfo.renderArea.extent = m_swapchain.imageExtent;
+	renderingInfo.renderArea.extent = { m_shadowAtlas.get_extent(), m_shadowAtlas.get_extent() };
 	renderingInfo.renderArea.offset = { 0,0 };
 	renderingInfo.layerCount = 1;
 	renderingInfo.viewMask = 0; //we're not using multiview
 	renderingInfo.colorAttachmentCount = 0;
 	renderingInfo.pColorAttachments = nullptr;
+	renderingInfo.pDepthAttachment = &atlasAttachment;
+
+	vkCmdBeginRendering(frame.cmdBuffer, &renderingInfo);
+
+	// reset the stale tiles to the far plane
+	std::vector<VkClearRect> clearRects{};
+	for (uint32_t j : staleLights) {
+		for (uint32_t face{ 0 }; face < 6; ++face) {
+			const vkt::AtlasTile& tile{ m_shadowAtlas.get_tile(j, face) };
+			VkClearRect clearRect{};
+			clearRect.rect.offset = { static_cast<int32_t>(tile.m_uiX), static_cast<int32_t>(tile.m_uiY) };
+			clearRect.rect.extent = { tile.m_uiSize, tile.m_uiSize };
+			clearRect.baseArrayLayer = 0;
+			clearRect.layerCount = 1;
+			clearRects.push_back(clearRect);
+		}
+	}
+	VkClearAttachment clearAttachment{ .aspectMask = VK_IMAGE_ASPECT_DEPTH_BIT, .clearValue = {.depthStencil = {0.0f, 0U} } };
+	vkCmdClearAttachments(frame.cmdBuffer, 1, &clearAttachment, static_cast<uint32_t>(clearRects.size()), clearRects.data());
 
-	//m_pushConstants.m_m4ViewProjection = m_perspProj;
+	vkCmdBindPipeline(frame.cmdBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, m_shadowAtlasPipeline);
 
-	vkCmdBindPipeline(frame.cmdBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, m_shadowPipeline);
+	for (uint32_t j : staleLights) {
+		m_pushConstants.lightId = j;
 
-	// shadow passes
-	for (uint32_t j{ 0 }; j < m_pointLights.size(); ++j) {
-		VkRenderingAttachmentInfo shadowDepthAttachment{ init::create_rendering_attachment_info(frame.shadowMaps[j].imageView, VK_IMAGE_LAYOUT_DEPTH_ATTACHMENT_OPTIMAL, &depthClearValue, VK_TRUE) };
-		renderingInfo.pDepthAttachment = &shadowDepthAttachment;
-		
-		vkCmdBeginRendering(frame.cmdBuffer, &renderingInfo);
+		for (uint32_t face{ 0 }; face < 6; ++face) {
+			utils::set_viewport_scissor(frame, m_shadowAtlas.get_tile(j, face));
+			m_pushConstants.m_m4ViewProjection = m_pointLights[j].m_m4FaceViewProj[face];
 
-		//m_pushConstants.lightId = j;
+			// only draws that can reach this face are rendered into its tile
+			for (const auto& caster : m_shadowCasters[j]) {
+				if ((caster.m_uiFaceMask & (1u << face)) == 0)
+					continue;
 
-		for (std::uint32_t i{ 0 }; i < m_draws.size(); ++i) {
-			m_pushConstants.drawId = i;
-			vkCmdPushConstants(frame.cmdBuffer, m_dummyPipelineLayout, VK_SHADER_STAGE_ALL, 0, sizeof(vkt::PushConstants), &m_pushConstants);
-			vkCmdDrawIndexed(frame.cmdBuffer, m_draws[i].m_uiIndicesCount, 1, m_draws[i].m_uiIndicesOffset, m_draws[i].m_iVertexOffset, 0);
+				const vkt::HostDrawData& draw{ m_draws[caster.m_uiDrawIndex] };
+				m_pushConstants.drawId = caster.m_uiDrawIndex;
+				vkCmdPushConstants(frame.cmdBuffer, m_dummyPipelineLayout, VK_SHADER_STAGE_ALL, 0, sizeof(vkt::PushConstants), &m_pushConstants);
+				vkCmdDrawIndexed(frame.cmdBuffer, draw.m_uiIndicesCount, 1, draw.m_uiIndicesOffset, draw.m_iVertexOffset, 0);
+				++m_totalDraws;
+			}
 		}
-		vkCmdEndRendering(frame.cmdBuffer);
+
+		m_shadowCache.mark_rendered(j);
 	}
+
+	vkCmdEndRendering(frame.cmdBuffer);
+}
+
+// bins the lights into the froxel grid of the current view and uploads each cluster's light list
+void Kleicha::build_light_clusters() {
+	PROFILE_ZONE("build_light_clusters");
+
+	// the main pass projection has a 90 degree vertical field of view
+	float aspectRatio{ static_cast<float>(m_windowExtent.width) / m_windowExtent.height };
+	m_lightClusters.build(m_pointLights, m_camera.getViewMatrix(), aspectRatio, 1.0f);
+}
+
+void Kleicha::add_point_light(const vkt::PointLight& light) {
+	m_pointLights.push_back(light);
+	// the new light starts out stale, its tiles come from the next atlas pack
+	m_shadowCache.resize(m_pointLights.size());
+}
+
+void Kleicha::remove_point_light(std::size_t lightIndex) {
+	m_pointLights.erase(m_pointLights.begin() + static_cast<std::ptrdiff_t>(lightIndex));
+	m_shadowCache.resize(m_pointLights.size());
+	// the lights after it moved down an index, their cached tiles belonged to other lights
+	for (std::size_t j{ lightIndex }; j < m_pointLights.size(); ++j)
+		m_shadowCache.invalidate(j);
+}
+
+void Kleicha::create_light_buffer(vkt::Frame& frame, uint32_t capacity) {
+	frame.lightBuffer = utils::create_buffer(m_allocator, sizeof(vkt::PointLight) * capacity, VK_BUFFER_USAGE_SHADER_DEVICE_ADDRESS_BIT,
+		VMA_MEMORY_USAGE_AUTO_PREFER_DEVICE, VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT, VMA_ALLOCATION_CREATE_HOST_ACCESS_SEQUENTIAL_WRITE_BIT | VMA_ALLOCATION_CREATE_MAPPED_BIT);
+	m_memoryTracker.track(frame.lightBuffer, MemoryTracker::PER_FRAME, "lights");
+	frame.lightBuffer.deviceAddress = utils::get_buffer_device_address(m_device.device, frame.lightBuffer.buffer);
+	frame.lightCapacity = capacity;
+}
+
+// only called once the frame's fence has signaled, nothing in flight uses the slot's light buffer or scene addresses anymore
+void Kleicha::ensure_light_capacity(vkt::Frame& frame) {
+	uint32_t lightCount{ static_cast<uint32_t>(m_pointLights.size()) };
+	if (lightCount <= frame.lightCapacity)
+		return;
+
+	m_memoryTracker.destroy(frame.lightBuffer);
+	create_light_buffer(frame, std::bit_ceil(lightCount));
+	// shaders reach the lights through their address, no descriptor has to be rewritten
+	write_scene_addresses(frame);
+	fmt::println("[Kleicha] Grew a frame's light buffer to {} lights.", frame.lightCapacity);
+}
+
+void Kleicha::apply_light_benchmark_step() {
+
+	const LightBenchmark::Step& step{ m_lightBenchmark.get_step() };
+	m_pointLights.assign(m_benchmarkLights.begin(), m_benchmarkLights.begin() + step.m_uiLightCount);
+	m_shadowCache.resize(m_pointLights.size());
+	m_bUseClusters = step.m_bClustered;
 }
 
 void Kleicha::start() {
 
-	while (!glfwWindowShouldClose(m_window)) {
-		glfwPollEvents();
-		float currentTime{ static_cast<float>(glfwGetTime()) };
+	auto startTime{ std::chrono::steady_clock::now() };
+	float recordStartTime{};
+	float lastKeyframeTime{};
+	while (!m_bQuit && !is_window_closed()) {
+		PROFILE_ZONE("frame");
+		m_frameStartTime = std::chrono::steady_clock::now();
+		float currentTime{};
+		if (m_config.m_bHeadless) {
+			currentTime = std::chrono::duration<float>{ m_frameStartTime - startTime }.count();
+		}
+		else {
+			PROFILE_ZONE("poll_events");
+#ifndef KLEICHA_HEADLESS_ONLY
+			glfwPollEvents();
+			currentTime = static_cast<float>(glfwGetTime());
+#endif
+		}
+
+		// the first press starts profiling, later presses write what was recorded since
+		if (m_bWriteCpuTrace) {
+			m_bWriteCpuTrace = false;
+			if (CpuProfiler::is_enabled())
+				CpuProfiler::write_trace(m_config.m_cpuTracePath);
+			else
+				CpuProfiler::set_enabled(true);
+		}
+
+		if (m_bWriteMemoryStats) {
+			m_bWriteMemoryStats = false;
+			m_memoryTracker.write_stats(m_config.m_memoryStatsPath);
+		}
+
+		// replays advance by a fixed timestep no matter how long the frames take, so every run renders the same frames
+		if (m_pathBenchmark.is_running()) {
+			currentTime = m_pathBenchmark.get_time();
+			CameraPath::Keyframe keyframe{ m_cameraPath.sample(currentTime) };
+			m_camera.set_pose(keyframe.m_v3Position, keyframe.m_fYaw, keyframe.m_fPitch);
+		}
+
 		m_deltaTime = currentTime - m_lastFrame;
 		m_lastFrame = currentTime;
 
-		ImGui_ImplVulkan_NewFrame();
-		ImGui_ImplGlfw_NewFrame();
-		ImGui::NewFrame();
+		if (!m_config.m_recordCameraPath.empty() && (m_recordedPath.is_empty() || currentTime - lastKeyframeTime >= CAMERA_RECORD_INTERVAL)) {
+			if (m_recordedPath.is_empty())
+				recordStartTime = currentTime;
 
-		ImGui::Checkbox("Blinn-Phong", &m_bUseBlinnPhong);
-		ImGui::Checkbox("Emissive Materials", reinterpret_cast<bool*>(&m_globalData.m_uiUseEmissive));
+			m_recordedPath.add_keyframe(CameraPath::Keyframe{ .m_fTime = currentTime - recordStartTime, .m_v3Position = m_camera.get_world_pos(),
+				.m_fYaw = m_camera.get_yaw(), .m_fPitch = m_camera.get_pitch() });
+			lastKeyframeTime = currentTime;
+		}
 
-		if (ImGui::CollapsingHeader("Lights")) {
+		if (!m_config.m_bHeadless)
+			build_imgui();
 
-			for (std::size_t i{ 0 }; i < m_pointLights.size(); ++i) {
-				ImGui::PushID(static_cast<int>(i));
-				ImGui::Text("Light %d", i);
-				ImGui::SliderFloat3("Light World Pos", &m_pointLights[i].m_v3Position.x, -10.0f, 50.0f);
-				//ImGui::ColorPicker3("Light Ambient", &m_pointLights[i].ambient.r);)
-				ImGui::SliderFloat3("Light Color", &m_pointLights[i].m_v3Color.r, 0.0f, 1.0f);
-				ImGui::SliderFloat3("Light Falloff", &m_pointLights[i].m_fFalloff.r, 0.0f, 10.0f);
-				ImGui::NewLine();
-				ImGui::PopID();
-			}
-		}
+		draw(currentTime);
 
+		m_fCpuFrameTime = std::chrono::duration<float>{ std::chrono::steady_clock::now() - m_frameStartTime }.count();
+		if (m_pathBenchmark.is_running()) {
+			m_pathBenchmark.record_frame(m_framesRendered - 1, m_fCpuFrameTime, m_totalDraws);
+			if (!m_pathBenchmark.is_running())
+				m_bQuit = true;
+		}
 
-		if (ImGui::CollapsingHeader("Materials")) {
-			for (std::size_t i{ 0 }; i < m_materials.size(); ++i) {
-				ImGui::PushID(static_cast<int>(i));
-				ImGui::Text("Material %d", i - 1);
-				ImGui::SliderFloat3("Material Diffuse", &m_materials[i].m_v3Diffuse.r, 0.0f, 1.0f);
-				ImGui::SliderFloat3("Material Specular", &m_materials[i].m_v3Specular.r, 0.0f, 1.0f);
-				ImGui::SliderFloat("Roughness", &m_materials[i].m_fRoughness, 0.0f, 1.0f);
-				ImGui::NewLine();
-				ImGui::PopID();
+		if (m_lightBenchmark.is_running() && m_lightBenchmark.record_frame(m_deltaTime, m_lightClusters.get_max_cluster_lights())) {
+			if (m_lightBenchmark.is_running()) {
+				apply_light_benchmark_step();
+			}
+			else {
+				m_lightBenchmark.write_csv(m_config.m_lightBenchmarkPath);
+				m_bQuit = true;
 			}
 		}
-		ImGui::Render();
 
-		draw(currentTime);
+		// a running benchmark decides when a headless run ends
+		bool benchmarkRunning{ m_lightBenchmark.is_running() || m_pathBenchmark.is_running() };
+		if (m_config.m_bHeadless && !benchmarkRunning && m_framesRendered >= m_config.m_uiHeadlessFrames)
+			m_bQuit = true;
 	}
 	// wait for all driver access to conclude before cleanup
 	VK_CHECK(vkDeviceWaitIdle(m_device.device));
-}
 
-void Kleicha::draw(float currentTime) {
+	// only a completed replay is written, the last frames' gpu times are collected now that the device is idle
+	if (!m_config.m_cameraPath.empty() && !m_pathBenchmark.is_running()) {
+		for (uint32_t i{ 1 }; i <= std::min(m_framesRendered, m_framesInFlight); ++i)
+			read_frame_timestamps(m_framesRendered - i);
+		m_pathBenchmark.write_results(m_config.m_benchmarkPath);
+	}
 
-	// get references to current frame
-	const vkt::Frame frame{ get_current_frame() };
-	VK_CHECK(vkWaitForFences(m_device.device, 1, &frame.inFlightFence, VK_TRUE, std::numeric_limits<uint64_t>::max()));
-	uint32_t imageIndex{};
-	// acquire image from swapchain
-	VkResult acquireResult{ vkAcquireNextImageKHR(m_device.device, m_swapchain.swapchain, std::numeric_limits<uint64_t>::max(), frame.acquiredSemaphore, VK_NULL_HANDLE, &imageIndex) };
+	if (!m_config.m_recordCameraPath.empty())
+		m_recordedPath.save(m_config.m_recordCameraPath);
 
-	if (acquireResult == VK_ERROR_OUT_OF_DATE_KHR)
-		recreate_swapchain();
+	if (m_config.m_bCpuTrace)
+		CpuProfiler::write_trace(m_config.m_cpuTracePath);
 
-	// we should only set fence to unsignaled when we know the command buffer will be submitted to the queue.
-	VK_CHECK(vkResetFences(m_device.device, 1, &frame.inFlightFence));
+	if (m_config.m_bMemoryStats)
+		m_memoryTracker.write_stats(m_config.m_memoryStatsPath);
 
-	VkCommandBufferBeginInfo cmdBufferBeginInfo{
-		.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO,
-		.flags = VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT,
-	};
+	if (m_config.m_bHeadless) {
+		std::chrono::duration<double, std::milli> elapsed{ std::chrono::steady_clock::now() - startTime };
+		fmt::println("[Kleicha] Rendered {} headless frames in {:.2f} ms, {:.3f} ms per frame.", m_framesRendered, elapsed.count(),
+			elapsed.count() / std::max(m_framesRendered, 1u));
+	}
+}
 
-	// implicitly resets command buffer and places it in recording state
-	VK_CHECK(vkBeginCommandBuffer(frame.cmdBuffer, &cmdBufferBeginInfo));
+void Kleicha::build_imgui() {
+	PROFILE_ZONE("build_imgui");
+#ifndef KLEICHA_HEADLESS_ONLY
+
+	ImGui_ImplVulkan_NewFrame();
+	ImGui_ImplGlfw_NewFrame();
+	ImGui::NewFrame();
+
+	ImGui::Text("Frame: %.2f ms cpu, %.2f ms gpu, %u draws", m_fCpuFrameTime * 1000.0f, m_fGpuFrameTime * 1000.0f, m_totalDraws);
+	ImGui::Checkbox("Blinn-Phong", &m_bUseBlinnPhong);
+	ImGui::Checkbox("Emissive Materials", reinterpret_cast<bool*>(&m_globalData.m_uiUseEmissive));
+	// nothing kept the atlas up to date while shadows were off, every light is re-rendered rather than trusting its tiles
+	if (ImGui::Checkbox("Shadows", &m_bUseShadows) && m_bUseShadows)
+		m_shadowCache.invalidate_all();
+	if (m_bUseShadows)
+		ImGui::Text("Shadow maps: %zu / %zu stale", m_shadowCache.stale_count(), m_pointLights.size());
+	// clusters are binned from the camera at recording, a latched camera may see froxels they weren't built for
+	ImGui::BeginDisabled(m_bLateLatch);
+	ImGui::Checkbox("Clustered Lighting", &m_bUseClusters);
+	ImGui::EndDisabled();
+	// the light benchmark compares clustered against unclustered shading
+	ImGui::BeginDisabled(m_lightBenchmark.is_running());
+	ImGui::Checkbox("Late Latching", &m_bLateLatch);
+	ImGui::EndDisabled();
+	ImGui::Checkbox("Depth Pre-pass", &m_bUseDepthPrepass);
+	ImGui::Checkbox("Dynamic Resolution", &m_bDynamicResolution);
+	if (m_bDynamicResolution) {
+		float targetFrameTime{ m_dynamicResolution.get_target_frame_time() * 1000.0f };
+		if (ImGui::SliderFloat("Target GPU Time (ms)", &targetFrameTime, 4.0f, 50.0f))
+			m_dynamicResolution.set_target_frame_time(targetFrameTime / 1000.0f);
+	}
+	ImGui::Text("Render resolution: %ux%u (%.0f%%)", m_renderExtent.width, m_renderExtent.height,
+		100.0f * static_cast<float>(m_renderExtent.width) / static_cast<float>(m_swapchain.imageExtent.width));
+	if (m_fInputToGpuComplete > 0.0f)
+		ImGui::Text("Input to GPU complete: %.2f ms", m_fInputToGpuComplete * 1000.0f);
+	if (use_clusters())
+		ImGui::Text("Cluster lights: %zu references, %u max per cluster, %u dropped", m_lightClusters.get_light_indices().size(),
+			m_lightClusters.get_max_cluster_lights(), m_lightClusters.get_overflow());
+	if (m_lightBenchmark.is_running())
+		ImGui::Text("Light benchmark: %u lights, %s", m_lightBenchmark.get_step().m_uiLightCount, m_lightBenchmark.get_step().m_bClustered ? "clustered" : "unclustered");
+
+	if (m_gpuProfiler.is_enabled() && ImGui::CollapsingHeader("GPU Timings")) {
+		for (const auto& scope : m_gpuProfiler.get_scopes()) {
+			ImGui::Text("%-12s %.3f ms", scope.m_name.c_str(), scope.m_fSmoothedTime * 1000.0f);
+			if (scope.m_bHasStatistics)
+				ImGui::Text("    %llu prims in, %llu vs, %llu prims out, %llu fs", scope.m_statistics[GpuProfiler::INPUT_ASSEMBLY_PRIMITIVES],
+					scope.m_statistics[GpuProfiler::VERTEX_SHADER_INVOCATIONS], scope.m_statistics[GpuProfiler::CLIPPING_PRIMITIVES],
+					scope.m_statistics[GpuProfiler::FRAGMENT_SHADER_INVOCATIONS]);
+		}
+	}
+	if (ImGui::CollapsingHeader("Memory")) {
+		constexpr float MIB{ 1024.0f * 1024.0f };
+		for (uint32_t i{ 0 }; i < MemoryTracker::CATEGORY_COUNT; ++i) {
+			const MemoryTracker::CategoryUsage& usage{ m_memoryTracker.get_category_usage(static_cast<MemoryTracker::Category>(i)) };
+			ImGui::Text("%-14s %8.2f MiB in %u allocations, peak %.2f MiB", MemoryTracker::CATEGORY_NAMES[i], static_cast<float>(usage.m_bytes) / MIB,
+				usage.m_uiAllocations, static_cast<float>(usage.m_peakBytes) / MIB);
+		}
+		ImGui::NewLine();
 
-	std::vector<VkImageMemoryBarrier2> imageMemoryBarriers{};
-	// forms a dependency chain with vkAcquireNextImageKHR signal semaphore. when semaphores are signaled, all pending writes are made available. i dont need to do this manually here
-	VkImageMemoryBarrier2 rastertoTransferDst{ init::create_image_barrier_info(VK_PIPELINE_STAGE_2_TRANSFER_BIT, VK_PIPELINE_STAGE_2_NONE,
-		VK_PIPELINE_STAGE_2_COLOR_ATTACHMENT_OUTPUT_BIT, VK_ACCESS_2_COLOR_ATTACHMENT_WRITE_BIT,
-		VK_IMAGE_LAYOUT_UNDEFINED, VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL, rasterImage.image, rasterImage.mipLevels) };
-	imageMemoryBarriers.emplace_back(rastertoTransferDst);
+		std::vector<MemoryTracker::HeapUsage> heaps{ m_memoryTracker.get_heap_usage() };
+		for (std::size_t i{ 0 }; i < heaps.size(); ++i) {
+			ImGui::Text("Heap %zu (%s): %.1f / %.1f MiB budget, %.1f MiB in our blocks", i, heaps[i].m_bDeviceLocal ? "device" : "host",
+				static_cast<float>(heaps[i].m_usage) / MIB, static_cast<float>(heaps[i].m_budget) / MIB, static_cast<float>(heaps[i].m_blockBytes) / MIB);
+			ImGui::ProgressBar(heaps[i].m_budget > 0 ? static_cast<float>(heaps[i].m_usage) / static_cast<float>(heaps[i].m_budget) : 0.0f);
+		}
+		if (!m_memoryTracker.uses_budget_extension())
+			ImGui::Text("Budgets are estimated, VK_EXT_memory_budget is unsupported.");
+		ImGui::Text("Resources pending deletion: %zu", m_deletionQueue.size());
+		ImGui::Text("Texture slots: %u / %u", m_textureTable.get_used(), m_textureTable.get_capacity());
+		if (m_bUseDescriptorBuffer)
+			ImGui::Text("Descriptors: %.2f KiB descriptor buffer", static_cast<float>(m_descriptorBuffer.get_size()) / 1024.0f);
+		else
+			ImGui::Text("Descriptors: update after bind descriptor set");
+
+		const RenderGraph::MemoryStats& transientStats{ m_renderGraph.get_memory_stats() };
+		ImGui::Text("Transient render targets: %.2f MiB, %.2f MiB without aliasing", static_cast<float>(transientStats.m_blockBytes) / MIB,
+			static_cast<float>(transientStats.m_imageBytes) / MIB);
+		if (m_renderGraph.supports_lazy_memory())
+			ImGui::Text("Lazily allocated: %.2f MiB committed of %.2f MiB", static_cast<float>(m_renderGraph.get_committed_lazy_bytes()) / MIB,
+				static_cast<float>(transientStats.m_lazyBytes) / MIB);
+	}
+	if (ImGui::CollapsingHeader("Lights")) {
+
+		ImGui::Text("Shadow atlas: %ux%u, %.0f%% used", m_shadowAtlas.get_extent(), m_shadowAtlas.get_extent(), m_shadowAtlas.get_occupancy() * 100.0f);
+		ImGui::Text("Lights: %zu, buffer capacity %u", m_pointLights.size(), get_current_frame().lightCapacity);
+		if (ImGui::Button("Add Light")) {
+			vkt::PointLight light{};
+			light.m_v3Position = m_camera.get_world_pos();
+			light.m_v3Color = glm::vec3{ 1.0f };
+			light.m_fFalloff = glm::vec3{ 1.0f, 0.0f, 0.1f };
+			add_point_light(light);
+		}
+		ImGui::NewLine();
+
+		// removed after the loop so that the indices stay valid while the widgets are built
+		std::size_t removedLight{ m_pointLights.size() };
+		for (std::size_t i{ 0 }; i < m_pointLights.size(); ++i) {
+			ImGui::PushID(static_cast<int>(i));
+			ImGui::Text("Light %d", i);
+			ImGui::SliderFloat3("Light World Pos", &m_pointLights[i].m_v3Position.x, -10.0f, 50.0f);
+			//ImGui::ColorPicker3("Light Ambient", &m_pointLights[i].ambient.r);)
+			ImGui::SliderFloat3("Light Color", &m_pointLights[i].m_v3Color.r, 0.0f, 1.0f);
+			ImGui::SliderFloat3("Light Falloff", &m_pointLights[i].m_fFalloff.r, 0.0f, 10.0f);
+			if (i < m_shadowCasters.size())
+				ImGui::Text("Shadow casters: %zu / %zu", m_shadowCasters[i].size(), m_draws.size());
+			ImGui::Text("Shadow tile: %u", m_pointLights[i].m_uv4ShadowTiles[0].z);
+			if (ImGui::Button("Remove Light"))
+				removedLight = i;
+			ImGui::NewLine();
+			ImGui::PopID();
+		}
+		if (removedLight < m_pointLights.size())
+			remove_point_light(removedLight);
+	}
 
-	VkImageMemoryBarrier2 scToTransferDst{ init::create_image_barrier_info(VK_PIPELINE_STAGE_2_TRANSFER_BIT, 0,
-		VK_PIPELINE_STAGE_2_TRANSFER_BIT, VK_ACCESS_2_TRANSFER_WRITE_BIT, VK_IMAGE_LAYOUT_UNDEFINED, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, m_swapchain.images[imageIndex], 1) };
-	imageMemoryBarriers.emplace_back(scToTransferDst);
 
-	// transition frame shadow cube map layouts to color attachment output
-	for (auto& cubeShadowMap : frame.cubeShadowMaps) {
-		VkImageMemoryBarrier2 cubeMapToColorAttachment{ init::create_image_barrier_info(VK_PIPELINE_STAGE_2_TRANSFER_BIT, VK_ACCESS_2_NONE, VK_PIPELINE_STAGE_2_COLOR_ATTACHMENT_OUTPUT_BIT,
-			VK_ACCESS_2_COLOR_ATTACHMENT_WRITE_BIT, VK_IMAGE_LAYOUT_UNDEFINED, VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL, cubeShadowMap.colorImage.image, 1) };
-		imageMemoryBarriers.emplace_back(cubeMapToColorAttachment);
+	if (ImGui::CollapsingHeader("Materials")) {
+		for (std::size_t i{ 0 }; i < m_materials.size(); ++i) {
+			ImGui::PushID(static_cast<int>(i));
+			ImGui::Text("Material %d", i - 1);
+			ImGui::SliderFloat3("Material Diffuse", &m_materials[i].m_v3Diffuse.r, 0.0f, 1.0f);
+			ImGui::SliderFloat3("Material Specular", &m_materials[i].m_v3Specular.r, 0.0f, 1.0f);
+			ImGui::SliderFloat("Roughness", &m_materials[i].m_fRoughness, 0.0f, 1.0f);
+			ImGui::NewLine();
+			ImGui::PopID();
+		}
 	}
+	ImGui::Render();
+#endif
+}
 
-	// transition swapchain image to VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL
-	VkDependencyInfo dependencyInfo{ .sType = VK_STRUCTURE_TYPE_DEPENDENCY_INFO };
-	dependencyInfo.pNext = nullptr;
-	dependencyInfo.imageMemoryBarrierCount = static_cast<uint32_t>(imageMemoryBarriers.size());
-	dependencyInfo.pImageMemoryBarriers = imageMemoryBarriers.data();
-
-	// image memory barrier
-	vkCmdPipelineBarrier2(frame.cmdBuffer, &dependencyInfo);
+void Kleicha::draw([[maybe_unused]] float currentTime) {
+	PROFILE_ZONE("draw");
 
-	VkDescriptorSet descSets[]{ m_globalDescSet, frame.descriptorSet };
-	vkCmdBindDescriptorSets(frame.cmdBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, m_dummyPipelineLayout, 0, std::size(descSets), descSets, 0, nullptr);
+	// a reference to the current frame, its light buffer may be replaced once its fence has signaled
+	const vkt::Frame& frame{ get_current_frame() };
+	uint32_t slot{ m_framesRendered % m_framesInFlight };
+	// the swapchain image is first used by the blit
+	constexpr VkPipelineStageFlags2 ACQUIRE_WAIT_STAGE{ VK_PIPELINE_STAGE_2_TRANSFER_BIT };
+	m_totalDraws = 0;
 
+	// the fence is waited on as late as possible, everything up to here overlaps with the gpu finishing the slot's last frame
+	update_frame_data();
 	m_perspProj = utils::orthographicProj(glm::radians(90.0f),
 		static_cast<float>(m_windowExtent.width) / m_windowExtent.height, 1000.0f, 0.1f) * m_persp;
 
-	// cube shadow pass perspective proj
-	glm::mat4 shadowCubePerspProj{ utils::orthographicProj(glm::radians(90.0f), static_cast<float>(SHADOW_CUBE_EXTENT.width) / SHADOW_CUBE_EXTENT.height, 1000.0f, 0.1f) * m_persp };
-	//m_pushConstants.perspectiveProjection = shadowCubePerspProj;
-	update_dynamic_buffers(frame, currentTime, shadowCubePerspProj);
+	{
+		PROFILE_ZONE("wait_fence");
+		VK_CHECK(vkWaitForFences(m_device.device, 1, &frame.inFlightFence, VK_TRUE, std::numeric_limits<uint64_t>::max()));
+	}
+	// vma refreshes its heap budgets when the frame index changes
+	vmaSetCurrentFrameIndex(m_allocator, m_framesRendered);
+	// the fence also guarantees that the timestamps written by the frame that last used this slot are available. its latency
+	// runs from the start of its cpu work to the fence being seen signaled, which is exact whenever the wait actually blocked.
+	if (m_framesRendered >= m_framesInFlight) {
+		uint32_t completedFrame{ m_framesRendered - m_framesInFlight };
+		m_pathBenchmark.record_latency(completedFrame, std::chrono::duration<float>{ std::chrono::steady_clock::now() - m_slotStartTimes[slot] }.count());
+		read_frame_timestamps(completedFrame);
+		// frames complete in submission order, so everything queued up to this one is no longer in use
+		m_deletionQueue.flush(completedFrame);
+		collect_retired_swapchains(completedFrame);
+		m_textureTable.collect(completedFrame);
+	}
+	ensure_light_capacity(m_frames[slot]);
+	m_slotStartTimes[slot] = m_frameStartTime;
+	m_inputSampleTime = m_frameStartTime;
+	bool present{ !m_config.m_bHeadless };
+	uint32_t imageIndex{};
+	// acquire image from swapchain
+	if (present) {
+		PROFILE_ZONE("acquire");
+		VkResult acquireResult{ vkAcquireNextImageKHR(m_device.device, m_swapchain.swapchain, std::numeric_limits<uint64_t>::max(), frame.acquiredSemaphore, VK_NULL_HANDLE, &imageIndex) };
+
+		// nothing was acquired and the semaphore stays unsignaled, so the image is acquired from the recreated swapchain instead
+		while (acquireResult == VK_ERROR_OUT_OF_DATE_KHR) {
+			recreate_swapchain();
+			acquireResult = vkAcquireNextImageKHR(m_device.device, m_swapchain.swapchain, std::numeric_limits<uint64_t>::max(), frame.acquiredSemaphore, VK_NULL_HANDLE, &imageIndex);
+		}
 
-	vkCmdBindIndexBuffer(frame.cmdBuffer, m_indexBuffer.buffer, 0, VK_INDEX_TYPE_UINT32);
+		// a suboptimal image can still be presented, the swapchain is recreated afterwards
+		if (acquireResult == VK_SUBOPTIMAL_KHR)
+			m_bSwapchainSuboptimal = true;
+		else
+			VK_CHECK(acquireResult);
+	}
 
-	VkClearValue colorClearValue{ {{0.0f, 0.0f, 0.0f, 1.0f}} };
-	VkClearValue depthClearValue{ .depthStencil = {0.0f, 0U} };
-	utils::set_viewport_scissor(frame, m_swapchain.imageExtent);
-	m_pushConstants.m_m4ViewProjection = m_perspProj * m_camera.getViewMatrix();;
-	/*		main pass		*/
-	// specify the attachments for second pass
-	VkRenderingAttachmentInfo colorAttachment{ init::create_rendering_attachment_info(rasterImage.imageView, VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL, &colorClearValue) };
-	VkRenderingAttachmentInfo depthAttachment{ init::create_rendering_attachment_info(depthImage.imageView, VK_IMAGE_LAYOUT_DEPTH_ATTACHMENT_OPTIMAL, &depthClearValue) };
+	// picked once the swapchain extent is final for this frame, the render targets stay at the full extent so changing the
+	// scale never reallocates them
+	m_renderExtent = m_bDynamicResolution ? m_dynamicResolution.get_render_extent(m_swapchain.imageExtent) : m_swapchain.imageExtent;
+	m_slotRenderScales[slot] = static_cast<float>(m_renderExtent.width) / static_cast<float>(m_swapchain.imageExtent.width);
+	m_globalData.m_v2ClusterTileSize = glm::vec2{ static_cast<float>(m_renderExtent.width) / LightClusters::GRID_X,
+		static_cast<float>(m_renderExtent.height) / LightClusters::GRID_Y };
 
-	VkRenderingInfo renderingInfo{ .sType = VK_STRUCTURE_TYPE_RENDERING_INFO };
-	renderingInfo.pNext = nullptr;
-	renderingInfo.renderArea.extent = m_swapchain.imageExtent;
-	renderingInfo.renderArea.offset = { 0,0 };
-	renderingInfo.layerCount = 1;
-	renderingInfo.viewMask = 0; //we're not using multiview
-	renderingInfo.colorAttachmentCount = 1;
-	renderingInfo.pColorAttachments = &colorAttachment;
-	renderingInfo.pDepthAttachment = &depthAttachment;
+	// we should only set fence to unsignaled when we know the command buffer will be submitted to the queue.
+	VK_CHECK(vkResetFences(m_device.device, 1, &frame.inFlightFence));
 
-	vkCmdBeginRendering(frame.cmdBuffer, &renderingInfo);
+	VkCommandBufferBeginInfo cmdBufferBeginInfo{
+		.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO,
+		.flags = VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT,
+	};
 
-	if (m_bUseBlinnPhong)
-		record_draws(frame, &m_blinnPhongPipeline, nullptr);
+	// implicitly resets command buffer and places it in recording state
+	VK_CHECK(vkBeginCommandBuffer(frame.cmdBuffer, &cmdBufferBeginInfo));
+
+	m_gpuProfiler.begin_frame(frame.cmdBuffer, m_framesRendered);
+
+	// only the images are bound, every draw reaches the frame's buffers through the scene address it pushes
+	if (m_bUseDescriptorBuffer)
+		m_descriptorBuffer.bind(frame.cmdBuffer, m_dummyPipelineLayout, 0);
 	else
-		record_draws(frame, &m_GGXPipeline, nullptr);
+		vkCmdBindDescriptorSets(frame.cmdBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, m_dummyPipelineLayout, 0, 1, &m_globalDescSet, 0, nullptr);
+	m_pushConstants.m_sceneAddress = frame.sceneBuffer.deviceAddress;
 
-	vkCmdEndRendering(frame.cmdBuffer);
+	upload_frame_data(frame);
 
-	// transition image to transfer src
-	utils::image_memory_barrier(frame.cmdBuffer, VK_PIPELINE_STAGE_2_COLOR_ATTACHMENT_OUTPUT_BIT, VK_ACCESS_2_COLOR_ATTACHMENT_WRITE_BIT, 
-		VK_PIPELINE_STAGE_2_TRANSFER_BIT, VK_ACCESS_2_TRANSFER_READ_BIT, 
-		VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL, VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL, rasterImage.image, rasterImage.mipLevels);
+	vkCmdBindIndexBuffer(frame.cmdBuffer, m_indexBuffer.buffer, 0, VK_INDEX_TYPE_UINT32);
+
+	// every pass declares the images it uses, the graph records the barriers between them
+	m_renderGraph.begin_frame(m_framesRendered);
+	// the atlas is shared by all frames in flight and rests in a sampled layout between them, so rendering into it waits for the fragment shader reads of previously submitted frames
+	RenderGraph::Resource shadowAtlas{ m_renderGraph.import_image("shadow_atlas", m_shadowAtlasImage.image, m_shadowAtlasImage.imageView, VK_IMAGE_ASPECT_DEPTH_BIT,
+		RenderGraph::ImageState{ .m_layout = VK_IMAGE_LAYOUT_DEPTH_READ_ONLY_OPTIMAL, .m_stages = VK_PIPELINE_STAGE_2_FRAGMENT_SHADER_BIT },
+		VK_IMAGE_LAYOUT_DEPTH_READ_ONLY_OPTIMAL, VK_PIPELINE_STAGE_2_FRAGMENT_SHADER_BIT, VK_ACCESS_2_SHADER_SAMPLED_READ_BIT) };
+	m_renderGraph.mark_output(shadowAtlas);
+
+	RenderGraph::Resource raster{ m_renderGraph.create_image("raster", RenderGraph::ImageDescription{ .m_format = INTERMEDIATE_IMAGE_FORMAT,
+		.m_extent = m_swapchain.imageExtent, .m_usage = VK_IMAGE_USAGE_TRANSFER_SRC_BIT | VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT, .m_aspect = VK_IMAGE_ASPECT_COLOR_BIT }) };
+	// depth is cleared on load and never stored, so it can live in lazily allocated memory. the depth pre-pass stores it for
+	// the main pass to load, which would commit the lazy memory anyway.
+	VkImageUsageFlags depthUsage{ VK_IMAGE_USAGE_DEPTH_STENCIL_ATTACHMENT_BIT };
+	if (!m_bUseDepthPrepass)
+		depthUsage |= VK_IMAGE_USAGE_TRANSIENT_ATTACHMENT_BIT;
+	RenderGraph::Resource depth{ m_renderGraph.create_image("depth", RenderGraph::ImageDescription{ .m_format = DEPTH_IMAGE_FORMAT,
+		.m_extent = m_swapchain.imageExtent, .m_usage = depthUsage, .m_aspect = VK_IMAGE_ASPECT_DEPTH_BIT }) };
+
+	/*		shadow pass		*/
+	// lights whose tiles are all still valid have nothing to render
+	std::vector<uint32_t> staleLights{};
+	if (m_bUseShadows)
+		staleLights = collect_stale_shadow_lights();
+	if (!staleLights.empty()) {
+		m_renderGraph.add_pass("shadow_atlas", [&](VkCommandBuffer) { shadow_atlas_pass(frame, staleLights); }, true)
+			.write(shadowAtlas, RenderGraph::Access::DEPTH_ATTACHMENT);
+	}
 
-	// blit from intermediate raster image to swapchain image
-	utils::blit_image(frame.cmdBuffer, rasterImage.image, VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL, m_swapchain.images[imageIndex], VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, m_swapchain.imageExtent, m_swapchain.imageExtent, 0, 0);
+	/*		depth pre-pass		*/
+	if (m_bUseDepthPrepass) {
+		m_renderGraph.add_pass("depth_prepass", [&](VkCommandBuffer) { depth_prepass(frame, m_renderGraph.get_image_view(depth)); }, true)
+			.write(depth, RenderGraph::Access::DEPTH_ATTACHMENT);
+	}
 
-	utils::image_memory_barrier(frame.cmdBuffer, VK_PIPELINE_STAGE_2_TRANSFER_BIT, VK_ACCESS_2_TRANSFER_WRITE_BIT,
-		VK_PIPELINE_STAGE_2_COLOR_ATTACHMENT_OUTPUT_BIT, VK_ACCESS_2_COLOR_ATTACHMENT_WRITE_BIT | VK_ACCESS_2_COLOR_ATTACHMENT_READ_BIT, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL, m_swapchain.images[imageIndex], 1);
+	/*		main pass		*/
+	RenderGraph::Pass& mainPass{ m_renderGraph.add_pass("main_pass", [&](VkCommandBuffer) {
+		main_pass(frame, m_renderGraph.get_image_view(raster), m_renderGraph.get_image_view(depth));
+		}, true) };
+	mainPass.write(raster, RenderGraph::Access::COLOR_ATTACHMENT).write(depth, RenderGraph::Access::DEPTH_ATTACHMENT);
+	if (m_bUseShadows)
+		mainPass.read(shadowAtlas, RenderGraph::Access::SAMPLED);
+
+	if (present) {
+		// the first barrier on the swapchain image chains with the acquire semaphore wait, the last one with the rendered semaphore signal
+		RenderGraph::Resource swapchainImage{ m_renderGraph.import_image("swapchain", m_swapchain.images[imageIndex], m_swapchain.imageViews[imageIndex],
+			VK_IMAGE_ASPECT_COLOR_BIT, RenderGraph::ImageState{ .m_stages = ACQUIRE_WAIT_STAGE }, VK_IMAGE_LAYOUT_PRESENT_SRC_KHR, VK_PIPELINE_STAGE_2_COLOR_ATTACHMENT_OUTPUT_BIT) };
+		m_renderGraph.mark_output(swapchainImage);
+
+		// blit from intermediate raster image to swapchain image, bilinearly upscaling the rendered region
+		m_renderGraph.add_pass("blit", [&](VkCommandBuffer cmdBuffer) {
+			utils::blit_image(cmdBuffer, m_renderGraph.get_image(raster), VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL, m_renderGraph.get_image(swapchainImage),
+				VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, m_renderExtent, m_swapchain.imageExtent, 0, 0);
+			}).read(raster, RenderGraph::Access::TRANSFER_SRC).write(swapchainImage, RenderGraph::Access::TRANSFER_DST);
+
+		m_renderGraph.add_pass("imgui", [&](VkCommandBuffer cmdBuffer) {
+			PROFILE_ZONE("record_imgui");
+			draw_imgui(cmdBuffer, m_renderGraph.get_image_view(swapchainImage));
+			}).write(swapchainImage, RenderGraph::Access::COLOR_ATTACHMENT);
+	}
+	else {
+		// headless frames end in the raster image
+		m_renderGraph.mark_output(raster);
+	}
 
-	draw_imgui(frame.cmdBuffer, m_swapchain.imageViews[imageIndex]);
+	m_renderGraph.execute(frame.cmdBuffer, m_gpuProfiler);
 
-	utils::image_memory_barrier(frame.cmdBuffer, VK_PIPELINE_STAGE_2_COLOR_ATTACHMENT_OUTPUT_BIT, VK_ACCESS_2_COLOR_ATTACHMENT_WRITE_BIT,
-		VK_PIPELINE_STAGE_2_COLOR_ATTACHMENT_OUTPUT_BIT, VK_ACCESS_2_NONE, VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL, VK_IMAGE_LAYOUT_PRESENT_SRC_KHR, m_swapchain.images[imageIndex], 1);
+	m_gpuProfiler.end_frame(frame.cmdBuffer);
 
 	VK_CHECK(vkEndCommandBuffer(frame.cmdBuffer));
 	
 	VkSemaphoreSubmitInfo acquiredSemSubmitInfo{ .sType = VK_STRUCTURE_TYPE_SEMAPHORE_SUBMIT_INFO };
 	acquiredSemSubmitInfo.pNext = nullptr;
 	acquiredSemSubmitInfo.semaphore = frame.acquiredSemaphore;
-	// forms a dependency chain with the image memory barrier at the beginning of the batch to ensure the image transition happens before vkCmdClearColorImage
-	acquiredSemSubmitInfo.stageMask = VK_PIPELINE_STAGE_2_TRANSFER_BIT;
+	// forms a dependency chain with the swapchain image's first barrier so that its transition happens after the image is acquired
+	acquiredSemSubmitInfo.stageMask = ACQUIRE_WAIT_STAGE;
 	acquiredSemSubmitInfo.deviceIndex = 0;
 	
 	VkSemaphoreSubmitInfo renderedSemSubmitInfo{ .sType = VK_STRUCTURE_TYPE_SEMAPHORE_SUBMIT_INFO };
 	renderedSemSubmitInfo.pNext = nullptr;
-	renderedSemSubmitInfo.semaphore = m_renderedSemaphores[imageIndex];
+	renderedSemSubmitInfo.semaphore = present ? m_renderedSemaphores[imageIndex] : VK_NULL_HANDLE;
 	renderedSemSubmitInfo.stageMask = VK_PIPELINE_STAGE_2_COLOR_ATTACHMENT_OUTPUT_BIT;
 	renderedSemSubmitInfo.deviceIndex = 0;
 
@@ -1219,31 +1848,176 @@ void Kleicha::draw(float currentTime) {
 
 	VkSubmitInfo2 submitInfo{ .sType = VK_STRUCTURE_TYPE_SUBMIT_INFO_2 };
 	submitInfo.pNext = nullptr;
-	submitInfo.waitSemaphoreInfoCount = 1;
+	submitInfo.waitSemaphoreInfoCount = present ? 1 : 0;
 	submitInfo.pWaitSemaphoreInfos = &acquiredSemSubmitInfo;
 	submitInfo.commandBufferInfoCount = 1;
 	submitInfo.pCommandBufferInfos = &cmdBufferSubmitInfo;
-	submitInfo.signalSemaphoreInfoCount = 1;
+	submitInfo.signalSemaphoreInfoCount = present ? 1 : 0;
 	submitInfo.pSignalSemaphoreInfos = &renderedSemSubmitInfo;
-	VK_CHECK(vkQueueSubmit2(m_device.queue, 1, &submitInfo, frame.inFlightFence));
 
-	VkPresentInfoKHR presentInfo{ .sType = VK_STRUCTURE_TYPE_PRESENT_INFO_KHR };
-	presentInfo.pNext = nullptr;
-	presentInfo.waitSemaphoreCount = 1;
-	presentInfo.pWaitSemaphores = &m_renderedSemaphores[imageIndex];
-	presentInfo.swapchainCount = 1;
-	presentInfo.pSwapchains = &m_swapchain.swapchain;
-	presentInfo.pImageIndices = &imageIndex;
-	VkResult presentResult{ vkQueuePresentKHR(m_device.queue, &presentInfo) };
+	// the commands only reference the camera buffer, so input can be sampled after they've been recorded
+	if (m_bLateLatch) {
+		latch_camera();
+		write_camera_data(frame);
+	}
+	m_slotInputTimes[slot] = m_inputSampleTime;
+	// update after bind descriptors are read at submission, so textures streamed in while recording are usable from this frame on
+	m_textureTable.flush();
+	{
+		PROFILE_ZONE("submit");
+		VK_CHECK(vkQueueSubmit2(m_device.queue, 1, &submitInfo, frame.inFlightFence));
+	}
 
-	if (presentResult == VK_ERROR_OUT_OF_DATE_KHR)
-		recreate_swapchain();
+	if (present) {
+		PROFILE_ZONE("present");
+		VkPresentInfoKHR presentInfo{ .sType = VK_STRUCTURE_TYPE_PRESENT_INFO_KHR };
+		presentInfo.pNext = nullptr;
+		presentInfo.waitSemaphoreCount = 1;
+		presentInfo.pWaitSemaphores = &m_renderedSemaphores[imageIndex];
+		presentInfo.swapchainCount = 1;
+		presentInfo.pSwapchains = &m_swapchain.swapchain;
+		presentInfo.pImageIndices = &imageIndex;
+		// the image was acquired again, so its last present has long been consumed and the wait is only a formality
+		VkSwapchainPresentFenceInfoEXT presentFenceInfo{ .sType = VK_STRUCTURE_TYPE_SWAPCHAIN_PRESENT_FENCE_INFO_EXT };
+		if (m_bUsePresentFences) {
+			VK_CHECK(vkWaitForFences(m_device.device, 1, &m_presentFences[imageIndex], VK_TRUE, std::numeric_limits<uint64_t>::max()));
+			VK_CHECK(vkResetFences(m_device.device, 1, &m_presentFences[imageIndex]));
+			presentFenceInfo.swapchainCount = 1;
+			presentFenceInfo.pFences = &m_presentFences[imageIndex];
+			presentInfo.pNext = &presentFenceInfo;
+		}
+		VkResult presentResult{ vkQueuePresentKHR(m_device.queue, &presentInfo) };
+
+		if (presentResult == VK_ERROR_OUT_OF_DATE_KHR || presentResult == VK_SUBOPTIMAL_KHR || m_bSwapchainSuboptimal)
+			recreate_swapchain();
+		else
+			VK_CHECK(presentResult);
+	}
 
 	++m_framesRendered;
-	process_inputs();
+	if (present && !m_bLateLatch)
+		process_inputs();
+}
+
+void Kleicha::latch_camera() {
+	PROFILE_ZONE("latch_camera");
+
+	if (m_pathBenchmark.is_running()) {
+		CameraPath::Keyframe keyframe{ m_cameraPath.sample(m_pathBenchmark.get_time()) };
+		m_camera.set_pose(keyframe.m_v3Position, keyframe.m_fYaw, keyframe.m_fPitch);
+	}
+	else if (!m_config.m_bHeadless) {
+#ifndef KLEICHA_HEADLESS_ONLY
+		glfwPollEvents();
+#endif
+		process_inputs();
+	}
+	m_inputSampleTime = std::chrono::steady_clock::now();
+}
+
+void Kleicha::write_camera_data(const vkt::Frame& frame) const {
+	vkt::CameraData cameraData{ .m_m4ViewProjection = m_perspProj * m_camera.getViewMatrix(), .m_v3Position = m_camera.get_world_pos(),
+		.m_v3Forward = m_camera.get_gaze_dir() };
+	memcpy(frame.cameraBuffer.allocation->GetMappedData(), &cameraData, sizeof(cameraData));
+	// written after the commands were recorded, a flush makes sure the gpu sees it on non coherent memory
+	VK_CHECK(vmaFlushAllocation(m_allocator, frame.cameraBuffer.allocation, 0, VK_WHOLE_SIZE));
+}
+
+// the addresses don't change after init, a buffer swapped in later only needs its address rewritten here
+void Kleicha::write_scene_addresses(const vkt::Frame& frame) const {
+	vkt::SceneAddresses addresses{ .m_vertices = m_vertexBuffer.deviceAddress, .m_draws = m_drawBuffer.deviceAddress, .m_globals = frame.globalsBuffer.deviceAddress,
+		.m_transforms = frame.transformBuffer.deviceAddress, .m_materials = frame.materialBuffer.deviceAddress, .m_lights = frame.lightBuffer.deviceAddress,
+		.m_clusters = frame.clusterBuffer.deviceAddress, .m_clusterLights = frame.clusterLightBuffer.deviceAddress, .m_camera = frame.cameraBuffer.deviceAddress };
+	memcpy(frame.sceneBuffer.allocation->GetMappedData(), &addresses, sizeof(addresses));
+	VK_CHECK(vmaFlushAllocation(m_allocator, frame.sceneBuffer.allocation, 0, VK_WHOLE_SIZE));
+}
+
+// lays down the depth of the opaque draws so that the main pass runs its fragment shader once per pixel
+void Kleicha::depth_prepass(const vkt::Frame& frame, VkImageView depthView) {
+	VkClearValue depthClearValue{ .depthStencil = {0.0f, 0U} };
+	utils::set_viewport_scissor(frame, m_renderExtent);
+
+	VkRenderingAttachmentInfo depthAttachment{ init::create_rendering_attachment_info(depthView, VK_IMAGE_LAYOUT_DEPTH_ATTACHMENT_OPTIMAL, &depthClearValue, VK_TRUE) };
+
+	VkRenderingInfo renderingInfo{ .sType = VK_STRUCTURE_TYPE_RENDERING_INFO };
+	renderingInfo.renderArea.extent = m_renderExtent;
+	renderingInfo.renderArea.offset = { 0,0 };
+	renderingInfo.layerCount = 1;
+	renderingInfo.colorAttachmentCount = 0;
+	renderingInfo.pColorAttachments = nullptr;
+	renderingInfo.pDepthAttachment = &depthAttachment;
+
+	vkCmdBeginRendering(frame.cmdBuffer, &renderingInfo);
+
+	vkCmdBindPipeline(frame.cmdBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, m_depthPrepassPipeline);
+	for (uint32_t drawId : m_opaqueDrawIds)
+		record_draw(frame, drawId);
+
+	vkCmdEndRendering(frame.cmdBuffer);
+}
+
+void Kleicha::main_pass(const vkt::Frame& frame, VkImageView rasterView, VkImageView depthView) {
+	VkClearValue colorClearValue{ {{0.0f, 0.0f, 0.0f, 1.0f}} };
+	VkClearValue depthClearValue{ .depthStencil = {0.0f, 0U} };
+	utils::set_viewport_scissor(frame, m_renderExtent);
+
+	// depth laid down by the pre-pass is loaded instead of cleared
+	VkRenderingAttachmentInfo colorAttachment{ init::create_rendering_attachment_info(rasterView, VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL, &colorClearValue) };
+	VkRenderingAttachmentInfo depthAttachment{ init::create_rendering_attachment_info(depthView, VK_IMAGE_LAYOUT_DEPTH_ATTACHMENT_OPTIMAL,
+		m_bUseDepthPrepass ? nullptr : &depthClearValue) };
+
+	// the targets outside the render area are left undefined, the blit only reads inside it
+	VkRenderingInfo renderingInfo{ .sType = VK_STRUCTURE_TYPE_RENDERING_INFO };
+	renderingInfo.pNext = nullptr;
+	renderingInfo.renderArea.extent = m_renderExtent;
+	renderingInfo.renderArea.offset = { 0,0 };
+	renderingInfo.layerCount = 1;
+	renderingInfo.viewMask = 0; //we're not using multiview
+	renderingInfo.colorAttachmentCount = 1;
+	renderingInfo.pColorAttachments = &colorAttachment;
+	renderingInfo.pDepthAttachment = &depthAttachment;
+
+	vkCmdBeginRendering(frame.cmdBuffer, &renderingInfo);
+
+	VkPipeline pipeline{ m_bUseBlinnPhong ? m_blinnPhongPipeline.get() : m_GGXPipeline.get() };
+	// frames up to this one may have been recorded with a fast-linked pipeline that has just been replaced
+	for (AsyncPipeline* asyncPipeline : { &m_blinnPhongPipeline, &m_GGXPipeline, &m_blinnPhongEqualPipeline, &m_GGXEqualPipeline }) {
+		if (VkPipeline replaced{ asyncPipeline->take_replaced() })
+			m_deletionQueue.push(m_framesRendered, replaced);
+	}
+
+	// transparent draws weren't part of the pre-pass, they still test and write depth as usual after the opaque draws
+	if (m_bUseDepthPrepass) {
+		VkPipeline equalPipeline{ m_bUseBlinnPhong ? m_blinnPhongEqualPipeline.get() : m_GGXEqualPipeline.get() };
+		record_draws(frame, &equalPipeline, &pipeline);
+	}
+	else
+		record_draws(frame, &pipeline, nullptr);
+
+	vkCmdEndRendering(frame.cmdBuffer);
 }
 
-void Kleicha::draw_imgui(VkCommandBuffer frameCmdBuffer, VkImageView swapchainImage) const {
+void Kleicha::read_frame_timestamps(uint32_t frameNumber) {
+	if (!m_gpuProfiler.read_frame(frameNumber))
+		return;
+
+	m_fGpuFrameTime = m_gpuProfiler.get_frame_time();
+	if (m_bDynamicResolution)
+		m_dynamicResolution.record_frame(m_fGpuFrameTime, m_slotRenderScales[frameNumber % m_framesInFlight]);
+	m_pathBenchmark.record_gpu_times(frameNumber, m_gpuProfiler.get_scopes());
+
+	// measured against the gpu's end of frame timestamp, observing the fence on the cpu would add however long it stayed unseen
+	std::optional<std::chrono::steady_clock::time_point> frameEndTime{ m_gpuProfiler.get_frame_end_time() };
+	if (frameEndTime) {
+		float inputToGpuComplete{ std::chrono::duration<float>{ *frameEndTime - m_slotInputTimes[frameNumber % m_framesInFlight] }.count() };
+		m_fInputToGpuComplete = m_fInputToGpuComplete == 0.0f ? inputToGpuComplete
+			: m_fInputToGpuComplete + (inputToGpuComplete - m_fInputToGpuComplete) * GpuProfiler::SMOOTHING;
+		m_pathBenchmark.record_input_to_gpu_complete(frameNumber, inputToGpuComplete);
+	}
+}
+
+void Kleicha::draw_imgui([[maybe_unused]] VkCommandBuffer frameCmdBuffer, [[maybe_unused]] VkImageView swapchainImage) const {
+#ifndef KLEICHA_HEADLESS_ONLY
 
 	VkRenderingAttachmentInfo colorAttachment{ init::create_rendering_attachment_info(swapchainImage, VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL, nullptr) };
 
@@ -1263,10 +2037,20 @@ void Kleicha::draw_imgui(VkCommandBuffer frameCmdBuffer, VkImageView swapchainIm
 	ImGui_ImplVulkan_RenderDrawData(ImGui::GetDrawData(), frameCmdBuffer);
 
 	vkCmdEndRendering(frameCmdBuffer);
+#endif
 }
 
-void Kleicha::process_inputs() {
+// false until the window was asked to close, headless runs only stop once m_bQuit is set
+bool Kleicha::is_window_closed() const {
+#ifndef KLEICHA_HEADLESS_ONLY
+	if (!m_config.m_bHeadless)
+		return glfwWindowShouldClose(m_window) == GLFW_TRUE;
+#endif
+	return false;
+}
 
+void Kleicha::process_inputs() {
+#ifndef KLEICHA_HEADLESS_ONLY
 	if (glfwGetKey(m_window, GLFW_KEY_W) == GLFW_PRESS)
 		m_camera.moveCameraPosition(FORWARD, m_deltaTime);
 	if (glfwGetKey(m_window, GLFW_KEY_S) == GLFW_PRESS)
@@ -1275,74 +2059,104 @@ void Kleicha::process_inputs() {
 		m_camera.moveCameraPosition(RIGHT, m_deltaTime);
 	if (glfwGetKey(m_window, GLFW_KEY_A) == GLFW_PRESS)
 		m_camera.moveCameraPosition(LEFT, m_deltaTime);
+#endif
 }
 
-void Kleicha::cleanup() const {
+void Kleicha::cleanup() {
 
-	vmaDestroyBuffer(m_allocator, m_drawBuffer.buffer, m_drawBuffer.allocation);
+	m_memoryTracker.destroy(m_drawBuffer);
 
 	vkDestroySampler(m_device.device, m_textureSampler, nullptr);
 	vkDestroySampler(m_device.device, m_shadowSampler, nullptr);
 	for (const auto& texture : m_textures) {
 		vkDestroyImageView(m_device.device, texture.imageView, nullptr);
-		vmaDestroyImage(m_allocator, texture.image, texture.allocation);
+		m_memoryTracker.destroy(texture);
 	}
 
-	vmaDestroyBuffer(m_allocator, m_vertexBuffer.buffer, m_vertexBuffer.allocation);
-	vmaDestroyBuffer(m_allocator, m_indexBuffer.buffer, m_indexBuffer.allocation);
-	vmaDestroyBuffer(m_allocator, m_globalsBuffer.buffer, m_globalsBuffer.allocation);
+	m_memoryTracker.destroy(m_vertexBuffer);
+	m_memoryTracker.destroy(m_indexBuffer);
 
 	vkDestroyFence(m_device.device, m_immFence, nullptr);
+	m_gpuProfiler.destroy();
 
-	for (const auto& frame : m_frames) {
+	vkDestroyImageView(m_device.device, m_shadowAtlasImage.imageView, nullptr);
+	m_memoryTracker.destroy(m_shadowAtlasImage);
 
-		for (const auto& cubeShadowMap : frame.cubeShadowMaps) {
-			vkDestroyImageView(m_device.device, cubeShadowMap.colorImage.imageView, nullptr);
-			vmaDestroyImage(m_allocator, cubeShadowMap.colorImage.image, cubeShadowMap.colorImage.allocation);
-
-			vkDestroyImageView(m_device.device, cubeShadowMap.depthImage.imageView, nullptr);
-			vmaDestroyImage(m_allocator, cubeShadowMap.depthImage.image, cubeShadowMap.depthImage.allocation);
-		}
+	for (const auto& frame : m_frames) {
 
-		vmaDestroyBuffer(m_allocator, frame.transformBuffer.buffer, frame.transformBuffer.allocation);
-		vmaDestroyBuffer(m_allocator, frame.materialBuffer.buffer, frame.materialBuffer.allocation);
-		vmaDestroyBuffer(m_allocator, frame.lightBuffer.buffer, frame.lightBuffer.allocation);
+		m_memoryTracker.destroy(frame.globalsBuffer);
+		m_memoryTracker.destroy(frame.transformBuffer);
+		m_memoryTracker.destroy(frame.materialBuffer);
+		m_memoryTracker.destroy(frame.lightBuffer);
+		m_memoryTracker.destroy(frame.clusterBuffer);
+		m_memoryTracker.destroy(frame.clusterLightBuffer);
+		m_memoryTracker.destroy(frame.cameraBuffer);
+		m_memoryTracker.destroy(frame.sceneBuffer);
 		vkDestroyFence(m_device.device, frame.inFlightFence, nullptr);
 		vkDestroySemaphore(m_device.device, frame.acquiredSemaphore, nullptr);
 	}
 
-	deallocate_frame_images();
+	m_descriptorBuffer.destroy();
+	m_renderGraph.destroy();
+	m_deletionQueue.flush_all();
 
+	m_memoryTracker.report_leaks();
 	vmaDestroyAllocator(m_allocator);
 
 	vkDestroyDescriptorPool(m_device.device, m_descPool, nullptr);
-	ImGui_ImplVulkan_Shutdown();
-	vkDestroyDescriptorPool(m_device.device, m_imguiDescPool, nullptr);
+#ifndef KLEICHA_HEADLESS_ONLY
+	if (!m_config.m_bHeadless) {
+		ImGui_ImplVulkan_Shutdown();
+		vkDestroyDescriptorPool(m_device.device, m_imguiDescPool, nullptr);
+	}
+#endif
 	vkDestroyDescriptorSetLayout(m_device.device, m_globDescSetLayout, nullptr);
-	vkDestroyDescriptorSetLayout(m_device.device, m_frameDescSetLayout, nullptr);
 
-	vkDestroyPipeline(m_device.device, m_blinnPhongPipeline, nullptr);
-	vkDestroyPipeline(m_device.device, m_GGXPipeline, nullptr);
-	vkDestroyPipeline(m_device.device, m_shadowPipeline, nullptr);
-	vkDestroyPipeline(m_device.device, m_cubeShadowPipeline, nullptr);
+	// lets a lazily compiled pipeline still in flight finish before it is destroyed
+	m_pipelineCompiler.shutdown();
 
-	vkDestroyPipelineLayout(m_device.device, m_dummyPipelineLayout, nullptr);
+	m_blinnPhongPipeline.destroy(m_device.device);
+	m_GGXPipeline.destroy(m_device.device);
+	m_blinnPhongEqualPipeline.destroy(m_device.device);
+	m_GGXEqualPipeline.destroy(m_device.device);
+	vkDestroyPipeline(m_device.device, m_depthPrepassPipeline, nullptr);
+	vkDestroyPipeline(m_device.device, m_shadowAtlasPipeline, nullptr);
+	m_pipelineCompiler.destroy_libraries();
 
-	for (const auto& renderedSemaphore : m_renderedSemaphores) {
-		vkDestroySemaphore(m_device.device, renderedSemaphore, nullptr);
-	}
+	m_shaderManager.destroy();
+
+	m_pipelineCache.save();
+	m_pipelineCache.destroy();
+
+	vkDestroyPipelineLayout(m_device.device, m_dummyPipelineLayout, nullptr);
 
 	vkDestroyCommandPool(m_device.device, m_commandPool, nullptr);
-	for (const auto& view: m_swapchain.imageViews)
-		vkDestroyImageView(m_device.device, view, nullptr);
 
-	vkDestroySwapchainKHR(m_device.device, m_swapchain.swapchain, nullptr);
+	// an idle device doesn't cover presents, the present fences do
+	if (!m_presentFences.empty())
+		VK_CHECK(vkWaitForFences(m_device.device, static_cast<uint32_t>(m_presentFences.size()), m_presentFences.data(), VK_TRUE, std::numeric_limits<uint64_t>::max()));
+	for (const auto& retired : m_retiredSwapchains) {
+		if (!retired.m_presentFences.empty())
+			VK_CHECK(vkWaitForFences(m_device.device, static_cast<uint32_t>(retired.m_presentFences.size()), retired.m_presentFences.data(), VK_TRUE,
+				std::numeric_limits<uint64_t>::max()));
+		destroy_retired_swapchain(retired);
+	}
+	m_retiredSwapchains.clear();
+
+	if (!m_config.m_bHeadless)
+		destroy_retired_swapchain(RetiredSwapchain{ .m_swapchain = m_swapchain.swapchain, .m_imageViews = m_swapchain.imageViews,
+			.m_renderedSemaphores = m_renderedSemaphores, .m_presentFences = m_presentFences });
 	vkDestroyDevice(m_device.device, nullptr);
-	vkDestroySurfaceKHR(m_instance.instance, m_surface, nullptr);
+	if (!m_config.m_bHeadless)
+		vkDestroySurfaceKHR(m_instance.instance, m_surface, nullptr);
 #ifdef _DEBUG
 	m_instance.pfnDestroyMessenger(m_instance.instance, m_instance.debugMessenger, nullptr);
 #endif
 	vkDestroyInstance(m_instance.instance, nullptr);
-	glfwDestroyWindow(m_window);
-	glfwTerminate();
+#ifndef KLEICHA_HEADLESS_ONLY
+	if (!m_config.m_bHeadless) {
+		glfwDestroyWindow(m_window);
+		glfwTerminate();
+	}
+#endif
 }
\ No newline at end of file
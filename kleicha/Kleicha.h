@@ -1,31 +1,78 @@
 #ifndef KLEICHA_H
 #define KLEICHA_H
+// KLEICHA_HEADLESS_ONLY builds without glfw and imgui, such a build always runs headless
+#ifndef KLEICHA_HEADLESS_ONLY
 #define GLFW_INCLUDE_VULKAN
 #include <GLFW/glfw3.h>
+#else
+struct GLFWwindow;
+#endif
 
+#include <chrono>
+#include <deque>
 #include <functional>
 
 #include "vulkan/vulkan.h"
 #include "Types.h"
 #include "vk_mem_alloc.h"
 #include "Camera.h"
+#include "ShadowCache.h"
+#include "ShadowAtlas.h"
+#include "LightClusters.h"
+#include "LightBenchmark.h"
+#include "DynamicResolution.h"
+#include "CameraPath.h"
+#include "PathBenchmark.h"
+#include "GpuProfiler.h"
+#include "CpuProfiler.h"
+#include "MemoryTracker.h"
+#include "DeletionQueue.h"
+#include "RenderGraph.h"
+#include "TextureTable.h"
+#include "DescriptorBuffer.h"
+#include "PipelineCache.h"
+#include "PipelineCompiler.h"
+#include "ShaderManager.h"
 
-constexpr uint32_t MAX_FRAMES_IN_FLIGHT{ 2 };
+// upper bound of the frames in flight that can be configured at startup
+constexpr uint32_t MAX_FRAMES_IN_FLIGHT{ 4 };
 constexpr VkFormat INTERMEDIATE_IMAGE_FORMAT{ VK_FORMAT_R16G16B16A16_SFLOAT };
 constexpr VkFormat DEPTH_IMAGE_FORMAT{ VK_FORMAT_D32_SFLOAT };
 constexpr VkExtent2D INIT_WINDOW_EXTENT{ .width = 1920, .height = 1080 };
-constexpr VkExtent2D SHADOW_CUBE_EXTENT{ .width = 1024, .height = 1024 };
+// device memory the shadow atlas may occupy, determines the atlas extent
+constexpr VkDeviceSize SHADOW_ATLAS_BUDGET{ 64 * 1024 * 1024 };
+// upper bound on a light's shadow range, matches the far plane of the cube face projections
+constexpr float SHADOW_MAX_RANGE{ 1000.0f };
+// attenuated intensity below which a light no longer contributes, used to derive a light's effective radius
+constexpr float LIGHT_CUTOFF_INTENSITY{ 1.0f / 256.0f };
+// compiled pipelines are persisted here between runs
+constexpr const char* PIPELINE_CACHE_PATH{ "pipeline_cache.bin" };
+// glsl sources are compiled at startup, their spir-v is cached here under a hash of the source
+constexpr const char* SHADER_SOURCE_DIR{ "../shaders" };
+constexpr const char* SHADER_CACHE_DIR{ "shader_cache" };
+// view depth at which the exponential cluster slices start, the first slice covers everything closer
+constexpr float CLUSTER_SLICE_NEAR{ 1.0f };
+// light buffers hold at least this many lights and grow in powers of two
+constexpr uint32_t MIN_LIGHT_CAPACITY{ 64 };
+// seconds between the keyframes captured when recording a camera path
+constexpr float CAMERA_RECORD_INTERVAL{ 0.1f };
+// frame rate dynamic resolution aims for when it's turned on without one being configured
+constexpr uint32_t DEFAULT_DYNAMIC_RESOLUTION_FPS{ 60 };
 
 class Kleicha {
 public:
 	GLFWwindow* m_window{};
 	Camera m_camera{ glm::vec3{0.0f, 4.0f, -3.0f}, INIT_WINDOW_EXTENT };
+	// set by the key callback, the trace and statistics are written between frames
+	bool m_bWriteCpuTrace{ false };
+	bool m_bWriteMemoryStats{ false };
 
-	void init();
+	void init(const vkt::Config& config);
 	void start();
-	void cleanup() const;
+	void cleanup();
 
 private:
+	vkt::Config m_config{};
 	VkSurfaceKHR m_surface{};
 	VkExtent2D m_windowExtent{ INIT_WINDOW_EXTENT };
 	vkt::Instance m_instance{};
@@ -36,25 +83,50 @@ private:
 	VkFence m_immFence{};
 
 	VkPipelineLayout m_dummyPipelineLayout{};
-	VkPipeline m_blinnPhongPipeline{};
-	VkPipeline m_GGXPipeline{};
-	VkPipeline m_shadowPipeline{};
-	VkPipeline m_cubeShadowPipeline;
+	AsyncPipeline m_blinnPhongPipeline{};
+	AsyncPipeline m_GGXPipeline{};
+	// variants that test against the depth pre-pass with VK_COMPARE_OP_EQUAL and leave depth untouched
+	AsyncPipeline m_blinnPhongEqualPipeline{};
+	AsyncPipeline m_GGXEqualPipeline{};
+	VkPipeline m_depthPrepassPipeline{};
+	VkPipeline m_shadowAtlasPipeline{};
+	PipelineCache m_pipelineCache{};
+	PipelineCompiler m_pipelineCompiler{};
+	ShaderManager m_shaderManager{};
 
 	VmaAllocator m_allocator{};
 
-	//global descriptor resources
+	// the only descriptors left are the images, buffers are reached through the frame's SceneAddresses
 	VkDescriptorSetLayout m_globDescSetLayout;
 	VkDescriptorPool m_descPool{};
 	VkDescriptorPool m_imguiDescPool{};
 	VkDescriptorSet m_globalDescSet{};
-	// per frame descriptor resources
-	VkDescriptorSetLayout m_frameDescSetLayout{};
+	// fills the texture binding of the global set, slots match the indices into m_textures the materials refer to
+	TextureTable m_textureTable{};
+	// holds the global set instead of m_globalDescSet when the descriptor buffer backend is in use
+	DescriptorBuffer m_descriptorBuffer{};
+	bool m_bUseDescriptorBuffer{ false };
 	
-	vkt::Frame m_frames[MAX_FRAMES_IN_FLIGHT]{};
-	vkt::Image rasterImage{};
-	vkt::Image depthImage{};
+	// one per frame in flight, every per frame resource and query range is indexed by the frame's slot in here
+	std::vector<vkt::Frame> m_frames{};
+	uint32_t m_framesInFlight{};
+	// per swapchain image, the present fences are only created with swapchain maintenance
 	std::vector<VkSemaphore> m_renderedSemaphores{};
+	std::vector<VkFence> m_presentFences{};
+	bool m_bUsePresentFences{ false };
+	// a swapchain replaced while presents from it may still be pending. the submit fences don't cover a present, so its
+	// objects are kept until its present fences have signaled or, without them, until enough frames were presented since.
+	struct RetiredSwapchain {
+		VkSwapchainKHR m_swapchain{};
+		std::vector<VkImageView> m_imageViews{};
+		std::vector<VkSemaphore> m_renderedSemaphores{};
+		std::vector<VkFence> m_presentFences{};
+		// no frame up to this one may still use it
+		uint32_t m_uiReleaseFrame{};
+	};
+	std::deque<RetiredSwapchain> m_retiredSwapchains{};
+	// set when acquiring returned a suboptimal image, the swapchain is recreated once the frame is presented
+	bool m_bSwapchainSuboptimal{ false };
 
 	VkSampler m_textureSampler{};
 	VkSampler m_shadowSampler{};
@@ -65,16 +137,65 @@ private:
 	//vkt::Buffer m_drawParamsBuffer{};
 	// this buffer specifies indicies and offsets to the other buffers available in the shader
 	vkt::Buffer m_drawBuffer{};
-	vkt::Buffer m_globalsBuffer{};
 
 	// each of these sets of draw data will be drawn with a different pipeline, provides flexibility.
 	std::vector<vkt::HostDrawData> m_draws{};
 	std::vector<vkt::HostDrawData> m_TransparentDraws{};
+	// indices into m_draws split by whether their material is flagged transparent. there are no alpha tested or blended
+	// materials yet, transparent draws (the cathedral windows) are shaded as opaque. they're still kept out of the depth
+	// pre-pass and drawn after the opaque ones with a regular depth test, so their coverage can change without the pre-pass.
+	std::vector<uint32_t> m_opaqueDrawIds{};
+	std::vector<uint32_t> m_transparentDrawIds{};
 
 	//std::vector<VkDrawIndexedIndirectCommand> m_drawIndirectParams{};
 	std::vector<vkt::Transform> m_meshTransforms{};
 	std::vector<vkt::Material> m_materials{};
 	std::vector<vkt::PointLight> m_pointLights{};
+	// per light list of draws that lie within the light's effective radius
+	std::vector<std::vector<vkt::ShadowCaster>> m_shadowCasters{};
+	// world space bounds of every draw, rebuilt each frame by cull_shadow_casters into the same storage
+	std::vector<vkt::BoundingSphere> m_drawBounds{};
+
+	// the atlas is shared by all frames in flight, a light's tiles are only re-rendered when its cache entry is stale
+	vkt::Image m_shadowAtlasImage{};
+	ShadowAtlas m_shadowAtlas{};
+	ShadowCache m_shadowCache{};
+
+	LightClusters m_lightClusters{};
+	LightBenchmark m_lightBenchmark{};
+	// every light the benchmark can activate, m_pointLights holds the first n of them during a step
+	std::vector<vkt::PointLight> m_benchmarkLights{};
+
+	CameraPath m_cameraPath{};
+	PathBenchmark m_pathBenchmark{};
+	CameraPath m_recordedPath{};
+
+	// every vma allocation is registered here with its category
+	MemoryTracker m_memoryTracker{};
+	// resources replaced while frames are in flight, destroyed once the frames that may use them have completed
+	DeletionQueue m_deletionQueue{};
+	// rebuilt every frame, owns the raster and depth images
+	RenderGraph m_renderGraph{};
+
+	// per pass gpu timings, read back once the frame's fence has signaled
+	GpuProfiler m_gpuProfiler{};
+	float m_fCpuFrameTime{};
+	// when the cpu started on the current frame and on the frame last recorded into each slot, for latency measurements
+	std::chrono::steady_clock::time_point m_frameStartTime{};
+	std::vector<std::chrono::steady_clock::time_point> m_slotStartTimes{};
+	// when the camera of the current frame and of the frame last submitted from each slot was sampled
+	std::chrono::steady_clock::time_point m_inputSampleTime{};
+	std::vector<std::chrono::steady_clock::time_point> m_slotInputTimes{};
+	float m_fGpuFrameTime{};
+	// smoothed time from sampling a frame's camera until the gpu finished it, only measured with calibrated timestamps
+	float m_fInputToGpuComplete{};
+
+	// the scene is rendered into the top left m_renderExtent of the full size render targets and scaled up by the blit
+	DynamicResolution m_dynamicResolution{};
+	bool m_bDynamicResolution{ false };
+	VkExtent2D m_renderExtent{};
+	// the scale the frame last recorded into each slot was rendered at, its gpu time is attributed to it
+	std::vector<float> m_slotRenderScales{};
 
 	vkt::GlobalData m_globalData{};
 
@@ -93,16 +214,42 @@ private:
 	void init_imgui();
 	void init_load_scene();
 	void init_lights();
-	void init_image_buffers(bool windowResized = false);
+	void init_image_buffers();
 	void init_dynamic_buffers();
 	void init_samplers();
 	void init_write_descriptor_sets();
+	void init_present_sync();
+	void run_descriptor_benchmark();
 
-	void update_dynamic_buffers(const vkt::Frame& frame, float currentTime, const glm::mat4& shadowCubePerspProj);
-	// we can expand this to supply the opaque and alpha draws if we end up having different groups of draws
-	void record_draws(const vkt::Frame& frame, VkPipeline* opaquePipeline, VkPipeline* alphaPipeline);
-	void shadow_cube_pass(const vkt::Frame& frame);
-	void shadow_2D_pass(const vkt::Frame& frame);
+	// cpu side frame preparation, it doesn't touch per frame resources so it runs before the frame's fence is waited on
+	void update_frame_data();
+	void upload_frame_data(const vkt::Frame& frame);
+	// without a transparent pipeline every draw is recorded with the opaque pipeline in scene order
+	void record_draws(const vkt::Frame& frame, VkPipeline* opaquePipeline, VkPipeline* transparentPipeline);
+	void record_draw(const vkt::Frame& frame, uint32_t drawId);
+	void cull_shadow_casters();
+	void assign_shadow_tiles();
+	// lights whose cached tiles must be re-rendered this frame
+	std::vector<uint32_t> collect_stale_shadow_lights();
+	void shadow_atlas_pass(const vkt::Frame& frame, const std::vector<uint32_t>& staleLights);
+	void depth_prepass(const vkt::Frame& frame, VkImageView depthView);
+	void main_pass(const vkt::Frame& frame, VkImageView rasterView, VkImageView depthView);
+	void build_light_clusters();
+	// lights may be added and removed between frames, each frame's light buffer grows to fit once its slot is free again
+	void add_point_light(const vkt::PointLight& light);
+	void remove_point_light(std::size_t lightIndex);
+	void create_light_buffer(vkt::Frame& frame, uint32_t capacity);
+	void ensure_light_capacity(vkt::Frame& frame);
+	void apply_light_benchmark_step();
+	void read_frame_timestamps(uint32_t frameNumber);
+	// samples the camera again right before submission, the recorded commands only reference the camera buffer
+	void latch_camera();
+	// late latching moves the camera after the clusters were binned, the two are never used together
+	bool use_clusters() const {
+		return m_bUseClusters && !m_bLateLatch;
+	}
+	void write_camera_data(const vkt::Frame& frame) const;
+	void write_scene_addresses(const vkt::Frame& frame) const;
 
 	//std::vector<vkt::GPUMesh> load_mesh_data();
 
@@ -115,22 +262,33 @@ private:
 	vkt::Buffer upload_data(void* data, VkDeviceSize bufferSize, VkBufferUsageFlags bufferUsage, VkBool32 bdaUsage = VK_FALSE);
 
 	void draw(float currentTime);
+	void build_imgui();
 	void draw_imgui(VkCommandBuffer frameCmdBuffer, VkImageView swapchainImage) const;
 	void recreate_swapchain();
-	void deallocate_frame_images() const;
+	void collect_retired_swapchains(uint32_t completedFrame);
+	void destroy_retired_swapchain(const RetiredSwapchain& retired) const;
 	// must be r-value reference as we'll be supplying lambdas
 	void immediate_submit(std::function<void(VkCommandBuffer cmdBuffer)>&& func) const;
 	void process_inputs();
+	bool is_window_closed() const;
 
 	uint32_t m_framesRendered{};
 	const vkt::Frame& get_current_frame() const {
-		return m_frames[m_framesRendered % 2];
+		return m_frames[m_framesRendered % m_framesInFlight];
 	}
 	void set_window_extent(VkExtent2D extent) {
 		m_windowExtent = extent;
 	}
 
 	bool m_bUseBlinnPhong{ false };
+	bool m_bUseDepthPrepass{ false };
+	bool m_bUsePipelineLibraries{ false };
+	bool m_bUseShadows{ true };
+	bool m_bUseClusters{ true };
+	// the camera is only sampled right before submission, clustered lighting is off meanwhile
+	bool m_bLateLatch{ false };
+	bool m_bQuit{ false };
+	// draws recorded by the current frame, shadow passes included
 	uint32_t m_totalDraws{0};
 	float m_deltaTime{};
 	float m_lastFrame{};
@@ -0,0 +1,69 @@
+#include "LightBenchmark.h"
+
+#pragma warning(push, 0)
+#pragma warning(disable : 6285 26498)
+#include "format.h"
+#pragma warning(pop)
+
+#include <algorithm>
+#include <fstream>
+#include <limits>
+#include <stdexcept>
+
+void LightBenchmark::init(uint32_t maxLights) {
+	m_steps.clear();
+
+	for (uint32_t count{ 1 }; ; count *= 2) {
+		count = std::min(count, maxLights);
+		m_steps.push_back(Step{ .m_uiLightCount = count, .m_bClustered = false });
+		m_steps.push_back(Step{ .m_uiLightCount = count, .m_bClustered = true });
+
+		if (count == maxLights)
+			break;
+	}
+
+	m_results.assign(m_steps.size(), Result{ .m_fMinTime = std::numeric_limits<float>::max() });
+	m_currentStep = 0;
+	m_frame = 0;
+}
+
+bool LightBenchmark::record_frame(float frameTime, uint32_t maxClusterLights) {
+	if (!is_running())
+		return false;
+
+	// the first frames after a step change still carry work queued under the previous step
+	if (m_frame++ < WARMUP_FRAMES)
+		return false;
+
+	Result& result{ m_results[m_currentStep] };
+	result.m_dTotalTime += frameTime;
+	result.m_fMinTime = std::min(result.m_fMinTime, frameTime);
+	result.m_fMaxTime = std::max(result.m_fMaxTime, frameTime);
+	result.m_uiMaxClusterLights = std::max(result.m_uiMaxClusterLights, maxClusterLights);
+
+	if (m_frame < WARMUP_FRAMES + MEASURED_FRAMES)
+		return false;
+
+	const Step& step{ m_steps[m_currentStep] };
+	fmt::println("[Kleicha] Light benchmark: {} lights, {}: {:.3f} ms", step.m_uiLightCount, step.m_bClustered ? "clustered" : "unclustered",
+		result.m_dTotalTime / MEASURED_FRAMES * 1000.0);
+
+	++m_currentStep;
+	m_frame = 0;
+	return true;
+}
+
+void LightBenchmark::write_csv(const std::string& path) const {
+	std::ofstream ofstrm{ path };
+	if (!ofstrm.is_open())
+		throw std::runtime_error{ "[Kleicha] Failed to open light benchmark output file: " + path };
+
+	ofstrm << "lights,clustered,avg_ms,min_ms,max_ms,max_cluster_lights\n";
+	for (std::size_t i{ 0 }; i < m_steps.size(); ++i) {
+		const Result& result{ m_results[i] };
+		ofstrm << fmt::format("{},{},{:.4f},{:.4f},{:.4f},{}\n", m_steps[i].m_uiLightCount, m_steps[i].m_bClustered ? 1 : 0,
+			result.m_dTotalTime / MEASURED_FRAMES * 1000.0, result.m_fMinTime * 1000.0f, result.m_fMaxTime * 1000.0f, result.m_uiMaxClusterLights);
+	}
+
+	fmt::println("[Kleicha] Wrote light benchmark results to {}.", path);
+}
@@ -0,0 +1,51 @@
+#ifndef LIGHTBENCHMARK_H
+#define LIGHTBENCHMARK_H
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+// sweeps the number of active point lights, rendering every count with and without light clustering. each step is given
+// a few frames to settle before its frame times are recorded, the results are written as csv once the sweep is done.
+class LightBenchmark {
+public:
+	static constexpr uint32_t WARMUP_FRAMES{ 60 };
+	static constexpr uint32_t MEASURED_FRAMES{ 240 };
+
+	struct Step {
+		uint32_t m_uiLightCount{};
+		bool m_bClustered{};
+	};
+
+	// light counts double from one up to maxLights, maxLights itself is always included
+	void init(uint32_t maxLights);
+
+	bool is_running() const {
+		return m_currentStep < m_steps.size();
+	}
+
+	const Step& get_step() const {
+		return m_steps[m_currentStep];
+	}
+
+	// records the frame time in seconds along with the largest cluster light list of the frame. returns true when the frame
+	// completed the current step, the caller should then apply the next step if the benchmark is still running.
+	bool record_frame(float frameTime, uint32_t maxClusterLights);
+
+	void write_csv(const std::string& path) const;
+
+private:
+	struct Result {
+		double m_dTotalTime{};
+		float m_fMinTime{};
+		float m_fMaxTime{};
+		uint32_t m_uiMaxClusterLights{};
+	};
+
+	std::vector<Step> m_steps{};
+	std::vector<Result> m_results{};
+	std::size_t m_currentStep{};
+	uint32_t m_frame{};
+};
+
+#endif // !LIGHTBENCHMARK_H
@@ -0,0 +1,119 @@
+#include "LightClusters.h"
+
+#include <algorithm>
+#include <cmath>
+
+// converts a range of normalized device coordinates into the range of grid cells it overlaps, returns false if the range is off screen
+static bool ndc_to_cells(float ndcMin, float ndcMax, uint32_t cellCount, uint32_t& first, uint32_t& last) {
+	if (ndcMax < -1.0f || ndcMin > 1.0f)
+		return false;
+
+	float scale{ 0.5f * static_cast<float>(cellCount) };
+	first = static_cast<uint32_t>(std::clamp((ndcMin + 1.0f) * scale, 0.0f, static_cast<float>(cellCount - 1)));
+	last = static_cast<uint32_t>(std::clamp((ndcMax + 1.0f) * scale, 0.0f, static_cast<float>(cellCount - 1)));
+	return true;
+}
+
+// projects the interval [lo, hi] of a view space axis at depths within [nearDepth, farDepth], the widest projection is kept
+static void project_interval(float lo, float hi, float nearDepth, float farDepth, float scale, float& ndcMin, float& ndcMax) {
+	ndcMin = lo / ((lo < 0.0f ? nearDepth : farDepth) * scale);
+	ndcMax = hi / ((hi > 0.0f ? nearDepth : farDepth) * scale);
+}
+
+void LightClusters::init(float cameraNear, float sliceNear, float far) {
+	m_cameraNear = cameraNear;
+	m_sliceNear = sliceNear;
+	m_far = far;
+	m_sliceScale = static_cast<float>(GRID_Z) / std::log(far / sliceNear);
+
+	m_clusters.resize(CLUSTER_COUNT);
+	m_counts.resize(CLUSTER_COUNT);
+	m_lightIndices.reserve(MAX_LIGHT_INDICES);
+}
+
+void LightClusters::build(const std::vector<vkt::PointLight>& lights, const glm::mat4& view, float aspectRatio, float tanHalfFov) {
+
+	m_references.clear();
+	std::fill(m_counts.begin(), m_counts.end(), 0);
+
+	const float scaleX{ aspectRatio * tanHalfFov };
+	const float scaleY{ tanHalfFov };
+
+	for (uint32_t j{ 0 }; j < lights.size(); ++j) {
+		const vkt::PointLight& light{ lights[j] };
+		glm::vec3 center{ view * glm::vec4{ light.m_v3Position, 1.0f } };
+		float radius{ light.m_fRadius };
+
+		if (radius <= 0.0f || center.z + radius < m_cameraNear || center.z - radius > m_far)
+			continue;
+
+		float minDepth{ std::max(center.z - radius, m_cameraNear) };
+		float maxDepth{ std::min(center.z + radius, m_far) };
+
+		uint32_t lastSlice{ get_slice(maxDepth) };
+
+		for (uint32_t z{ get_slice(minDepth) }; z <= lastSlice; ++z) {
+			// the part of the sphere's depth range that falls within this slice
+			float sliceNear{ std::max(get_slice_start(z), minDepth) };
+			float sliceFar{ z + 1 < GRID_Z ? std::min(get_slice_start(z + 1), maxDepth) : maxDepth };
+
+			// the sphere's cross section is widest at its center, otherwise at the slice boundary closest to it
+			float offset{ center.z < sliceNear ? sliceNear - center.z : (center.z > sliceFar ? center.z - sliceFar : 0.0f) };
+			float halfWidth{ std::sqrt(std::max(radius * radius - offset * offset, 0.0f)) };
+
+			float ndcMinX{}, ndcMaxX{}, ndcMinY{}, ndcMaxY{};
+			project_interval(center.x - halfWidth, center.x + halfWidth, sliceNear, sliceFar, scaleX, ndcMinX, ndcMaxX);
+			// framebuffer y grows downwards while view space y points up
+			project_interval(-center.y - halfWidth, -center.y + halfWidth, sliceNear, sliceFar, scaleY, ndcMinY, ndcMaxY);
+
+			uint32_t firstX{}, lastX{}, firstY{}, lastY{};
+			if (!ndc_to_cells(ndcMinX, ndcMaxX, GRID_X, firstX, lastX) || !ndc_to_cells(ndcMinY, ndcMaxY, GRID_Y, firstY, lastY))
+				continue;
+
+			for (uint32_t y{ firstY }; y <= lastY; ++y) {
+				for (uint32_t x{ firstX }; x <= lastX; ++x) {
+					uint32_t cluster{ (z * GRID_Y + y) * GRID_X + x };
+					m_references.emplace_back(cluster, j);
+					++m_counts[cluster];
+				}
+			}
+		}
+	}
+
+	// lay the clusters' lists out back to back, clusters that no longer fit in the index list are truncated
+	uint32_t offset{ 0 };
+	m_maxClusterLights = 0;
+	m_overflow = 0;
+	for (uint32_t i{ 0 }; i < CLUSTER_COUNT; ++i) {
+		uint32_t count{ std::min(m_counts[i], MAX_LIGHT_INDICES - offset) };
+		m_clusters[i] = vkt::Cluster{ .m_uiOffset = offset, .m_uiCount = count };
+		m_maxClusterLights = std::max(m_maxClusterLights, m_counts[i]);
+		m_overflow += m_counts[i] - count;
+		offset += count;
+		// reused as each cluster's fill cursor below
+		m_counts[i] = 0;
+	}
+
+	// references were gathered light by light, so every cluster's list stays sorted by light index
+	m_lightIndices.resize(offset);
+	for (const auto& reference : m_references) {
+		vkt::Cluster& cluster{ m_clusters[reference.x] };
+		uint32_t& cursor{ m_counts[reference.x] };
+		if (cursor < cluster.m_uiCount)
+			m_lightIndices[cluster.m_uiOffset + cursor++] = reference.y;
+	}
+}
+
+uint32_t LightClusters::get_slice(float depth) const {
+	if (depth <= m_sliceNear)
+		return 0;
+
+	return std::min(static_cast<uint32_t>(std::log(depth / m_sliceNear) * m_sliceScale), GRID_Z - 1);
+}
+
+float LightClusters::get_slice_start(uint32_t slice) const {
+	if (slice == 0)
+		return m_cameraNear;
+
+	return m_sliceNear * std::pow(m_far / m_sliceNear, static_cast<float>(slice) / static_cast<float>(GRID_Z));
+}
@@ -0,0 +1,73 @@
+#ifndef LIGHTCLUSTERS_H
+#define LIGHTCLUSTERS_H
+
+#include "Types.h"
+
+#include <vector>
+
+// bins point lights into a froxel grid of screen tiles and exponentially distributed view depth slices. each cluster
+// references a range of a shared light index list, fragments only shade the lights listed in their cluster.
+class LightClusters {
+public:
+	// must match the CLUSTER_GRID defines in common.h
+	static constexpr uint32_t GRID_X{ 16 };
+	static constexpr uint32_t GRID_Y{ 9 };
+	static constexpr uint32_t GRID_Z{ 24 };
+	static constexpr uint32_t CLUSTER_COUNT{ GRID_X * GRID_Y * GRID_Z };
+	// capacity of the light index list shared by all clusters
+	static constexpr uint32_t MAX_LIGHT_INDICES{ CLUSTER_COUNT * 32 };
+
+	// slices are distributed exponentially between sliceNear and far, the first slice also covers everything in front of sliceNear
+	// down to the camera's near plane. lights beyond these bounds aren't binned.
+	void init(float cameraNear, float sliceNear, float far);
+
+	// view space looks down +z. tanHalfFov is the tangent of half the vertical field of view. a light's extent is its m_fRadius.
+	void build(const std::vector<vkt::PointLight>& lights, const glm::mat4& view, float aspectRatio, float tanHalfFov);
+
+	const std::vector<vkt::Cluster>& get_clusters() const {
+		return m_clusters;
+	}
+
+	const std::vector<uint32_t>& get_light_indices() const {
+		return m_lightIndices;
+	}
+
+	float get_slice_near() const {
+		return m_sliceNear;
+	}
+
+	// multiplied by log(depth / sliceNear) to give a depth's slice
+	float get_slice_scale() const {
+		return m_sliceScale;
+	}
+
+	uint32_t get_max_cluster_lights() const {
+		return m_maxClusterLights;
+	}
+
+	// light references that were dropped because the index list was full during the last build
+	uint32_t get_overflow() const {
+		return m_overflow;
+	}
+
+private:
+	float m_cameraNear{};
+	float m_sliceNear{};
+	float m_far{};
+	float m_sliceScale{};
+
+	uint32_t m_maxClusterLights{};
+	uint32_t m_overflow{};
+
+	std::vector<vkt::Cluster> m_clusters{};
+	std::vector<uint32_t> m_lightIndices{};
+	// (cluster, light) pairs gathered while binning, kept around to avoid reallocating every frame
+	std::vector<glm::uvec2> m_references{};
+	std::vector<uint32_t> m_counts{};
+
+	uint32_t get_slice(float depth) const;
+	// view depth at which a slice starts
+	float get_slice_start(uint32_t slice) const;
+};
+
+#endif // !LIGHTCLUSTERS_H
@@ -0,0 +1,120 @@
+#include "MemoryTracker.h"
+#include "Utils.h"
+
+#include <algorithm>
+#include <fstream>
+#include <stdexcept>
+
+void MemoryTracker::init(VmaAllocator allocator, bool useBudgetExtension) {
+	m_allocator = allocator;
+	m_bUseBudgetExtension = useBudgetExtension;
+	fmt::println("[Kleicha] Memory budgets {}.", m_bUseBudgetExtension ? "are queried from VK_EXT_memory_budget" : "are estimated, VK_EXT_memory_budget is unsupported");
+}
+
+void MemoryTracker::track(const vkt::Buffer& buffer, Category category, const char* name) {
+	track(buffer.allocation, category, name);
+}
+
+void MemoryTracker::track(const vkt::Image& image, Category category, const char* name) {
+	track(image.allocation, category, name);
+}
+
+void MemoryTracker::destroy(const vkt::Buffer& buffer) {
+	untrack(buffer.allocation);
+	vmaDestroyBuffer(m_allocator, buffer.buffer, buffer.allocation);
+}
+
+void MemoryTracker::destroy(const vkt::Image& image) {
+	untrack(image.allocation);
+	vmaDestroyImage(m_allocator, image.image, image.allocation);
+}
+
+void MemoryTracker::free(VmaAllocation allocation) {
+	untrack(allocation);
+	vmaFreeMemory(m_allocator, allocation);
+}
+
+std::vector<MemoryTracker::HeapUsage> MemoryTracker::get_heap_usage() const {
+	const VkPhysicalDeviceMemoryProperties* pMemoryProperties{};
+	vmaGetMemoryProperties(m_allocator, &pMemoryProperties);
+
+	VmaBudget budgets[VK_MAX_MEMORY_HEAPS]{};
+	vmaGetHeapBudgets(m_allocator, budgets);
+
+	std::vector<HeapUsage> heaps(pMemoryProperties->memoryHeapCount);
+	for (uint32_t i{ 0 }; i < pMemoryProperties->memoryHeapCount; ++i) {
+		heaps[i] = HeapUsage{
+			.m_allocationBytes = budgets[i].statistics.allocationBytes,
+			.m_blockBytes = budgets[i].statistics.blockBytes,
+			.m_usage = budgets[i].usage,
+			.m_budget = budgets[i].budget,
+			.m_size = pMemoryProperties->memoryHeaps[i].size,
+			.m_bDeviceLocal = (pMemoryProperties->memoryHeaps[i].flags & VK_MEMORY_HEAP_DEVICE_LOCAL_BIT) != 0
+		};
+	}
+	return heaps;
+}
+
+void MemoryTracker::write_stats(const std::string& path) const {
+	std::ofstream ofstrm{ path };
+	if (!ofstrm.is_open())
+		throw std::runtime_error{ "[Kleicha] Failed to open memory statistics output file: " + path };
+
+	ofstrm << "{\n";
+	ofstrm << fmt::format("  \"budget_extension\": {},\n", m_bUseBudgetExtension);
+
+	ofstrm << "  \"categories\": {";
+	for (uint32_t i{ 0 }; i < CATEGORY_COUNT; ++i) {
+		ofstrm << fmt::format("{}\n    \"{}\": {{ \"bytes\": {}, \"peak_bytes\": {}, \"allocations\": {} }}", i > 0 ? "," : "", CATEGORY_NAMES[i],
+			m_categories[i].m_bytes, m_categories[i].m_peakBytes, m_categories[i].m_uiAllocations);
+	}
+	ofstrm << "\n  },\n";
+
+	std::vector<HeapUsage> heaps{ get_heap_usage() };
+	ofstrm << "  \"heaps\": [";
+	for (std::size_t i{ 0 }; i < heaps.size(); ++i) {
+		ofstrm << fmt::format("{}\n    {{ \"device_local\": {}, \"size\": {}, \"budget\": {}, \"usage\": {}, \"block_bytes\": {}, \"allocation_bytes\": {} }}",
+			i > 0 ? "," : "", heaps[i].m_bDeviceLocal, heaps[i].m_size, heaps[i].m_budget, heaps[i].m_usage, heaps[i].m_blockBytes, heaps[i].m_allocationBytes);
+	}
+	ofstrm << "\n  ],\n";
+
+	// vma's statistics string is already json, the detailed map lists every allocation by name
+	char* vmaStats{};
+	vmaBuildStatsString(m_allocator, &vmaStats, VK_TRUE);
+	ofstrm << "  \"vma\": " << vmaStats << "\n";
+	vmaFreeStatsString(m_allocator, vmaStats);
+
+	ofstrm << "}\n";
+	fmt::println("[Kleicha] Wrote memory statistics to {}.", path);
+}
+
+std::size_t MemoryTracker::report_leaks() const {
+	for (const auto& [allocation, tracked] : m_allocations)
+		fmt::println("[Kleicha] Leaked {} allocation {} of {} bytes.", CATEGORY_NAMES[tracked.m_category], tracked.m_name, tracked.m_size);
+
+	return m_allocations.size();
+}
+
+void MemoryTracker::track(VmaAllocation allocation, Category category, const char* name) {
+	VmaAllocationInfo allocationInfo{};
+	vmaGetAllocationInfo(m_allocator, allocation, &allocationInfo);
+	vmaSetAllocationName(m_allocator, allocation, name);
+
+	m_allocations[allocation] = Allocation{ .m_category = category, .m_size = allocationInfo.size, .m_name = name };
+
+	CategoryUsage& usage{ m_categories[category] };
+	usage.m_bytes += allocationInfo.size;
+	usage.m_peakBytes = std::max(usage.m_peakBytes, usage.m_bytes);
+	++usage.m_uiAllocations;
+}
+
+void MemoryTracker::untrack(VmaAllocation allocation) {
+	auto it{ m_allocations.find(allocation) };
+	if (it == m_allocations.end())
+		return;
+
+	CategoryUsage& usage{ m_categories[it->second.m_category] };
+	usage.m_bytes -= it->second.m_size;
+	--usage.m_uiAllocations;
+	m_allocations.erase(it);
+}
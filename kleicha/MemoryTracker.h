@@ -0,0 +1,86 @@
+#ifndef MEMORYTRACKER_H
+#define MEMORYTRACKER_H
+
+#include "Types.h"
+#include "vk_mem_alloc.h"
+
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+// attributes vma allocations to categories and reports their usage next to the heap budgets. allocations are registered
+// after they're created and must be destroyed through the tracker, whatever is still registered at shutdown is reported as
+// leaked. heap budgets come from VK_EXT_memory_budget when it's enabled, otherwise vma estimates them.
+class MemoryTracker {
+public:
+	enum Category {
+		TEXTURES,
+		GEOMETRY,
+		SHADOW_MAPS,
+		RENDER_TARGETS,
+		PER_FRAME,
+		STAGING,
+		DESCRIPTORS,
+		CATEGORY_COUNT
+	};
+
+	static constexpr const char* CATEGORY_NAMES[CATEGORY_COUNT]{ "textures", "geometry", "shadow_maps", "render_targets", "per_frame", "staging", "descriptors" };
+
+	struct CategoryUsage {
+		VkDeviceSize m_bytes{};
+		VkDeviceSize m_peakBytes{};
+		uint32_t m_uiAllocations{};
+	};
+
+	struct HeapUsage {
+		// bytes used by allocations, bytes of the device memory blocks they're placed in and the bytes the heap can still give us
+		VkDeviceSize m_allocationBytes{};
+		VkDeviceSize m_blockBytes{};
+		VkDeviceSize m_usage{};
+		VkDeviceSize m_budget{};
+		VkDeviceSize m_size{};
+		bool m_bDeviceLocal{};
+	};
+
+	void init(VmaAllocator allocator, bool useBudgetExtension);
+
+	bool uses_budget_extension() const {
+		return m_bUseBudgetExtension;
+	}
+
+	// the name shows up in the vma statistics
+	void track(const vkt::Buffer& buffer, Category category, const char* name);
+	void track(const vkt::Image& image, Category category, const char* name);
+	// memory allocated without a resource, e.g. for resources that alias it
+	void track(VmaAllocation allocation, Category category, const char* name);
+	void destroy(const vkt::Buffer& buffer);
+	void destroy(const vkt::Image& image);
+	void free(VmaAllocation allocation);
+
+	const CategoryUsage& get_category_usage(Category category) const {
+		return m_categories[category];
+	}
+
+	std::vector<HeapUsage> get_heap_usage() const;
+
+	// writes the category and heap usage along with the detailed vma statistics string as json
+	void write_stats(const std::string& path) const;
+	// logs every allocation that was never destroyed, returns their count
+	std::size_t report_leaks() const;
+
+private:
+	struct Allocation {
+		Category m_category{};
+		VkDeviceSize m_size{};
+		std::string m_name{};
+	};
+
+	VmaAllocator m_allocator{};
+	bool m_bUseBudgetExtension{ false };
+	CategoryUsage m_categories[CATEGORY_COUNT]{};
+	std::unordered_map<VmaAllocation, Allocation> m_allocations{};
+
+	void untrack(VmaAllocation allocation);
+};
+
+#endif // !MEMORYTRACKER_H
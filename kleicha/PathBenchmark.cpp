@@ -0,0 +1,218 @@
+#include "PathBenchmark.h"
+
+#pragma warning(push, 0)
+#pragma warning(disable : 6285 26498)
+#include "format.h"
+#pragma warning(pop)
+
+#include <algorithm>
+#include <fstream>
+#include <stdexcept>
+
+struct Statistics {
+	double m_dAverage{};
+	float m_fMin{};
+	float m_fMax{};
+	float m_fP50{};
+	float m_fP95{};
+	float m_fP99{};
+	std::size_t m_samples{};
+};
+
+// nearest rank percentiles, times are converted to milliseconds
+static Statistics compute_statistics(std::vector<float> times) {
+	Statistics statistics{ .m_samples = times.size() };
+	if (times.empty())
+		return statistics;
+
+	std::sort(times.begin(), times.end());
+	auto percentile{ [&times](float p) {
+		std::size_t rank{ static_cast<std::size_t>(p * static_cast<float>(times.size() - 1) + 0.5f) };
+		return times[rank] * 1000.0f;
+	} };
+
+	double total{};
+	for (float time : times)
+		total += time;
+
+	statistics.m_dAverage = total / static_cast<double>(times.size()) * 1000.0;
+	statistics.m_fMin = times.front() * 1000.0f;
+	statistics.m_fMax = times.back() * 1000.0f;
+	statistics.m_fP50 = percentile(0.50f);
+	statistics.m_fP95 = percentile(0.95f);
+	statistics.m_fP99 = percentile(0.99f);
+	return statistics;
+}
+
+static std::string statistics_json(const Statistics& statistics) {
+	return fmt::format("{{ \"samples\": {}, \"avg_ms\": {:.4f}, \"min_ms\": {:.4f}, \"max_ms\": {:.4f}, \"p50_ms\": {:.4f}, \"p95_ms\": {:.4f}, \"p99_ms\": {:.4f} }}",
+		statistics.m_samples, statistics.m_dAverage, statistics.m_fMin, statistics.m_fMax, statistics.m_fP50, statistics.m_fP95, statistics.m_fP99);
+}
+
+void PathBenchmark::init(uint32_t measuredFrames, uint32_t framesInFlight, bool depthPrepass) {
+	m_measuredFrames = measuredFrames;
+	m_framesInFlight = framesInFlight;
+	m_bDepthPrepass = depthPrepass;
+	m_results.assign(measuredFrames, Result{});
+	m_frame = 0;
+}
+
+void PathBenchmark::record_frame(uint32_t frameNumber, float cpuTime, uint32_t draws) {
+	if (!is_running())
+		return;
+
+	// the first frames still pay for pipeline compilation and cold caches
+	if (m_frame++ < WARMUP_FRAMES) {
+		m_firstFrameNumber = frameNumber + 1;
+		m_measureStartTime = std::chrono::steady_clock::now();
+		return;
+	}
+
+	Result& result{ m_results[frameNumber - m_firstFrameNumber] };
+	result.m_fCpuTime = cpuTime;
+	result.m_uiDraws = draws;
+
+	if (!is_running()) {
+		m_dMeasuredTime = std::chrono::duration<double>{ std::chrono::steady_clock::now() - m_measureStartTime }.count();
+		fmt::println("[Kleicha] Path benchmark finished after {} measured frames.", m_measuredFrames);
+	}
+}
+
+void PathBenchmark::record_gpu_times(uint32_t frameNumber, const std::vector<GpuProfiler::Scope>& scopes) {
+	if (m_frame <= WARMUP_FRAMES || frameNumber < m_firstFrameNumber || frameNumber - m_firstFrameNumber >= m_results.size() || scopes.empty())
+		return;
+
+	Result& result{ m_results[frameNumber - m_firstFrameNumber] };
+	result.m_fGpuTime = scopes[0].m_fTime;
+
+	// scopes are only ever appended, the first frame to use a pass names its column
+	for (std::size_t i{ m_passNames.size() }; i < scopes.size(); ++i)
+		m_passNames.push_back(scopes[i].m_name);
+
+	result.m_passTimes.assign(scopes.size(), -1.0f);
+	result.m_passFragments.assign(scopes.size(), -1);
+	for (std::size_t i{ 1 }; i < scopes.size(); ++i) {
+		if (scopes[i].m_uiFrameNumber != frameNumber)
+			continue;
+
+		result.m_passTimes[i] = scopes[i].m_fTime;
+		if (scopes[i].m_bHasStatistics)
+			result.m_passFragments[i] = static_cast<int64_t>(scopes[i].m_statistics[GpuProfiler::FRAGMENT_SHADER_INVOCATIONS]);
+	}
+}
+
+void PathBenchmark::record_latency(uint32_t frameNumber, float latency) {
+	if (m_frame <= WARMUP_FRAMES || frameNumber < m_firstFrameNumber || frameNumber - m_firstFrameNumber >= m_results.size())
+		return;
+
+	m_results[frameNumber - m_firstFrameNumber].m_fLatency = latency;
+}
+
+void PathBenchmark::record_input_to_gpu_complete(uint32_t frameNumber, float inputToGpuComplete) {
+	if (m_frame <= WARMUP_FRAMES || frameNumber < m_firstFrameNumber || frameNumber - m_firstFrameNumber >= m_results.size())
+		return;
+
+	m_results[frameNumber - m_firstFrameNumber].m_fInputToGpuComplete = inputToGpuComplete;
+}
+
+void PathBenchmark::write_results(const std::string& basePath) const {
+	std::string csvPath{ basePath + ".csv" };
+	std::ofstream csv{ csvPath };
+	if (!csv.is_open())
+		throw std::runtime_error{ "[Kleicha] Failed to open benchmark output file: " + csvPath };
+
+	std::vector<float> cpuTimes{};
+	std::vector<float> gpuTimes{};
+	std::vector<float> latencies{};
+	std::vector<float> inputToGpuCompletes{};
+	uint64_t totalDraws{};
+
+	// the first pass is the whole frame, it's already the gpu_ms column
+	std::vector<std::vector<float>> passTimes(m_passNames.size());
+	std::vector<uint64_t> passFragments(m_passNames.size());
+	std::vector<uint32_t> passFragmentSamples(m_passNames.size());
+	auto format_time{ [](float time) { return time < 0.0f ? std::string{} : fmt::format("{:.4f}", time * 1000.0f); } };
+
+	csv << "frame,cpu_ms,gpu_ms,latency_ms,input_to_gpu_complete_ms,draws";
+	for (std::size_t pass{ 1 }; pass < m_passNames.size(); ++pass)
+		csv << ",gpu_" << m_passNames[pass] << "_ms";
+	for (std::size_t pass{ 1 }; pass < m_passNames.size(); ++pass)
+		csv << "," << m_passNames[pass] << "_fragments";
+	csv << "\n";
+
+	for (std::size_t i{ 0 }; i < m_results.size(); ++i) {
+		const Result& result{ m_results[i] };
+		csv << fmt::format("{},{:.4f},{},{},{},{}", i, result.m_fCpuTime * 1000.0f, format_time(result.m_fGpuTime), format_time(result.m_fLatency),
+			format_time(result.m_fInputToGpuComplete), result.m_uiDraws);
+		for (std::size_t pass{ 1 }; pass < m_passNames.size(); ++pass) {
+			float passTime{ pass < result.m_passTimes.size() ? result.m_passTimes[pass] : -1.0f };
+			csv << "," << format_time(passTime);
+			if (passTime >= 0.0f)
+				passTimes[pass].push_back(passTime);
+		}
+		for (std::size_t pass{ 1 }; pass < m_passNames.size(); ++pass) {
+			int64_t fragments{ pass < result.m_passFragments.size() ? result.m_passFragments[pass] : -1 };
+			csv << "," << (fragments < 0 ? std::string{} : std::to_string(fragments));
+			if (fragments >= 0) {
+				passFragments[pass] += static_cast<uint64_t>(fragments);
+				++passFragmentSamples[pass];
+			}
+		}
+		csv << "\n";
+
+		cpuTimes.push_back(result.m_fCpuTime);
+		if (result.m_fGpuTime >= 0.0f)
+			gpuTimes.push_back(result.m_fGpuTime);
+		// the last frames in flight complete after the benchmark has ended
+		if (result.m_fLatency >= 0.0f)
+			latencies.push_back(result.m_fLatency);
+		if (result.m_fInputToGpuComplete >= 0.0f)
+			inputToGpuCompletes.push_back(result.m_fInputToGpuComplete);
+		totalDraws += result.m_uiDraws;
+	}
+
+	Statistics cpu{ compute_statistics(cpuTimes) };
+	Statistics gpu{ compute_statistics(gpuTimes) };
+	Statistics latency{ compute_statistics(latencies) };
+	Statistics inputToGpuComplete{ compute_statistics(inputToGpuCompletes) };
+	double framesPerSecond{ m_dMeasuredTime > 0.0 ? static_cast<double>(m_results.size()) / m_dMeasuredTime : 0.0 };
+
+	std::string jsonPath{ basePath + ".json" };
+	std::ofstream json{ jsonPath };
+	if (!json.is_open())
+		throw std::runtime_error{ "[Kleicha] Failed to open benchmark output file: " + jsonPath };
+
+	json << "{\n";
+	json << fmt::format("  \"frames\": {},\n", m_results.size());
+	json << fmt::format("  \"timestep_s\": {:.6f},\n", TIMESTEP);
+	json << fmt::format("  \"frames_in_flight\": {},\n", m_framesInFlight);
+	json << fmt::format("  \"depth_prepass\": {},\n", m_bDepthPrepass);
+	json << fmt::format("  \"fps\": {:.2f},\n", framesPerSecond);
+	json << fmt::format("  \"avg_draws\": {:.1f},\n", m_results.empty() ? 0.0 : static_cast<double>(totalDraws) / static_cast<double>(m_results.size()));
+	json << fmt::format("  \"cpu\": {},\n", statistics_json(cpu));
+	json << fmt::format("  \"gpu\": {},\n", statistics_json(gpu));
+	json << fmt::format("  \"latency\": {},\n", statistics_json(latency));
+	json << fmt::format("  \"input_to_gpu_complete\": {},\n", statistics_json(inputToGpuComplete));
+	json << "  \"gpu_passes\": {";
+	for (std::size_t pass{ 1 }; pass < m_passNames.size(); ++pass)
+		json << fmt::format("{}\n    \"{}\": {}", pass > 1 ? "," : "", m_passNames[pass], statistics_json(compute_statistics(passTimes[pass])));
+	json << (m_passNames.size() > 1 ? "\n  },\n" : "},\n");
+	// average fragment shader invocations per frame, only passes that collected pipeline statistics
+	json << "  \"pass_fragments\": {";
+	bool firstFragments{ true };
+	for (std::size_t pass{ 1 }; pass < m_passNames.size(); ++pass) {
+		if (passFragmentSamples[pass] == 0)
+			continue;
+		json << fmt::format("{}\n    \"{}\": {:.0f}", firstFragments ? "" : ",", m_passNames[pass],
+			static_cast<double>(passFragments[pass]) / static_cast<double>(passFragmentSamples[pass]));
+		firstFragments = false;
+	}
+	json << (firstFragments ? "}\n" : "\n  }\n");
+	json << "}\n";
+
+	fmt::println("[Kleicha] Path benchmark: cpu p50 {:.3f} ms p95 {:.3f} ms p99 {:.3f} ms, gpu p50 {:.3f} ms p95 {:.3f} ms p99 {:.3f} ms.",
+		cpu.m_fP50, cpu.m_fP95, cpu.m_fP99, gpu.m_fP50, gpu.m_fP95, gpu.m_fP99);
+	fmt::println("[Kleicha] Path benchmark with {} frames in flight: {:.1f} fps, latency p50 {:.3f} ms p95 {:.3f} ms p99 {:.3f} ms, input to gpu complete p50 {:.3f} ms.",
+		m_framesInFlight, framesPerSecond, latency.m_fP50, latency.m_fP95, latency.m_fP99, inputToGpuComplete.m_fP50);
+	fmt::println("[Kleicha] Wrote path benchmark results to {} and {}.", csvPath, jsonPath);
+}
@@ -0,0 +1,73 @@
+#ifndef PATHBENCHMARK_H
+#define PATHBENCHMARK_H
+
+#include <chrono>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+#include "GpuProfiler.h"
+
+// replays a camera path with a fixed timestep so that every run renders exactly the same frames. a few warmup frames are
+// rendered before the measured ones, the per frame cpu and gpu times are written as csv along with a json summary. gpu times
+// are broken down by the profiler's pass scopes. the summary also reports throughput and frame latency, runs with different
+// frames in flight can be compared on it. with calibrated timestamps it also reports the time from sampling the camera to
+// the gpu finishing the frame. with pipeline statistics the fragment shader invocations of each pass are recorded
+// as well, which shows the overdraw a depth pre-pass saves.
+class PathBenchmark {
+public:
+	static constexpr float TIMESTEP{ 1.0f / 60.0f };
+	static constexpr uint32_t WARMUP_FRAMES{ 60 };
+
+	void init(uint32_t measuredFrames, uint32_t framesInFlight, bool depthPrepass);
+
+	bool is_running() const {
+		return m_measuredFrames > 0 && m_frame < WARMUP_FRAMES + m_measuredFrames;
+	}
+
+	// path time of the frame about to be rendered
+	float get_time() const {
+		return static_cast<float>(m_frame) * TIMESTEP;
+	}
+
+	// frameNumber identifies the frame when its gpu time arrives, times are in seconds
+	void record_frame(uint32_t frameNumber, float cpuTime, uint32_t draws);
+	// gpu times are only known once the frame's fence has signaled, a few frames after it was recorded. the first scope spans
+	// the whole frame.
+	void record_gpu_times(uint32_t frameNumber, const std::vector<GpuProfiler::Scope>& scopes);
+	// seconds from the start of the frame's cpu work until its fence was seen signaled
+	void record_latency(uint32_t frameNumber, float latency);
+	// seconds from the moment the frame's camera was sampled until the gpu finished the frame, taken from its timestamps
+	void record_input_to_gpu_complete(uint32_t frameNumber, float inputToGpuComplete);
+
+	// writes <basePath>.csv with every measured frame and <basePath>.json with the summary
+	void write_results(const std::string& basePath) const;
+
+private:
+	struct Result {
+		float m_fCpuTime{};
+		// negative until the gpu time has arrived, stays negative without timestamp support
+		float m_fGpuTime{ -1.0f };
+		uint32_t m_uiDraws{};
+		float m_fLatency{ -1.0f };
+		// negative without calibrated timestamps
+		float m_fInputToGpuComplete{ -1.0f };
+		// indexed like the profiler's scopes, negative for passes the frame skipped
+		std::vector<float> m_passTimes{};
+		// fragment shader invocations, negative for passes without pipeline statistics
+		std::vector<int64_t> m_passFragments{};
+	};
+
+	std::vector<std::string> m_passNames{};
+
+	std::vector<Result> m_results{};
+	uint32_t m_measuredFrames{};
+	uint32_t m_framesInFlight{};
+	bool m_bDepthPrepass{};
+	std::chrono::steady_clock::time_point m_measureStartTime{};
+	double m_dMeasuredTime{};
+	uint32_t m_frame{};
+	uint32_t m_firstFrameNumber{};
+};
+
+#endif // !PATHBENCHMARK_H
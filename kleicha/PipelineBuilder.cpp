@@ -89,9 +89,9 @@ PipelineBuilder& PipelineBuilder::set_color_blend_state(VkColorComponentFlags co
 	return *this;
 }
 
-PipelineBuilder& PipelineBuilder::set_depth_stencil_state(VkBool32 depthTestEnable, VkCompareOp depthCompareOp) {
+PipelineBuilder& PipelineBuilder::set_depth_stencil_state(VkBool32 depthTestEnable, VkCompareOp depthCompareOp, VkBool32 depthWriteEnable) {
 	m_depthStencilInfo.depthTestEnable = depthTestEnable;
-	m_depthStencilInfo.depthWriteEnable = VK_TRUE;
+	m_depthStencilInfo.depthWriteEnable = depthWriteEnable;
 	m_depthStencilInfo.depthCompareOp = depthCompareOp;
 	// sample depth should fall between [0,1] NDC, if it doesn't it shouldn't be reflected in the fragment's coverage mask.
 	m_depthStencilInfo.depthBoundsTestEnable = VK_TRUE;
@@ -115,60 +115,281 @@ PipelineBuilder& PipelineBuilder::set_depth_attachment_format(VkFormat format) {
 }
 
 
-VkPipeline PipelineBuilder::build() {
+PipelineDescription PipelineBuilder::describe() const {
+
+	PipelineDescription description{};
+	description.m_shaderInfos = m_shaderInfos;
+	description.m_specializations.resize(m_shaderInfos.size());
+
+	// specialization constants may live on the caller's stack, take copies of them
+	for (std::size_t i{ 0 }; i < m_shaderInfos.size(); ++i) {
+		const VkSpecializationInfo* specializationInfo{ m_shaderInfos[i].pSpecializationInfo };
+		if (!specializationInfo)
+			continue;
+
+		PipelineDescription::Specialization& specialization{ description.m_specializations[i] };
+		specialization.m_mapEntries.assign(specializationInfo->pMapEntries, specializationInfo->pMapEntries + specializationInfo->mapEntryCount);
+		const uint8_t* data{ static_cast<const uint8_t*>(specializationInfo->pData) };
+		specialization.m_data.assign(data, data + specializationInfo->dataSize);
+	}
+
+	description.m_vertInputInfo = m_vertInputInfo;
+	description.m_inputAssemblyInfo = m_inputAssemblyInfo;
+	description.m_rasterizationInfo = m_rasterizationInfo;
+	description.m_multisampleInfo = m_multisampleInfo;
+	description.m_depthStencilInfo = m_depthStencilInfo;
+	description.m_colorBlendInfo = m_colorBlendInfo;
+	description.m_colorBlendAttachmentState = m_colorBlendAttachmentState;
+	description.m_renderingInfo = m_renderingInfo;
+	description.m_colorAttachmentFormat = m_colorAttachmentFormat;
+	description.m_pipelineLayout = pipelineLayout;
+	description.m_createFlags = m_createFlags;
 
 	if (m_color_output_disabled) {
-		m_renderingInfo.colorAttachmentCount = 0;
-		m_renderingInfo.pColorAttachmentFormats = nullptr;
+		description.m_renderingInfo.colorAttachmentCount = 0;
+		description.m_renderingInfo.pColorAttachmentFormats = nullptr;
 	}
 
-	VkGraphicsPipelineCreateInfo pipelineInfo{ .sType = VK_STRUCTURE_TYPE_GRAPHICS_PIPELINE_CREATE_INFO };
-	pipelineInfo.pNext = &m_renderingInfo;
-	pipelineInfo.stageCount = static_cast<uint32_t>(m_shaderInfos.size());
-	pipelineInfo.pStages = m_shaderInfos.data();
+	return description;
+}
+
+VkPipeline PipelineBuilder::build() {
+	return describe().compile(m_device, m_pipelineCache);
+}
+
+// 64-bit FNV-1a, accumulates the bytes of each value into the running hash
+template<typename T>
+static void hash_value(uint64_t& hash, const T& value) {
+	const unsigned char* bytes{ reinterpret_cast<const unsigned char*>(&value) };
+	for (std::size_t i{ 0 }; i < sizeof(T); ++i) {
+		hash ^= bytes[i];
+		hash *= 1099511628211ULL;
+	}
+}
+
+void PipelineDescription::fill_create_info(CreateInfo& createInfo) const {
+
+	// the description may have been moved since it was created, point the create infos at this copy's state
+	createInfo.specializationInfos.resize(m_shaderInfos.size());
+	createInfo.shaderInfos = m_shaderInfos;
+	for (std::size_t i{ 0 }; i < createInfo.shaderInfos.size(); ++i) {
+		if (!createInfo.shaderInfos[i].pSpecializationInfo)
+			continue;
+
+		const Specialization& specialization{ m_specializations[i] };
+		VkSpecializationInfo& specializationInfo{ createInfo.specializationInfos[i] };
+		specializationInfo.mapEntryCount = static_cast<uint32_t>(specialization.m_mapEntries.size());
+		specializationInfo.pMapEntries = specialization.m_mapEntries.data();
+		specializationInfo.dataSize = specialization.m_data.size();
+		specializationInfo.pData = specialization.m_data.data();
+		createInfo.shaderInfos[i].pSpecializationInfo = &specializationInfo;
+	}
+
+	createInfo.renderingInfo = m_renderingInfo;
+	if (createInfo.renderingInfo.colorAttachmentCount > 0)
+		createInfo.renderingInfo.pColorAttachmentFormats = &m_colorAttachmentFormat;
+
+	VkGraphicsPipelineCreateInfo& pipelineInfo{ createInfo.pipelineInfo };
+	pipelineInfo = { .sType = VK_STRUCTURE_TYPE_GRAPHICS_PIPELINE_CREATE_INFO };
+	pipelineInfo.pNext = &createInfo.renderingInfo;
+	pipelineInfo.flags = m_createFlags;
+	pipelineInfo.stageCount = static_cast<uint32_t>(createInfo.shaderInfos.size());
+	pipelineInfo.pStages = createInfo.shaderInfos.data();
 	pipelineInfo.pVertexInputState = &m_vertInputInfo; // we will be using buffer device address, no need to describe to the pipeline how to read the vertex attribute data.
 
 	pipelineInfo.pInputAssemblyState = &m_inputAssemblyInfo;
 
 	// viewport and scissor state will be set dynamically during command buffer recording
-	VkDynamicState dynamicStates[]{ VK_DYNAMIC_STATE_VIEWPORT, VK_DYNAMIC_STATE_SCISSOR };
-	VkPipelineDynamicStateCreateInfo dynamicStateInfo{ .sType = VK_STRUCTURE_TYPE_PIPELINE_DYNAMIC_STATE_CREATE_INFO };
-	dynamicStateInfo.dynamicStateCount = static_cast<uint32_t>(std::size(dynamicStates));
-	dynamicStateInfo.pDynamicStates = dynamicStates;
-	pipelineInfo.pDynamicState = &dynamicStateInfo;
+	createInfo.dynamicStateInfo = { .sType = VK_STRUCTURE_TYPE_PIPELINE_DYNAMIC_STATE_CREATE_INFO };
+	createInfo.dynamicStateInfo.dynamicStateCount = static_cast<uint32_t>(std::size(createInfo.dynamicStates));
+	createInfo.dynamicStateInfo.pDynamicStates = createInfo.dynamicStates;
+	pipelineInfo.pDynamicState = &createInfo.dynamicStateInfo;
 
 	// we still need to provide the viewport state info
-	VkPipelineViewportStateCreateInfo viewportStateInfo{ .sType = VK_STRUCTURE_TYPE_PIPELINE_VIEWPORT_STATE_CREATE_INFO };
-	viewportStateInfo.viewportCount = 1;
-	viewportStateInfo.scissorCount = 1;
+	createInfo.viewportStateInfo = { .sType = VK_STRUCTURE_TYPE_PIPELINE_VIEWPORT_STATE_CREATE_INFO };
+	createInfo.viewportStateInfo.viewportCount = 1;
+	createInfo.viewportStateInfo.scissorCount = 1;
 
-	pipelineInfo.pViewportState = &viewportStateInfo;
+	pipelineInfo.pViewportState = &createInfo.viewportStateInfo;
 
 	pipelineInfo.pRasterizationState = &m_rasterizationInfo;
 
 	// use point sampling for now
-	m_multisampleInfo.rasterizationSamples = VK_SAMPLE_COUNT_1_BIT;
-	m_multisampleInfo.sampleShadingEnable = VK_FALSE;
-	m_multisampleInfo.alphaToCoverageEnable = VK_FALSE;
+	createInfo.multisampleInfo = m_multisampleInfo;
+	createInfo.multisampleInfo.rasterizationSamples = VK_SAMPLE_COUNT_1_BIT;
+	createInfo.multisampleInfo.sampleShadingEnable = VK_FALSE;
+	createInfo.multisampleInfo.alphaToCoverageEnable = VK_FALSE;
 
-	pipelineInfo.pMultisampleState = &m_multisampleInfo;
+	pipelineInfo.pMultisampleState = &createInfo.multisampleInfo;
 
 	pipelineInfo.pDepthStencilState = &m_depthStencilInfo;
 
-	m_colorBlendInfo.attachmentCount = 1;
-	m_colorBlendInfo.pAttachments = &m_colorBlendAttachmentState;
+	// the blend state must describe exactly as many attachments as the pipeline renders to
+	createInfo.colorBlendInfo = m_colorBlendInfo;
+	createInfo.colorBlendInfo.attachmentCount = createInfo.renderingInfo.colorAttachmentCount;
+	createInfo.colorBlendInfo.pAttachments = &m_colorBlendAttachmentState;
+
+	pipelineInfo.pColorBlendState = &createInfo.colorBlendInfo;
+
+	createInfo.tessellationStateInfo = { .sType = VK_STRUCTURE_TYPE_PIPELINE_TESSELLATION_STATE_CREATE_INFO };
+	createInfo.tessellationStateInfo.patchControlPoints = 16U;
 
-	pipelineInfo.pColorBlendState = &m_colorBlendInfo;
+	pipelineInfo.layout = m_pipelineLayout;
 
-	VkPipelineTessellationStateCreateInfo tessellationStateInfo{ .sType = VK_STRUCTURE_TYPE_PIPELINE_TESSELLATION_STATE_CREATE_INFO };
-	tessellationStateInfo.patchControlPoints = 16U;
+	pipelineInfo.pTessellationState = &createInfo.tessellationStateInfo;
+}
 
-	pipelineInfo.layout = pipelineLayout;
+VkPipeline PipelineDescription::compile(VkDevice device, VkPipelineCache pipelineCache) const {
 
-	pipelineInfo.pTessellationState = &tessellationStateInfo;
+	CreateInfo createInfo{};
+	fill_create_info(createInfo);
 
 	VkPipeline pipeline{};
-	VK_CHECK(vkCreateGraphicsPipelines(m_device, VK_NULL_HANDLE, 1, &pipelineInfo, nullptr, &pipeline));
+	VK_CHECK(vkCreateGraphicsPipelines(device, pipelineCache, 1, &createInfo.pipelineInfo, nullptr, &pipeline));
 
 	return pipeline;
-}
\ No newline at end of file
+}
+
+VkPipeline PipelineDescription::compile_library(VkDevice device, VkPipelineCache pipelineCache, VkGraphicsPipelineLibraryFlagsEXT part) const {
+
+	CreateInfo createInfo{};
+	fill_create_info(createInfo);
+
+	// keep only the state that belongs to this part of the pipeline
+	std::vector<VkPipelineShaderStageCreateInfo> shaderInfos{};
+	for (const auto& shaderInfo : createInfo.shaderInfos) {
+		bool fragmentStage{ shaderInfo.stage == VK_SHADER_STAGE_FRAGMENT_BIT };
+		if ((fragmentStage && part == VK_GRAPHICS_PIPELINE_LIBRARY_FRAGMENT_SHADER_BIT_EXT) ||
+			(!fragmentStage && part == VK_GRAPHICS_PIPELINE_LIBRARY_PRE_RASTERIZATION_SHADERS_BIT_EXT))
+			shaderInfos.push_back(shaderInfo);
+	}
+
+	VkGraphicsPipelineCreateInfo& pipelineInfo{ createInfo.pipelineInfo };
+	pipelineInfo.stageCount = static_cast<uint32_t>(shaderInfos.size());
+	pipelineInfo.pStages = shaderInfos.data();
+
+	if (part != VK_GRAPHICS_PIPELINE_LIBRARY_VERTEX_INPUT_INTERFACE_BIT_EXT) {
+		pipelineInfo.pVertexInputState = nullptr;
+		pipelineInfo.pInputAssemblyState = nullptr;
+	}
+
+	if (part != VK_GRAPHICS_PIPELINE_LIBRARY_PRE_RASTERIZATION_SHADERS_BIT_EXT) {
+		pipelineInfo.pViewportState = nullptr;
+		pipelineInfo.pRasterizationState = nullptr;
+		pipelineInfo.pTessellationState = nullptr;
+		pipelineInfo.pDynamicState = nullptr;
+	}
+
+	if (part != VK_GRAPHICS_PIPELINE_LIBRARY_FRAGMENT_SHADER_BIT_EXT)
+		pipelineInfo.pDepthStencilState = nullptr;
+
+	if (part != VK_GRAPHICS_PIPELINE_LIBRARY_FRAGMENT_SHADER_BIT_EXT && part != VK_GRAPHICS_PIPELINE_LIBRARY_FRAGMENT_OUTPUT_INTERFACE_BIT_EXT)
+		pipelineInfo.pMultisampleState = nullptr;
+
+	if (part != VK_GRAPHICS_PIPELINE_LIBRARY_FRAGMENT_OUTPUT_INTERFACE_BIT_EXT)
+		pipelineInfo.pColorBlendState = nullptr;
+
+	// only the shader parts access descriptors and push constants
+	if (part != VK_GRAPHICS_PIPELINE_LIBRARY_PRE_RASTERIZATION_SHADERS_BIT_EXT && part != VK_GRAPHICS_PIPELINE_LIBRARY_FRAGMENT_SHADER_BIT_EXT)
+		pipelineInfo.layout = VK_NULL_HANDLE;
+
+	VkGraphicsPipelineLibraryCreateInfoEXT libraryInfo{ .sType = VK_STRUCTURE_TYPE_GRAPHICS_PIPELINE_LIBRARY_CREATE_INFO_EXT };
+	libraryInfo.pNext = pipelineInfo.pNext;
+	libraryInfo.flags = part;
+	pipelineInfo.pNext = &libraryInfo;
+	// retaining link time optimization info lets the background link optimize across the parts
+	pipelineInfo.flags |= VK_PIPELINE_CREATE_LIBRARY_BIT_KHR | VK_PIPELINE_CREATE_RETAIN_LINK_TIME_OPTIMIZATION_INFO_BIT_EXT;
+
+	VkPipeline library{};
+	VK_CHECK(vkCreateGraphicsPipelines(device, pipelineCache, 1, &pipelineInfo, nullptr, &library));
+
+	return library;
+}
+
+VkPipeline PipelineDescription::link(VkDevice device, VkPipelineCache pipelineCache, const std::array<VkPipeline, 4>& libraries, bool optimize) const {
+
+	VkPipelineLibraryCreateInfoKHR libraryInfo{ .sType = VK_STRUCTURE_TYPE_PIPELINE_LIBRARY_CREATE_INFO_KHR };
+	libraryInfo.libraryCount = static_cast<uint32_t>(libraries.size());
+	libraryInfo.pLibraries = libraries.data();
+
+	VkGraphicsPipelineCreateInfo pipelineInfo{ .sType = VK_STRUCTURE_TYPE_GRAPHICS_PIPELINE_CREATE_INFO };
+	pipelineInfo.pNext = &libraryInfo;
+	pipelineInfo.flags = m_createFlags | (optimize ? VK_PIPELINE_CREATE_LINK_TIME_OPTIMIZATION_BIT_EXT : 0);
+	pipelineInfo.layout = m_pipelineLayout;
+
+	VkPipeline pipeline{};
+	VK_CHECK(vkCreateGraphicsPipelines(device, pipelineCache, 1, &pipelineInfo, nullptr, &pipeline));
+
+	return pipeline;
+}
+
+uint64_t PipelineDescription::library_key(VkGraphicsPipelineLibraryFlagsEXT part) const {
+
+	uint64_t hash{ 14695981039346656037ULL };
+	hash_value(hash, part);
+	// libraries can only be linked with pipelines created with the same descriptor binding model
+	hash_value(hash, m_createFlags);
+
+	if (part == VK_GRAPHICS_PIPELINE_LIBRARY_VERTEX_INPUT_INTERFACE_BIT_EXT) {
+		hash_value(hash, m_inputAssemblyInfo.topology);
+		hash_value(hash, m_inputAssemblyInfo.primitiveRestartEnable);
+		return hash;
+	}
+
+	hash_value(hash, m_renderingInfo.viewMask);
+
+	if (part == VK_GRAPHICS_PIPELINE_LIBRARY_FRAGMENT_OUTPUT_INTERFACE_BIT_EXT) {
+		uint32_t colorAttachmentCount{ m_renderingInfo.colorAttachmentCount };
+		hash_value(hash, colorAttachmentCount);
+		if (colorAttachmentCount > 0)
+			hash_value(hash, m_colorAttachmentFormat);
+		hash_value(hash, m_renderingInfo.depthAttachmentFormat);
+		hash_value(hash, m_colorBlendAttachmentState.colorWriteMask);
+		hash_value(hash, m_colorBlendAttachmentState.blendEnable);
+		hash_value(hash, m_colorBlendAttachmentState.srcColorBlendFactor);
+		hash_value(hash, m_colorBlendAttachmentState.dstColorBlendFactor);
+		hash_value(hash, m_colorBlendAttachmentState.colorBlendOp);
+		hash_value(hash, m_colorBlendAttachmentState.srcAlphaBlendFactor);
+		hash_value(hash, m_colorBlendAttachmentState.dstAlphaBlendFactor);
+		hash_value(hash, m_colorBlendAttachmentState.alphaBlendOp);
+		return hash;
+	}
+
+	hash_value(hash, m_pipelineLayout);
+
+	// shader modules are identified by handle, specialization constants by their values
+	for (std::size_t i{ 0 }; i < m_shaderInfos.size(); ++i) {
+		bool fragmentStage{ m_shaderInfos[i].stage == VK_SHADER_STAGE_FRAGMENT_BIT };
+		if (fragmentStage != (part == VK_GRAPHICS_PIPELINE_LIBRARY_FRAGMENT_SHADER_BIT_EXT))
+			continue;
+
+		hash_value(hash, m_shaderInfos[i].stage);
+		hash_value(hash, m_shaderInfos[i].module);
+		for (const auto& mapEntry : m_specializations[i].m_mapEntries) {
+			hash_value(hash, mapEntry.constantID);
+			hash_value(hash, mapEntry.offset);
+			hash_value(hash, mapEntry.size);
+		}
+		for (uint8_t byte : m_specializations[i].m_data)
+			hash_value(hash, byte);
+	}
+
+	if (part == VK_GRAPHICS_PIPELINE_LIBRARY_PRE_RASTERIZATION_SHADERS_BIT_EXT) {
+		hash_value(hash, m_rasterizationInfo.polygonMode);
+		hash_value(hash, m_rasterizationInfo.cullMode);
+		hash_value(hash, m_rasterizationInfo.frontFace);
+		hash_value(hash, m_rasterizationInfo.depthBiasEnable);
+		hash_value(hash, m_rasterizationInfo.depthBiasConstantFactor);
+		hash_value(hash, m_rasterizationInfo.depthBiasSlopeFactor);
+	}
+	else {
+		hash_value(hash, m_depthStencilInfo.depthTestEnable);
+		hash_value(hash, m_depthStencilInfo.depthWriteEnable);
+		hash_value(hash, m_depthStencilInfo.depthCompareOp);
+		hash_value(hash, m_depthStencilInfo.depthBoundsTestEnable);
+		hash_value(hash, m_depthStencilInfo.minDepthBounds);
+		hash_value(hash, m_depthStencilInfo.maxDepthBounds);
+	}
+
+	return hash;
+}
@@ -1,16 +1,71 @@
 #ifndef PIPELINEBUILDER
 #define PIPELINEBUILDER
 
+#include <array>
 #include <vector>
 #include <vulkan/vulkan.h>
 
 #include "Utils.h"
 
+// snapshot of a builder's state that owns everything its create info points to, so it can be compiled later on any thread.
+// only the shader modules and the pipeline layout it references must outlive the compilation.
+class PipelineDescription {
+public:
+	VkPipeline compile(VkDevice device, VkPipelineCache pipelineCache) const;
+
+	// VK_EXT_graphics_pipeline_library: compiles one of the four parts of the pipeline (vertex input, pre-rasterization shaders,
+	// fragment shader or fragment output) on its own. descriptions with equal keys for a part produce interchangeable libraries.
+	VkPipeline compile_library(VkDevice device, VkPipelineCache pipelineCache, VkGraphicsPipelineLibraryFlagsEXT part) const;
+	uint64_t library_key(VkGraphicsPipelineLibraryFlagsEXT part) const;
+	// links the four parts into a complete pipeline, a fast link unless optimize is set
+	VkPipeline link(VkDevice device, VkPipelineCache pipelineCache, const std::array<VkPipeline, 4>& libraries, bool optimize) const;
+
+private:
+	friend class PipelineBuilder;
+
+	// backing storage for everything the pipeline create info points to
+	struct CreateInfo {
+		std::vector<VkPipelineShaderStageCreateInfo> shaderInfos{};
+		std::vector<VkSpecializationInfo> specializationInfos{};
+		VkPipelineRenderingCreateInfo renderingInfo{};
+		VkDynamicState dynamicStates[2]{ VK_DYNAMIC_STATE_VIEWPORT, VK_DYNAMIC_STATE_SCISSOR };
+		VkPipelineDynamicStateCreateInfo dynamicStateInfo{};
+		VkPipelineViewportStateCreateInfo viewportStateInfo{};
+		VkPipelineMultisampleStateCreateInfo multisampleInfo{};
+		VkPipelineColorBlendStateCreateInfo colorBlendInfo{};
+		VkPipelineTessellationStateCreateInfo tessellationStateInfo{};
+		VkGraphicsPipelineCreateInfo pipelineInfo{};
+	};
+
+	struct Specialization {
+		std::vector<VkSpecializationMapEntry> m_mapEntries{};
+		std::vector<uint8_t> m_data{};
+	};
+
+	// one specialization per shader stage, only used by stages with a specialization info
+	std::vector<VkPipelineShaderStageCreateInfo>	m_shaderInfos{};
+	std::vector<Specialization>						m_specializations{};
+	VkPipelineVertexInputStateCreateInfo			m_vertInputInfo{};
+	VkPipelineInputAssemblyStateCreateInfo			m_inputAssemblyInfo{};
+	VkPipelineRasterizationStateCreateInfo			m_rasterizationInfo{};
+	VkPipelineMultisampleStateCreateInfo			m_multisampleInfo{};
+	VkPipelineDepthStencilStateCreateInfo			m_depthStencilInfo{};
+	VkPipelineColorBlendStateCreateInfo				m_colorBlendInfo{};
+	VkPipelineColorBlendAttachmentState				m_colorBlendAttachmentState{};
+	VkPipelineRenderingCreateInfo					m_renderingInfo{};
+	VkFormat										m_colorAttachmentFormat{};
+	VkPipelineLayout								m_pipelineLayout{};
+	VkPipelineCreateFlags							m_createFlags{};
+
+	void fill_create_info(CreateInfo& createInfo) const;
+};
+
 // pipeline builder will alter its internal structures through the provided public interface
 class PipelineBuilder {
 public:
-	PipelineBuilder(VkDevice device)
-		: m_device{device}
+	// pipelines are built through the given cache if there is one
+	PipelineBuilder(VkDevice device, VkPipelineCache pipelineCache = VK_NULL_HANDLE)
+		: m_device{device}, m_pipelineCache{ pipelineCache }
 	{
 		reset();
 	}
@@ -19,13 +74,15 @@ public:
 	VkPipelineLayout pipelineLayout{};
 	void reset();
 	VkPipeline build();
+	// captures the current state for compilation elsewhere, the builder can keep being modified afterwards
+	PipelineDescription describe() const;
 	PipelineBuilder& set_input_assembly_state(VkPrimitiveTopology topology = VK_PRIMITIVE_TOPOLOGY_TRIANGLE_LIST);
 	PipelineBuilder& set_shaders(VkShaderModule* vertexShader, VkSpecializationInfo* vertSpecializationInfo = nullptr, VkShaderModule* fragmentShader = nullptr, VkSpecializationInfo* fragSpecializationInfo = nullptr, VkShaderModule* tessControlShader = nullptr, VkShaderModule* tessEvalShader = nullptr);
 	PipelineBuilder& set_rasterizer_state(VkPolygonMode polygonMode, VkCullModeFlags cullMode, VkFrontFace frontFace, float depthBiasConstant = 0.0f, float depthBiasSlope = 0.0f);
 	PipelineBuilder& set_color_blend_state(VkColorComponentFlags colorComponentFlags, VkBool32 blendEnable = false);
 
 
-	PipelineBuilder& set_depth_stencil_state(VkBool32 depthTestEnable, VkCompareOp depthCompareOp = VK_COMPARE_OP_GREATER_OR_EQUAL);
+	PipelineBuilder& set_depth_stencil_state(VkBool32 depthTestEnable, VkCompareOp depthCompareOp = VK_COMPARE_OP_GREATER_OR_EQUAL, VkBool32 depthWriteEnable = VK_TRUE);
 	PipelineBuilder& set_color_attachment_format(VkFormat format);
 	PipelineBuilder& set_depth_attachment_format(VkFormat format);
 
@@ -45,6 +102,12 @@ public:
 		return *this;
 	}
 
+	// added to the flags of every pipeline and library compiled from the builder's descriptions
+	PipelineBuilder& set_create_flags(VkPipelineCreateFlags createFlags) {
+		m_createFlags = createFlags;
+		return *this;
+	}
+
 private:
 	std::vector<VkPipelineShaderStageCreateInfo>	m_shaderInfos{};
 	VkPipelineVertexInputStateCreateInfo			m_vertInputInfo{};
@@ -59,6 +122,7 @@ private:
 	VkPipelineDynamicStateCreateInfo				m_dynamicStateInfo{};
 
 	bool											m_color_output_disabled{ false };
+	VkPipelineCreateFlags							m_createFlags{};
 
 	// description of attachments to be used by the pipeline
 	VkPipelineRenderingCreateInfo m_renderingInfo{};
@@ -66,5 +130,6 @@ private:
 	VkFormat m_depthAttachmentFormat{};
 
 	VkDevice m_device{};
+	VkPipelineCache m_pipelineCache{};
 };
 #endif // !PIPELINEBUILDER
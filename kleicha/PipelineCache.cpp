@@ -0,0 +1,77 @@
+#include "PipelineCache.h"
+#include "Utils.h"
+
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+
+bool PipelineCache::init(VkDevice device, const VkPhysicalDeviceProperties& deviceProperties, const std::string& path) {
+	m_device = device;
+	m_deviceProperties = deviceProperties;
+	m_path = path;
+
+	std::vector<char> data{};
+	std::ifstream ifstrm{ path, std::ios::binary | std::ios::ate };
+	if (ifstrm.is_open()) {
+		data.resize(static_cast<std::size_t>(ifstrm.tellg()));
+		ifstrm.seekg(0);
+		ifstrm.read(data.data(), static_cast<std::streamsize>(data.size()));
+	}
+
+	bool warm{ !data.empty() && is_valid(data) };
+	if (!data.empty() && !warm)
+		fmt::println("[Kleicha] Ignoring pipeline cache {}, it was written by a different device or driver.", path);
+
+	VkPipelineCacheCreateInfo cacheInfo{ .sType = VK_STRUCTURE_TYPE_PIPELINE_CACHE_CREATE_INFO };
+	cacheInfo.initialDataSize = warm ? data.size() : 0;
+	cacheInfo.pInitialData = warm ? data.data() : nullptr;
+	VK_CHECK(vkCreatePipelineCache(m_device, &cacheInfo, nullptr, &m_cache));
+
+	return warm;
+}
+
+void PipelineCache::save() const {
+	std::size_t size{};
+	VK_CHECK(vkGetPipelineCacheData(m_device, m_cache, &size, nullptr));
+	std::vector<char> data(size);
+	VK_CHECK(vkGetPipelineCacheData(m_device, m_cache, &size, data.data()));
+
+	std::string tempPath{ m_path + ".tmp" };
+	{
+		std::ofstream ofstrm{ tempPath, std::ios::binary | std::ios::trunc };
+		if (!ofstrm.is_open()) {
+			fmt::println("[Kleicha] Failed to save pipeline cache to {}.", tempPath);
+			return;
+		}
+		ofstrm.write(data.data(), static_cast<std::streamsize>(size));
+		if (!ofstrm) {
+			fmt::println("[Kleicha] Failed to save pipeline cache to {}.", tempPath);
+			return;
+		}
+	}
+
+	std::error_code error{};
+	std::filesystem::rename(tempPath, m_path, error);
+	if (error)
+		fmt::println("[Kleicha] Failed to replace pipeline cache {}: {}", m_path, error.message());
+	else
+		fmt::println("[Kleicha] Saved {} byte pipeline cache to {}.", size, m_path);
+}
+
+void PipelineCache::destroy() const {
+	vkDestroyPipelineCache(m_device, m_cache, nullptr);
+}
+
+bool PipelineCache::is_valid(const std::vector<char>& data) const {
+	VkPipelineCacheHeaderVersionOne header{};
+	if (data.size() < sizeof(header))
+		return false;
+
+	std::memcpy(&header, data.data(), sizeof(header));
+
+	return header.headerSize >= sizeof(header) &&
+		header.headerVersion == VK_PIPELINE_CACHE_HEADER_VERSION_ONE &&
+		header.vendorID == m_deviceProperties.vendorID &&
+		header.deviceID == m_deviceProperties.deviceID &&
+		std::memcmp(header.pipelineCacheUUID, m_deviceProperties.pipelineCacheUUID, VK_UUID_SIZE) == 0;
+}
@@ -0,0 +1,34 @@
+#ifndef PIPELINECACHE_H
+#define PIPELINECACHE_H
+
+#include <vulkan/vulkan.h>
+
+#include <string>
+#include <vector>
+
+// persists a VkPipelineCache across runs. the cache file is only trusted when its header was written by the same vendor,
+// device and driver (pipeline cache uuid), otherwise the pipelines are compiled from scratch and the file is replaced on save.
+class PipelineCache {
+public:
+	// loads the cache file if present and valid, returns true if pipelines will be built from a warm cache
+	bool init(VkDevice device, const VkPhysicalDeviceProperties& deviceProperties, const std::string& path);
+
+	// internally synchronized, any thread may build pipelines against it
+	VkPipelineCache get() const {
+		return m_cache;
+	}
+
+	// writes to a temporary file that then replaces the cache file, a crash mid-write never leaves a truncated cache behind
+	void save() const;
+	void destroy() const;
+
+private:
+	VkDevice m_device{};
+	VkPhysicalDeviceProperties m_deviceProperties{};
+	VkPipelineCache m_cache{};
+	std::string m_path{};
+
+	bool is_valid(const std::vector<char>& data) const;
+};
+
+#endif // !PIPELINECACHE_H
@@ -0,0 +1,179 @@
+#include "PipelineCompiler.h"
+#include "CpuProfiler.h"
+
+#include <algorithm>
+#include <array>
+
+PipelineCompiler::~PipelineCompiler() {
+	stop_workers();
+}
+
+void PipelineCompiler::init(VkDevice device, PipelineCache* pipelineCache, uint32_t threadCount, bool usePipelineLibraries) {
+	m_device = device;
+	m_pipelineCache = pipelineCache;
+	m_bStopping = false;
+	m_bUsePipelineLibraries = usePipelineLibraries;
+
+	for (uint32_t i{ 0 }; i < std::max(threadCount, 1u); ++i)
+		m_workers.emplace_back(&PipelineCompiler::worker_loop, this);
+}
+
+std::shared_future<VkPipeline> PipelineCompiler::compile(PipelineDescription description) {
+	std::packaged_task<VkPipeline(VkPipelineCache)> job{ [device = m_device, description = std::move(description)](VkPipelineCache pipelineCache) {
+		return description.compile(device, pipelineCache);
+	} };
+
+	return enqueue(std::move(job));
+}
+
+AsyncPipeline PipelineCompiler::link(const PipelineDescription& description) {
+	static constexpr VkGraphicsPipelineLibraryFlagsEXT parts[]{
+		VK_GRAPHICS_PIPELINE_LIBRARY_VERTEX_INPUT_INTERFACE_BIT_EXT,
+		VK_GRAPHICS_PIPELINE_LIBRARY_PRE_RASTERIZATION_SHADERS_BIT_EXT,
+		VK_GRAPHICS_PIPELINE_LIBRARY_FRAGMENT_SHADER_BIT_EXT,
+		VK_GRAPHICS_PIPELINE_LIBRARY_FRAGMENT_OUTPUT_INTERFACE_BIT_EXT
+	};
+
+	// queue every missing part before waiting on any of them so that they compile in parallel
+	std::array<std::shared_future<VkPipeline>, std::size(parts)> libraryFutures{};
+	for (std::size_t i{ 0 }; i < std::size(parts); ++i) {
+		uint64_t key{ description.library_key(parts[i]) };
+		auto library{ m_libraries.find(key) };
+		if (library == m_libraries.end()) {
+			std::packaged_task<VkPipeline(VkPipelineCache)> job{ [device = m_device, description, part = parts[i]](VkPipelineCache pipelineCache) {
+				return description.compile_library(device, pipelineCache, part);
+			} };
+			library = m_libraries.emplace(key, enqueue(std::move(job))).first;
+		}
+		libraryFutures[i] = library->second;
+	}
+
+	std::array<VkPipeline, std::size(parts)> libraries{};
+	for (std::size_t i{ 0 }; i < std::size(parts); ++i)
+		libraries[i] = libraryFutures[i].get();
+
+	// a fast link only stitches the already compiled parts together, cheap enough to do right here
+	VkPipeline linked{ description.link(m_device, m_pipelineCache->get(), libraries, false) };
+
+	std::packaged_task<VkPipeline(VkPipelineCache)> job{ [device = m_device, description, libraries](VkPipelineCache pipelineCache) {
+		return description.link(device, pipelineCache, libraries, true);
+	} };
+
+	return AsyncPipeline{ linked, enqueue(std::move(job)) };
+}
+
+void PipelineCompiler::shutdown() {
+	stop_workers();
+}
+
+void PipelineCompiler::destroy_libraries() {
+	for (const auto& [key, library] : m_libraries) {
+		if (!library.valid())
+			continue;
+
+		try {
+			vkDestroyPipeline(m_device, library.get(), nullptr);
+		}
+		catch (const std::exception&) {
+			// the library failed to compile, there is nothing to destroy
+		}
+	}
+
+	m_libraries.clear();
+}
+
+std::shared_future<VkPipeline> PipelineCompiler::enqueue(std::packaged_task<VkPipeline(VkPipelineCache)> job) {
+	std::shared_future<VkPipeline> future{ job.get_future().share() };
+
+	{
+		std::lock_guard<std::mutex> lock{ m_jobMutex };
+		m_jobs.push_back(std::move(job));
+	}
+	m_jobAvailable.notify_one();
+
+	return future;
+}
+
+void PipelineCompiler::stop_workers() {
+	{
+		std::lock_guard<std::mutex> lock{ m_jobMutex };
+		m_bStopping = true;
+	}
+	m_jobAvailable.notify_all();
+
+	for (auto& worker : m_workers)
+		worker.join();
+
+	m_workers.clear();
+}
+
+void PipelineCompiler::worker_loop() {
+	CpuProfiler::set_thread_name("pipeline_compiler");
+	while (true) {
+		std::packaged_task<VkPipeline(VkPipelineCache)> job{};
+		{
+			std::unique_lock<std::mutex> lock{ m_jobMutex };
+			m_jobAvailable.wait(lock, [this] { return m_bStopping || !m_jobs.empty(); });
+
+			// queued jobs are still compiled when stopping, their futures may be waited on
+			if (m_jobs.empty())
+				return;
+
+			job = std::move(m_jobs.front());
+			m_jobs.pop_front();
+		}
+
+		// a job that throws stores the exception in its future
+		PROFILE_ZONE("compile_pipeline");
+		job(m_pipelineCache->get());
+	}
+}
+
+VkPipeline AsyncPipeline::get() {
+	if (!m_future.valid() && m_compiler)
+		m_future = m_compiler->compile(m_description);
+
+	if (has_compiled())
+		return m_future.get();
+
+	return m_linked ? m_linked : m_fallback;
+}
+
+VkPipeline AsyncPipeline::take_replaced() {
+	if (!m_linked || !has_compiled())
+		return VK_NULL_HANDLE;
+
+	VkPipeline linked{ m_linked };
+	m_linked = VK_NULL_HANDLE;
+	return linked;
+}
+
+void AsyncPipeline::destroy(VkDevice device) const {
+	if (m_linked)
+		vkDestroyPipeline(device, m_linked, nullptr);
+
+	if (!m_future.valid())
+		return;
+
+	try {
+		vkDestroyPipeline(device, m_future.get(), nullptr);
+	}
+	catch (const std::exception&) {
+		// the compilation failed, no pipeline was created
+	}
+}
+
+bool AsyncPipeline::has_compiled() {
+	if (m_bFailed || !is_ready())
+		return false;
+
+	try {
+		m_future.get();
+		return true;
+	}
+	catch (const std::exception& e) {
+		fmt::println("[Kleicha] Pipeline compilation failed, keeping the {} pipeline: {}", m_linked ? "fast-linked" : "fallback", e.what());
+		m_bFailed = true;
+		return false;
+	}
+}
@@ -0,0 +1,109 @@
+#ifndef PIPELINECOMPILER_H
+#define PIPELINECOMPILER_H
+
+#include <vulkan/vulkan.h>
+
+#include <condition_variable>
+#include <deque>
+#include <future>
+#include <mutex>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+
+#include "PipelineBuilder.h"
+#include "PipelineCache.h"
+
+class AsyncPipeline;
+
+// compiles pipeline descriptions on a pool of worker threads. the workers all build against the shared pipeline cache, so
+// pipelines loaded from disk are hit no matter which thread compiles them.
+class PipelineCompiler {
+public:
+	PipelineCompiler() = default;
+	PipelineCompiler(const PipelineCompiler&) = delete;
+	PipelineCompiler& operator=(const PipelineCompiler&) = delete;
+	// joins the workers if shutdown was never reached, e.g. when init threw
+	~PipelineCompiler();
+
+	void init(VkDevice device, PipelineCache* pipelineCache, uint32_t threadCount, bool usePipelineLibraries);
+
+	// the future throws if compilation failed
+	std::shared_future<VkPipeline> compile(PipelineDescription description);
+
+	// requires VK_EXT_graphics_pipeline_library. compiles the parts of the description that no earlier link has already
+	// compiled, fast-links them on the calling thread and queues a link time optimized pipeline that replaces the fast-linked
+	// one once ready. parts are shared between descriptions by their library key, only call this from one thread.
+	AsyncPipeline link(const PipelineDescription& description);
+
+	bool uses_pipeline_libraries() const {
+		return m_bUsePipelineLibraries;
+	}
+
+	// finishes the queued work and joins the workers
+	void shutdown();
+	// the libraries must outlive every pipeline linked from them
+	void destroy_libraries();
+
+	uint32_t get_thread_count() const {
+		return static_cast<uint32_t>(m_workers.size());
+	}
+
+private:
+	VkDevice m_device{};
+	PipelineCache* m_pipelineCache{};
+
+	std::vector<std::thread> m_workers{};
+
+	std::deque<std::packaged_task<VkPipeline(VkPipelineCache)>> m_jobs{};
+	std::mutex m_jobMutex{};
+	std::condition_variable m_jobAvailable{};
+	bool m_bStopping{ false };
+
+	bool m_bUsePipelineLibraries{ false };
+	std::unordered_map<uint64_t, std::shared_future<VkPipeline>> m_libraries{};
+
+	std::shared_future<VkPipeline> enqueue(std::packaged_task<VkPipeline(VkPipelineCache)> job);
+	void worker_loop();
+	void stop_workers();
+};
+
+// a pipeline that is only compiled once it is first asked for. until it's ready the fallback is handed out instead,
+// so switching to it never stalls a frame. a pipeline built from libraries hands out its fast-linked pipeline until the
+// optimized one is ready. a compilation that fails is logged once and the fallback or fast-linked pipeline is kept for good.
+class AsyncPipeline {
+public:
+	AsyncPipeline() = default;
+	AsyncPipeline(PipelineCompiler* compiler, PipelineDescription description, VkPipeline fallback)
+		: m_compiler{ compiler }, m_description{ std::move(description) }, m_fallback{ fallback }
+	{}
+	AsyncPipeline(VkPipeline linked, std::shared_future<VkPipeline> optimized)
+		: m_linked{ linked }, m_future{ std::move(optimized) }
+	{}
+
+	VkPipeline get();
+
+	bool is_ready() const {
+		return m_future.valid() && m_future.wait_for(std::chrono::seconds{ 0 }) == std::future_status::ready;
+	}
+
+	// once the optimized pipeline is ready the fast-linked one is handed over to be destroyed after the frames using it
+	// complete, null until then and afterwards
+	VkPipeline take_replaced();
+
+	// waits for a compilation in flight before destroying its pipeline, a failed one left nothing to destroy
+	void destroy(VkDevice device) const;
+
+private:
+	PipelineCompiler* m_compiler{};
+	PipelineDescription m_description{};
+	VkPipeline m_fallback{};
+	VkPipeline m_linked{};
+	std::shared_future<VkPipeline> m_future{};
+	bool m_bFailed{ false };
+
+	// true once the compilation has finished without throwing
+	bool has_compiled();
+};
+
+#endif // !PIPELINECOMPILER_H
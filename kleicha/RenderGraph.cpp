@@ -0,0 +1,370 @@
+#include "RenderGraph.h"
+#include "Initializers.h"
+#include "Utils.h"
+
+#include <algorithm>
+#include <cassert>
+#include <numeric>
+
+namespace {
+	struct AccessInfo {
+		VkImageLayout m_layout{};
+		VkPipelineStageFlags2 m_stages{};
+		VkAccessFlags2 m_access{};
+		// the subset of m_access that writes
+		VkAccessFlags2 m_writeAccess{};
+	};
+
+	AccessInfo get_access_info(RenderGraph::Access access, VkImageAspectFlags aspect) {
+		switch (access) {
+		case RenderGraph::Access::COLOR_ATTACHMENT:
+			return AccessInfo{ VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL, VK_PIPELINE_STAGE_2_COLOR_ATTACHMENT_OUTPUT_BIT,
+				VK_ACCESS_2_COLOR_ATTACHMENT_READ_BIT | VK_ACCESS_2_COLOR_ATTACHMENT_WRITE_BIT, VK_ACCESS_2_COLOR_ATTACHMENT_WRITE_BIT };
+		case RenderGraph::Access::DEPTH_ATTACHMENT:
+			return AccessInfo{ VK_IMAGE_LAYOUT_DEPTH_ATTACHMENT_OPTIMAL, VK_PIPELINE_STAGE_2_EARLY_FRAGMENT_TESTS_BIT | VK_PIPELINE_STAGE_2_LATE_FRAGMENT_TESTS_BIT,
+				VK_ACCESS_2_DEPTH_STENCIL_ATTACHMENT_READ_BIT | VK_ACCESS_2_DEPTH_STENCIL_ATTACHMENT_WRITE_BIT, VK_ACCESS_2_DEPTH_STENCIL_ATTACHMENT_WRITE_BIT };
+		case RenderGraph::Access::SAMPLED:
+			return AccessInfo{ (aspect & VK_IMAGE_ASPECT_DEPTH_BIT) ? VK_IMAGE_LAYOUT_DEPTH_READ_ONLY_OPTIMAL : VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL,
+				VK_PIPELINE_STAGE_2_FRAGMENT_SHADER_BIT, VK_ACCESS_2_SHADER_SAMPLED_READ_BIT, VK_ACCESS_2_NONE };
+		case RenderGraph::Access::TRANSFER_SRC:
+			return AccessInfo{ VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL, VK_PIPELINE_STAGE_2_BLIT_BIT, VK_ACCESS_2_TRANSFER_READ_BIT, VK_ACCESS_2_NONE };
+		case RenderGraph::Access::TRANSFER_DST:
+			return AccessInfo{ VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, VK_PIPELINE_STAGE_2_BLIT_BIT, VK_ACCESS_2_TRANSFER_WRITE_BIT, VK_ACCESS_2_TRANSFER_WRITE_BIT };
+		}
+		return AccessInfo{};
+	}
+}
+
+RenderGraph::Pass& RenderGraph::Pass::read(Resource resource, Access access) {
+	m_accesses.push_back(ResourceAccess{ .m_resource = resource, .m_access = access, .m_bWrite = false });
+	return *this;
+}
+
+RenderGraph::Pass& RenderGraph::Pass::write(Resource resource, Access access) {
+	assert(access != Access::SAMPLED && access != Access::TRANSFER_SRC);
+	m_accesses.push_back(ResourceAccess{ .m_resource = resource, .m_access = access, .m_bWrite = true });
+	return *this;
+}
+
+void RenderGraph::init(VkDevice device, VmaAllocator allocator, MemoryTracker* memoryTracker, DeletionQueue* deletionQueue) {
+	m_device = device;
+	m_allocator = allocator;
+	m_memoryTracker = memoryTracker;
+	m_deletionQueue = deletionQueue;
+
+	// tiled gpus only commit lazily allocated memory for the tiles they have to spill, desktop gpus don't have any
+	VmaAllocationCreateInfo lazyInfo{};
+	lazyInfo.requiredFlags = VK_MEMORY_PROPERTY_LAZILY_ALLOCATED_BIT;
+	uint32_t memoryTypeIndex{};
+	m_bLazyMemory = vmaFindMemoryTypeIndex(m_allocator, UINT32_MAX, &lazyInfo, &memoryTypeIndex) == VK_SUCCESS;
+	fmt::println("[RenderGraph] Lazily allocated memory is {}.", m_bLazyMemory ? "supported" : "unsupported");
+}
+
+void RenderGraph::destroy() {
+	for (const auto& transient : m_transientImages) {
+		vkDestroyImageView(m_device, transient.m_image.imageView, nullptr);
+		m_memoryTracker->destroy(transient.m_image);
+	}
+	for (const auto& block : m_blocks)
+		m_memoryTracker->free(block.m_allocation);
+
+	m_transientImages.clear();
+	m_blocks.clear();
+	m_cachedRequirements.clear();
+	m_memoryStats = MemoryStats{};
+}
+
+void RenderGraph::begin_frame(uint32_t frameNumber) {
+	m_uiFrameNumber = frameNumber;
+	m_resources.clear();
+	m_passes.clear();
+}
+
+RenderGraph::Resource RenderGraph::import_image(const char* name, VkImage image, VkImageView imageView, VkImageAspectFlags aspect, const ImageState& initialState,
+	VkImageLayout finalLayout, VkPipelineStageFlags2 finalStages, VkAccessFlags2 finalAccess) {
+
+	m_resources.push_back(ResourceEntry{ .m_name = name, .m_image = image, .m_imageView = imageView, .m_aspect = aspect, .m_state = initialState,
+		.m_bImported = true, .m_finalLayout = finalLayout, .m_finalStages = finalStages, .m_finalAccess = finalAccess });
+	return static_cast<Resource>(m_resources.size() - 1);
+}
+
+RenderGraph::Resource RenderGraph::create_image(const char* name, const ImageDescription& description) {
+	m_resources.push_back(ResourceEntry{ .m_name = name, .m_aspect = description.m_aspect, .m_description = description });
+	return static_cast<Resource>(m_resources.size() - 1);
+}
+
+void RenderGraph::mark_output(Resource resource) {
+	m_resources[resource].m_bOutput = true;
+}
+
+RenderGraph::Pass& RenderGraph::add_pass(const char* name, std::function<void(VkCommandBuffer)> record, bool collectStatistics) {
+	Pass& pass{ m_passes.emplace_back() };
+	pass.m_name = name;
+	pass.m_bCollectStatistics = collectStatistics;
+	pass.m_record = std::move(record);
+	return pass;
+}
+
+VkImage RenderGraph::get_image(Resource resource) const {
+	return m_resources[resource].m_image;
+}
+
+VkImageView RenderGraph::get_image_view(Resource resource) const {
+	return m_resources[resource].m_imageView;
+}
+
+void RenderGraph::cull_passes() {
+	// walks the passes backwards, a pass is kept if it writes something that's an output or used by a pass kept after it.
+	// attachments may be loaded, so earlier writers of a resource a kept pass writes are kept as well.
+	std::vector<bool> needed(m_resources.size());
+	for (std::size_t i{ 0 }; i < m_resources.size(); ++i)
+		needed[i] = m_resources[i].m_bOutput;
+
+	m_uiCulledPasses = 0;
+	for (std::size_t i{ m_passes.size() }; i-- > 0;) {
+		Pass& pass{ m_passes[i] };
+		pass.m_bCulled = std::none_of(pass.m_accesses.begin(), pass.m_accesses.end(), [&](const Pass::ResourceAccess& access) {
+			return access.m_bWrite && needed[access.m_resource];
+			});
+
+		if (pass.m_bCulled) {
+			++m_uiCulledPasses;
+			continue;
+		}
+
+		for (const auto& access : pass.m_accesses)
+			needed[access.m_resource] = true;
+	}
+}
+
+void RenderGraph::allocate_transient_images() {
+	// lifetimes of the transient images in kept passes
+	std::vector<uint32_t> firstUse(m_resources.size(), UINT32_MAX);
+	std::vector<uint32_t> lastUse(m_resources.size(), 0);
+	for (uint32_t i{ 0 }; i < m_passes.size(); ++i) {
+		if (m_passes[i].m_bCulled)
+			continue;
+
+		for (const auto& access : m_passes[i].m_accesses) {
+			firstUse[access.m_resource] = std::min(firstUse[access.m_resource], i);
+			lastUse[access.m_resource] = std::max(lastUse[access.m_resource], i);
+		}
+	}
+
+	std::vector<Resource> transients{};
+	for (Resource i{ 0 }; i < m_resources.size(); ++i) {
+		if (!m_resources[i].m_bImported && firstUse[i] != UINT32_MAX)
+			transients.push_back(i);
+	}
+	std::stable_sort(transients.begin(), transients.end(), [&](Resource a, Resource b) { return firstUse[a] < firstUse[b]; });
+
+	// each image goes into the first block whose images are all done with before it's first used and that has a memory type
+	// in common with it, otherwise into a new block. blocks grow to fit the largest image placed in them. lazily allocated
+	// blocks only hold images whose contents never leave the tile memory, so they aren't shared with the others.
+	struct PlannedBlock {
+		VkMemoryRequirements m_requirements{};
+		uint32_t m_uiLastUse{};
+		bool m_bLazy{};
+	};
+	std::vector<PlannedBlock> plannedBlocks{};
+	std::vector<TransientImage> plannedImages{};
+	VkDeviceSize imageBytes{};
+	bool queriedRequirements{ false };
+	for (Resource resource : transients) {
+		const ImageDescription& description{ m_resources[resource].m_description };
+		bool lazy{ m_bLazyMemory && (description.m_usage & VK_IMAGE_USAGE_TRANSIENT_ATTACHMENT_BIT) };
+		VkMemoryRequirements requirements{ get_memory_requirements(description, queriedRequirements) };
+		imageBytes += requirements.size;
+
+		auto block{ std::find_if(plannedBlocks.begin(), plannedBlocks.end(), [&](const PlannedBlock& planned) {
+			return planned.m_uiLastUse < firstUse[resource] && planned.m_bLazy == lazy && (planned.m_requirements.memoryTypeBits & requirements.memoryTypeBits) != 0;
+			}) };
+
+		if (block == plannedBlocks.end()) {
+			plannedBlocks.push_back(PlannedBlock{ .m_requirements = requirements, .m_uiLastUse = lastUse[resource], .m_bLazy = lazy });
+			block = plannedBlocks.end() - 1;
+		}
+		else {
+			block->m_requirements.size = std::max(block->m_requirements.size, requirements.size);
+			block->m_requirements.alignment = std::max(block->m_requirements.alignment, requirements.alignment);
+			block->m_requirements.memoryTypeBits &= requirements.memoryTypeBits;
+			block->m_uiLastUse = lastUse[resource];
+		}
+
+		plannedImages.push_back(TransientImage{ .m_description = description, .m_uiBlock = static_cast<uint32_t>(block - plannedBlocks.begin()) });
+	}
+
+	// a description changed, the requirements of the ones it replaced won't be asked for again
+	if (queriedRequirements)
+		std::erase_if(m_cachedRequirements, [&](const CachedRequirements& cached) { return cached.m_uiLastUse != m_uiFrameNumber; });
+
+	// the images of the last plan are reused when the plan hasn't changed
+	bool samePlan{ plannedImages.size() == m_transientImages.size() && plannedBlocks.size() == m_blocks.size() };
+	for (std::size_t i{ 0 }; samePlan && i < plannedImages.size(); ++i)
+		samePlan = plannedImages[i].m_description == m_transientImages[i].m_description && plannedImages[i].m_uiBlock == m_transientImages[i].m_uiBlock;
+	for (std::size_t i{ 0 }; samePlan && i < plannedBlocks.size(); ++i)
+		samePlan = plannedBlocks[i].m_requirements.size == m_blocks[i].m_size && plannedBlocks[i].m_requirements.memoryTypeBits == m_blocks[i].m_uiMemoryTypeBits &&
+			plannedBlocks[i].m_bLazy == m_blocks[i].m_bLazy;
+
+	if (!samePlan) {
+		retire_transient_images();
+
+		for (const auto& planned : plannedBlocks) {
+			VmaAllocationCreateInfo allocationInfo{};
+			allocationInfo.requiredFlags = planned.m_bLazy ? VK_MEMORY_PROPERTY_LAZILY_ALLOCATED_BIT : VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT;
+			// commitment is queried per VkDeviceMemory, so lazy blocks don't share one with anything else
+			if (planned.m_bLazy)
+				allocationInfo.flags = VMA_ALLOCATION_CREATE_DEDICATED_MEMORY_BIT;
+
+			MemoryBlock block{ .m_size = planned.m_requirements.size, .m_alignment = planned.m_requirements.alignment,
+				.m_uiMemoryTypeBits = planned.m_requirements.memoryTypeBits, .m_bLazy = planned.m_bLazy };
+			VK_CHECK(vmaAllocateMemory(m_allocator, &planned.m_requirements, &allocationInfo, &block.m_allocation, nullptr));
+			m_memoryTracker->track(block.m_allocation, MemoryTracker::RENDER_TARGETS, planned.m_bLazy ? "transient_lazy" : "transient");
+			m_blocks.push_back(block);
+		}
+
+		for (auto& planned : plannedImages) {
+			const ImageDescription& description{ planned.m_description };
+			VkImageCreateInfo imageInfo{ init::create_image_info(description.m_format, description.m_extent, description.m_usage, 1) };
+			VK_CHECK(vkCreateImage(m_device, &imageInfo, nullptr, &planned.m_image.image));
+			VK_CHECK(vmaBindImageMemory(m_allocator, m_blocks[planned.m_uiBlock].m_allocation, planned.m_image.image));
+
+			VkImageViewCreateInfo viewInfo{ init::create_image_view_info(planned.m_image.image, description.m_format, description.m_aspect, 1) };
+			VK_CHECK(vkCreateImageView(m_device, &viewInfo, nullptr, &planned.m_image.imageView));
+		}
+		m_transientImages = std::move(plannedImages);
+
+		m_memoryStats.m_imageBytes = imageBytes;
+		m_memoryStats.m_blockBytes = std::accumulate(m_blocks.begin(), m_blocks.end(), VkDeviceSize{}, [](VkDeviceSize sum, const MemoryBlock& block) { return sum + block.m_size; });
+		m_memoryStats.m_lazyBytes = std::accumulate(m_blocks.begin(), m_blocks.end(), VkDeviceSize{}, [](VkDeviceSize sum, const MemoryBlock& block) { return sum + (block.m_bLazy ? block.m_size : 0); });
+		constexpr double MIB{ 1024.0 * 1024.0 };
+		fmt::println("[RenderGraph] Placed {} transient images in {} memory blocks, {:.2f} MiB instead of {:.2f} MiB in dedicated allocations, {:.2f} MiB of it lazily allocated.",
+			m_transientImages.size(), m_blocks.size(), static_cast<double>(m_memoryStats.m_blockBytes) / MIB, static_cast<double>(m_memoryStats.m_imageBytes) / MIB,
+			static_cast<double>(m_memoryStats.m_lazyBytes) / MIB);
+	}
+
+	for (std::size_t i{ 0 }; i < transients.size(); ++i) {
+		ResourceEntry& resource{ m_resources[transients[i]] };
+		resource.m_uiTransient = static_cast<uint32_t>(i);
+		resource.m_image = m_transientImages[i].m_image.image;
+		resource.m_imageView = m_transientImages[i].m_image.imageView;
+	}
+}
+
+VkDeviceSize RenderGraph::get_committed_lazy_bytes() const {
+	VkDeviceSize committed{};
+	for (const auto& block : m_blocks) {
+		if (!block.m_bLazy)
+			continue;
+
+		VmaAllocationInfo allocationInfo{};
+		vmaGetAllocationInfo(m_allocator, block.m_allocation, &allocationInfo);
+		VkDeviceSize blockCommitted{};
+		vkGetDeviceMemoryCommitment(m_device, allocationInfo.deviceMemory, &blockCommitted);
+		committed += blockCommitted;
+	}
+	return committed;
+}
+
+void RenderGraph::retire_transient_images() {
+	// frames still in flight may use them, the images are queued ahead of the memory they're bound to
+	for (const auto& transient : m_transientImages)
+		m_deletionQueue->push(m_uiFrameNumber, transient.m_image);
+	for (const auto& block : m_blocks)
+		m_deletionQueue->push(m_uiFrameNumber, block.m_allocation);
+
+	m_transientImages.clear();
+	m_blocks.clear();
+}
+
+VkMemoryRequirements RenderGraph::get_memory_requirements(const ImageDescription& description, bool& queried) {
+	auto cached{ std::find_if(m_cachedRequirements.begin(), m_cachedRequirements.end(), [&](const CachedRequirements& entry) {
+		return entry.m_description == description;
+		}) };
+	if (cached != m_cachedRequirements.end()) {
+		cached->m_uiLastUse = m_uiFrameNumber;
+		return cached->m_requirements;
+	}
+
+	VkImageCreateInfo imageInfo{ init::create_image_info(description.m_format, description.m_extent, description.m_usage, 1) };
+	VkDeviceImageMemoryRequirements imageRequirements{ .sType = VK_STRUCTURE_TYPE_DEVICE_IMAGE_MEMORY_REQUIREMENTS };
+	imageRequirements.pCreateInfo = &imageInfo;
+	VkMemoryRequirements2 memoryRequirements{ .sType = VK_STRUCTURE_TYPE_MEMORY_REQUIREMENTS_2 };
+	vkGetDeviceImageMemoryRequirements(m_device, &imageRequirements, &memoryRequirements);
+
+	m_cachedRequirements.push_back(CachedRequirements{ .m_description = description, .m_requirements = memoryRequirements.memoryRequirements,
+		.m_uiLastUse = m_uiFrameNumber });
+	queried = true;
+	return memoryRequirements.memoryRequirements;
+}
+
+void RenderGraph::add_barrier(std::vector<VkImageMemoryBarrier2>& barriers, ResourceEntry& resource, const ImageState& state, VkAccessFlags2 dstAccess) const {
+	VkImageMemoryBarrier2 barrier{ init::create_image_barrier_info(resource.m_state.m_stages, resource.m_state.m_writeAccess, state.m_stages, dstAccess,
+		resource.m_state.m_layout, state.m_layout, resource.m_image, 1) };
+	barrier.subresourceRange.aspectMask = resource.m_aspect;
+	barrier.subresourceRange.levelCount = VK_REMAINING_MIP_LEVELS;
+	barriers.push_back(barrier);
+
+	resource.m_state = state;
+}
+
+void RenderGraph::execute(VkCommandBuffer cmdBuffer, GpuProfiler& gpuProfiler) {
+	cull_passes();
+	allocate_transient_images();
+
+	std::vector<VkImageMemoryBarrier2> barriers{};
+	for (const auto& pass : m_passes) {
+		if (pass.m_bCulled)
+			continue;
+
+		barriers.clear();
+		for (const auto& access : pass.m_accesses) {
+			ResourceEntry& resource{ m_resources[access.m_resource] };
+			MemoryBlock* block{ resource.m_uiTransient != UINT32_MAX ? &m_blocks[m_transientImages[resource.m_uiTransient].m_uiBlock] : nullptr };
+
+			// a transient image's contents start out undefined, but it must wait for whatever last used its memory
+			if (block && resource.m_bFirstUse)
+				resource.m_state = ImageState{ .m_layout = VK_IMAGE_LAYOUT_UNDEFINED, .m_stages = block->m_lastStages, .m_writeAccess = block->m_lastWriteAccess };
+			resource.m_bFirstUse = false;
+
+			AccessInfo info{ get_access_info(access.m_access, resource.m_aspect) };
+			// reads in the same layout as the previous reads need no barrier
+			if (resource.m_state.m_layout != info.m_layout || access.m_bWrite || resource.m_state.m_writeAccess != VK_ACCESS_2_NONE)
+				add_barrier(barriers, resource, ImageState{ .m_layout = info.m_layout, .m_stages = info.m_stages, .m_writeAccess = access.m_bWrite ? info.m_writeAccess : VK_ACCESS_2_NONE }, info.m_access);
+			else
+				resource.m_state.m_stages |= info.m_stages;
+
+			if (block) {
+				block->m_lastStages = resource.m_state.m_stages;
+				block->m_lastWriteAccess = resource.m_state.m_writeAccess;
+			}
+		}
+
+		gpuProfiler.begin_scope(cmdBuffer, pass.m_name, pass.m_bCollectStatistics);
+		if (!barriers.empty()) {
+			VkDependencyInfo dependencyInfo{ .sType = VK_STRUCTURE_TYPE_DEPENDENCY_INFO };
+			dependencyInfo.imageMemoryBarrierCount = static_cast<uint32_t>(barriers.size());
+			dependencyInfo.pImageMemoryBarriers = barriers.data();
+			vkCmdPipelineBarrier2(cmdBuffer, &dependencyInfo);
+		}
+		pass.m_record(cmdBuffer);
+		gpuProfiler.end_scope(cmdBuffer);
+	}
+
+	// imported images are handed back in the layout their next user expects
+	barriers.clear();
+	for (auto& resource : m_resources) {
+		if (!resource.m_bImported || resource.m_finalLayout == VK_IMAGE_LAYOUT_UNDEFINED)
+			continue;
+
+		if (resource.m_state.m_layout != resource.m_finalLayout || resource.m_state.m_writeAccess != VK_ACCESS_2_NONE)
+			add_barrier(barriers, resource, ImageState{ .m_layout = resource.m_finalLayout, .m_stages = resource.m_finalStages }, resource.m_finalAccess);
+	}
+
+	if (!barriers.empty()) {
+		VkDependencyInfo dependencyInfo{ .sType = VK_STRUCTURE_TYPE_DEPENDENCY_INFO };
+		dependencyInfo.imageMemoryBarrierCount = static_cast<uint32_t>(barriers.size());
+		dependencyInfo.pImageMemoryBarriers = barriers.data();
+		vkCmdPipelineBarrier2(cmdBuffer, &dependencyInfo);
+	}
+}
@@ -0,0 +1,188 @@
+#ifndef RENDERGRAPH_H
+#define RENDERGRAPH_H
+
+#include "Types.h"
+#include "vk_mem_alloc.h"
+#include "MemoryTracker.h"
+#include "DeletionQueue.h"
+#include "GpuProfiler.h"
+
+#include <functional>
+#include <vector>
+
+// a small frame graph rebuilt every frame. passes declare the images they read and write, the graph culls the passes whose
+// writes nothing consumes, derives the barriers between passes from the declared accesses and batches them per pass.
+// imported images are owned by the caller, transient images are owned by the graph: images whose lifetimes don't overlap
+// share memory, and they're only recreated when the frame's transient images change, e.g. on a resize. transient images
+// created with VK_IMAGE_USAGE_TRANSIENT_ATTACHMENT_BIT are placed in lazily allocated memory where the device has it.
+class RenderGraph {
+public:
+	using Resource = uint32_t;
+
+	enum class Access {
+		COLOR_ATTACHMENT,
+		DEPTH_ATTACHMENT,
+		SAMPLED,
+		TRANSFER_SRC,
+		TRANSFER_DST
+	};
+
+	// how an imported image was last used before the graph's first access, or how it's left afterwards
+	struct ImageState {
+		VkImageLayout m_layout{ VK_IMAGE_LAYOUT_UNDEFINED };
+		VkPipelineStageFlags2 m_stages{ VK_PIPELINE_STAGE_2_NONE };
+		// writes not yet made available
+		VkAccessFlags2 m_writeAccess{ VK_ACCESS_2_NONE };
+	};
+
+	struct ImageDescription {
+		VkFormat m_format{};
+		VkExtent2D m_extent{};
+		VkImageUsageFlags m_usage{};
+		VkImageAspectFlags m_aspect{};
+
+		bool operator==(const ImageDescription& other) const {
+			return m_format == other.m_format && m_extent.width == other.m_extent.width && m_extent.height == other.m_extent.height &&
+				m_usage == other.m_usage && m_aspect == other.m_aspect;
+		}
+	};
+
+	struct MemoryStats {
+		// what the transient images would take in dedicated allocations
+		VkDeviceSize m_imageBytes{};
+		// what their memory blocks take, lazily allocated blocks included
+		VkDeviceSize m_blockBytes{};
+		VkDeviceSize m_lazyBytes{};
+	};
+
+	class Pass {
+	public:
+		Pass& read(Resource resource, Access access);
+		Pass& write(Resource resource, Access access);
+
+	private:
+		friend class RenderGraph;
+
+		struct ResourceAccess {
+			Resource m_resource{};
+			Access m_access{};
+			bool m_bWrite{};
+		};
+
+		const char* m_name{};
+		bool m_bCollectStatistics{};
+		std::function<void(VkCommandBuffer)> m_record{};
+		std::vector<ResourceAccess> m_accesses{};
+		bool m_bCulled{};
+	};
+
+	void init(VkDevice device, VmaAllocator allocator, MemoryTracker* memoryTracker, DeletionQueue* deletionQueue);
+	// destroys the transient images, only once the device is idle
+	void destroy();
+
+	// starts building the graph of the given frame, resources and passes of the previous frame are dropped
+	void begin_frame(uint32_t frameNumber);
+
+	// finalLayout is the layout the image is left in for whatever uses it after the graph, finalStages and finalAccess describe
+	// that use. an undefined final layout leaves the image as the last pass used it.
+	Resource import_image(const char* name, VkImage image, VkImageView imageView, VkImageAspectFlags aspect, const ImageState& initialState,
+		VkImageLayout finalLayout = VK_IMAGE_LAYOUT_UNDEFINED, VkPipelineStageFlags2 finalStages = VK_PIPELINE_STAGE_2_NONE, VkAccessFlags2 finalAccess = VK_ACCESS_2_NONE);
+	// contents don't survive the frame
+	Resource create_image(const char* name, const ImageDescription& description);
+	// passes writing an output are never culled. imported images that outlive the frame should be marked as outputs.
+	void mark_output(Resource resource);
+
+	// the reference is only valid until the next pass is added. passes run in the order they're added.
+	Pass& add_pass(const char* name, std::function<void(VkCommandBuffer)> record, bool collectStatistics = false);
+
+	// only valid while the frame's graph is executed
+	VkImage get_image(Resource resource) const;
+	VkImageView get_image_view(Resource resource) const;
+
+	// creates the transient images if needed and records every pass that isn't culled, each within its own profiler scope
+	void execute(VkCommandBuffer cmdBuffer, GpuProfiler& gpuProfiler);
+
+	uint32_t get_culled_pass_count() const {
+		return m_uiCulledPasses;
+	}
+
+	const MemoryStats& get_memory_stats() const {
+		return m_memoryStats;
+	}
+
+	bool supports_lazy_memory() const {
+		return m_bLazyMemory;
+	}
+
+	// bytes of the lazily allocated blocks the device has actually committed so far
+	VkDeviceSize get_committed_lazy_bytes() const;
+
+private:
+	struct ResourceEntry {
+		const char* m_name{};
+		VkImage m_image{};
+		VkImageView m_imageView{};
+		VkImageAspectFlags m_aspect{};
+		ImageState m_state{};
+		bool m_bOutput{};
+		// imported images only
+		bool m_bImported{};
+		VkImageLayout m_finalLayout{};
+		VkPipelineStageFlags2 m_finalStages{};
+		VkAccessFlags2 m_finalAccess{};
+		// transient images only, the index into m_transientImages
+		ImageDescription m_description{};
+		uint32_t m_uiTransient{ UINT32_MAX };
+		bool m_bFirstUse{ true };
+	};
+
+	// memory requirements only depend on the description, so they're only queried again once a resize changes it
+	struct CachedRequirements {
+		ImageDescription m_description{};
+		VkMemoryRequirements m_requirements{};
+		uint32_t m_uiLastUse{};
+	};
+
+	struct TransientImage {
+		ImageDescription m_description{};
+		uint32_t m_uiBlock{};
+		vkt::Image m_image{};
+	};
+
+	// memory shared by transient images with disjoint lifetimes. the state of its last access carries over to the next image
+	// placed in it, even across frames.
+	struct MemoryBlock {
+		VkDeviceSize m_size{};
+		VkDeviceSize m_alignment{};
+		uint32_t m_uiMemoryTypeBits{};
+		bool m_bLazy{};
+		VmaAllocation m_allocation{};
+		VkPipelineStageFlags2 m_lastStages{ VK_PIPELINE_STAGE_2_NONE };
+		VkAccessFlags2 m_lastWriteAccess{ VK_ACCESS_2_NONE };
+	};
+
+	VkDevice m_device{};
+	VmaAllocator m_allocator{};
+	MemoryTracker* m_memoryTracker{};
+	DeletionQueue* m_deletionQueue{};
+	bool m_bLazyMemory{};
+
+	uint32_t m_uiFrameNumber{};
+	std::vector<ResourceEntry> m_resources{};
+	std::vector<Pass> m_passes{};
+	uint32_t m_uiCulledPasses{};
+
+	std::vector<TransientImage> m_transientImages{};
+	std::vector<MemoryBlock> m_blocks{};
+	std::vector<CachedRequirements> m_cachedRequirements{};
+	MemoryStats m_memoryStats{};
+
+	void cull_passes();
+	void allocate_transient_images();
+	// returns true in queried if the requirements weren't cached yet
+	VkMemoryRequirements get_memory_requirements(const ImageDescription& description, bool& queried);
+	void retire_transient_images();
+	void add_barrier(std::vector<VkImageMemoryBarrier2>& barriers, ResourceEntry& resource, const ImageState& state, VkAccessFlags2 dstAccess) const;
+};
+
+#endif // !RENDERGRAPH_H
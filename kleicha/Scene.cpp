@@ -44,7 +44,10 @@ void Scene::load_scene_node(aiNode* pNode, const aiScene* pScene, std::vector<vk
         drawData.m_uiMaterialIndex = pScene->mMeshes[pNode->mMeshes[i]]->mMaterialIndex;
         draws.push_back(drawData);
 
-        hostDraws.push_back(m_canonicalHostDrawData[pNode->mMeshes[i]]);
+        vkt::HostDrawData hostDraw{ m_canonicalHostDrawData[pNode->mMeshes[i]] };
+        hostDraw.m_uiTransformIndex = drawData.m_uiTransformIndex;
+        hostDraw.m_uiMaterialIndex = drawData.m_uiMaterialIndex;
+        hostDraws.push_back(hostDraw);
     }
 
     // for each node, traverse its children
@@ -63,6 +66,16 @@ void Scene::append_mesh(const vkt::Mesh& mesh) {
     hDraw.m_uiIndicesOffset = static_cast<uint32_t>(m_unifiedTriangles.size() * 3);
     hDraw.m_uiIndicesCount = static_cast<uint32_t>(mesh.tInd.size() * 3);
 
+    // object space bounds are later used to cull draws against lights
+    if (!mesh.verts.empty()) {
+        hDraw.m_v3BoundsMin = mesh.verts[0].m_v3Position;
+        hDraw.m_v3BoundsMax = mesh.verts[0].m_v3Position;
+        for (const auto& vert : mesh.verts) {
+            hDraw.m_v3BoundsMin = glm::min(hDraw.m_v3BoundsMin, vert.m_v3Position);
+            hDraw.m_v3BoundsMax = glm::max(hDraw.m_v3BoundsMax, vert.m_v3Position);
+        }
+    }
+
     m_canonicalHostDrawData.push_back(hDraw);
 
     // append mesh to unified vertices and indices
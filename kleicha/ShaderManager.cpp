@@ -0,0 +1,229 @@
+#include "ShaderManager.h"
+#include "Utils.h"
+#include "CpuProfiler.h"
+
+#include <shaderc/shaderc.hpp>
+
+#include <chrono>
+#include <fstream>
+#include <memory>
+#include <sstream>
+
+static void hash_string(uint64_t& hash, const std::string& string) {
+	std::size_t size{ string.size() };
+	utils::hash_bytes(hash, &size, sizeof(size));
+	utils::hash_bytes(hash, string.data(), string.size());
+}
+
+// returns the file name of an #include "file" directive, or an empty string if the line isn't one
+static std::string include_name(const std::string& line) {
+	std::size_t start{ line.find_first_not_of(" \t") };
+	if (start == std::string::npos || line.compare(start, 8, "#include") != 0)
+		return {};
+
+	std::size_t open{ line.find('"', start + 8) };
+	std::size_t close{ open == std::string::npos ? std::string::npos : line.find('"', open + 1) };
+	if (close == std::string::npos)
+		return {};
+
+	return line.substr(open + 1, close - open - 1);
+}
+
+static shaderc_shader_kind shader_kind(const std::string& name) {
+	std::string extension{ std::filesystem::path{ name }.extension().string() };
+	if (extension == ".vert")
+		return shaderc_vertex_shader;
+	if (extension == ".frag")
+		return shaderc_fragment_shader;
+	if (extension == ".tesc")
+		return shaderc_tess_control_shader;
+	if (extension == ".tese")
+		return shaderc_tess_evaluation_shader;
+
+	throw std::runtime_error{ "[Kleicha] Unknown shader stage for " + name };
+}
+
+// resolves #include "file" relative to the shader source directory
+class ShaderIncluder : public shaderc::CompileOptions::IncluderInterface {
+public:
+	explicit ShaderIncluder(std::filesystem::path sourceDir)
+		: m_sourceDir{ std::move(sourceDir) }
+	{}
+
+	shaderc_include_result* GetInclude(const char* requestedSource, [[maybe_unused]] shaderc_include_type type,
+		[[maybe_unused]] const char* requestingSource, [[maybe_unused]] size_t includeDepth) override {
+
+		Include* include{ new Include{} };
+		std::filesystem::path path{ m_sourceDir / requestedSource };
+		std::ifstream ifstrm{ path, std::ios::binary };
+		if (ifstrm.is_open()) {
+			std::stringstream content{};
+			content << ifstrm.rdbuf();
+			include->name = path.string();
+			include->content = content.str();
+		}
+		else {
+			// an empty source name reports the content as the error
+			include->content = "failed to open " + path.string();
+		}
+
+		include->result.source_name = include->name.data();
+		include->result.source_name_length = include->name.size();
+		include->result.content = include->content.data();
+		include->result.content_length = include->content.size();
+		include->result.user_data = include;
+		return &include->result;
+	}
+
+	void ReleaseInclude(shaderc_include_result* data) override {
+		delete static_cast<Include*>(data->user_data);
+	}
+
+private:
+	struct Include {
+		std::string name{};
+		std::string content{};
+		shaderc_include_result result{};
+	};
+
+	std::filesystem::path m_sourceDir{};
+};
+
+void ShaderManager::init(VkDevice device, const std::string& sourceDir, const std::string& cacheDir) {
+	m_device = device;
+	m_sourceDir = sourceDir;
+	m_cacheDir = cacheDir;
+
+	std::error_code error{};
+	std::filesystem::create_directories(m_cacheDir, error);
+	if (error)
+		fmt::println("[Kleicha] Failed to create shader cache directory {}: {}", cacheDir, error.message());
+}
+
+VkShaderModule ShaderManager::get(const std::string& name, const std::vector<std::string>& defines) {
+	std::string source{ read_source(m_sourceDir / name) };
+
+	// the stage is part of the key, the same source compiled as another stage is a different shader
+	uint64_t hash{ utils::HASH_OFFSET_BASIS };
+	utils::hash_bytes(hash, &CACHE_VERSION, sizeof(CACHE_VERSION));
+	shaderc_shader_kind kind{ shader_kind(name) };
+	utils::hash_bytes(hash, &kind, sizeof(kind));
+	hash_string(hash, source);
+	std::unordered_set<std::string> visited{};
+	hash_includes(hash, source, visited);
+	for (const auto& define : defines)
+		hash_string(hash, define);
+
+	auto cachedModule{ m_modules.find(hash) };
+	if (cachedModule != m_modules.end())
+		return cachedModule->second;
+
+	std::filesystem::path cachePath{ m_cacheDir / fmt::format("{:016x}.spv", hash) };
+	std::vector<uint32_t> code{};
+	if (load_cached(cachePath, code)) {
+		++m_cachedCount;
+	}
+	else {
+		auto startTime{ std::chrono::steady_clock::now() };
+		code = compile(name, source, defines);
+		write_cached(cachePath, code);
+		++m_compiledCount;
+
+		std::chrono::duration<double, std::milli> elapsed{ std::chrono::steady_clock::now() - startTime };
+		fmt::println("[Kleicha] Compiled shader {} in {:.2f} ms.", name, elapsed.count());
+	}
+
+	VkShaderModule shaderModule{ utils::create_shader_module(m_device, code) };
+	m_modules.emplace(hash, shaderModule);
+	return shaderModule;
+}
+
+void ShaderManager::destroy() {
+	for (const auto& [hash, shaderModule] : m_modules)
+		vkDestroyShaderModule(m_device, shaderModule, nullptr);
+
+	m_modules.clear();
+}
+
+std::string ShaderManager::read_source(const std::filesystem::path& path) const {
+	std::ifstream ifstrm{ path, std::ios::binary };
+	if (!ifstrm.is_open())
+		throw std::runtime_error{ "[Kleicha] Failed to open shader source: " + path.string() };
+
+	std::stringstream source{};
+	source << ifstrm.rdbuf();
+	return source.str();
+}
+
+// folds the contents of every included file into the hash, a change to common.h invalidates all shaders that include it
+void ShaderManager::hash_includes(uint64_t& hash, const std::string& source, std::unordered_set<std::string>& visited) const {
+	std::istringstream lines{ source };
+	std::string line{};
+	while (std::getline(lines, line)) {
+		std::string include{ include_name(line) };
+		if (include.empty() || !visited.insert(include).second)
+			continue;
+
+		std::string includeSource{ read_source(m_sourceDir / include) };
+		hash_string(hash, include);
+		hash_string(hash, includeSource);
+		hash_includes(hash, includeSource, visited);
+	}
+}
+
+std::vector<uint32_t> ShaderManager::compile(const std::string& name, const std::string& source, const std::vector<std::string>& defines) const {
+	PROFILE_ZONE("compile_shader");
+	shaderc::CompileOptions options{};
+	options.SetTargetEnvironment(shaderc_target_env_vulkan, shaderc_env_version_vulkan_1_3);
+	options.SetGenerateDebugInfo();
+	options.SetIncluder(std::make_unique<ShaderIncluder>(m_sourceDir));
+	for (const auto& define : defines) {
+		std::size_t separator{ define.find('=') };
+		if (separator == std::string::npos)
+			options.AddMacroDefinition(define);
+		else
+			options.AddMacroDefinition(define.substr(0, separator), define.substr(separator + 1));
+	}
+
+	shaderc::Compiler compiler{};
+	shaderc::SpvCompilationResult result{ compiler.CompileGlslToSpv(source, shader_kind(name), name.c_str(), options) };
+	if (result.GetCompilationStatus() != shaderc_compilation_status_success)
+		throw std::runtime_error{ "[Kleicha] Failed to compile shader " + name + ":\n" + result.GetErrorMessage() };
+
+	return { result.cbegin(), result.cend() };
+}
+
+bool ShaderManager::load_cached(const std::filesystem::path& path, std::vector<uint32_t>& code) const {
+	std::ifstream ifstrm{ path, std::ios::binary | std::ios::ate };
+	if (!ifstrm.is_open())
+		return false;
+
+	std::size_t size{ static_cast<std::size_t>(ifstrm.tellg()) };
+	if (size == 0 || size % sizeof(uint32_t) != 0)
+		return false;
+
+	code.resize(size / sizeof(uint32_t));
+	ifstrm.seekg(0);
+	ifstrm.read(reinterpret_cast<char*>(code.data()), static_cast<std::streamsize>(size));
+
+	// a truncated or foreign file is recompiled and overwritten
+	constexpr uint32_t SPIRV_MAGIC{ 0x07230203 };
+	return ifstrm && code[0] == SPIRV_MAGIC;
+}
+
+void ShaderManager::write_cached(const std::filesystem::path& path, const std::vector<uint32_t>& code) const {
+	std::filesystem::path tempPath{ path.string() + ".tmp" };
+	{
+		std::ofstream ofstrm{ tempPath, std::ios::binary | std::ios::trunc };
+		ofstrm.write(reinterpret_cast<const char*>(code.data()), static_cast<std::streamsize>(code.size() * sizeof(uint32_t)));
+		if (!ofstrm) {
+			fmt::println("[Kleicha] Failed to write shader cache file {}.", tempPath.string());
+			return;
+		}
+	}
+
+	std::error_code error{};
+	std::filesystem::rename(tempPath, path, error);
+	if (error)
+		fmt::println("[Kleicha] Failed to replace shader cache file {}: {}", path.string(), error.message());
+}
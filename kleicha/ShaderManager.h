@@ -0,0 +1,52 @@
+#ifndef SHADERMANAGER_H
+#define SHADERMANAGER_H
+
+#include <vulkan/vulkan.h>
+
+#include <cstdint>
+#include <filesystem>
+#include <string>
+#include <unordered_map>
+#include <unordered_set>
+#include <vector>
+
+// compiles glsl sources (.vert, .frag, .tesc, .tese) to spir-v at runtime. the spir-v is cached on disk under a hash of the
+// source, every file it includes and its defines, so shaders that haven't changed since the last run are never recompiled.
+// modules are shared between all pipelines that ask for the same shader.
+class ShaderManager {
+public:
+	void init(VkDevice device, const std::string& sourceDir, const std::string& cacheDir);
+
+	// name is relative to the source directory, defines are either NAME or NAME=VALUE
+	VkShaderModule get(const std::string& name, const std::vector<std::string>& defines = {});
+
+	uint32_t get_compiled_count() const {
+		return m_compiledCount;
+	}
+
+	uint32_t get_cached_count() const {
+		return m_cachedCount;
+	}
+
+	void destroy();
+
+private:
+	// bump whenever the compile options change, it invalidates every cached shader
+	static constexpr uint32_t CACHE_VERSION{ 1 };
+
+	VkDevice m_device{};
+	std::filesystem::path m_sourceDir{};
+	std::filesystem::path m_cacheDir{};
+	// keyed by the content hash, shaders with identical inputs share their module
+	std::unordered_map<uint64_t, VkShaderModule> m_modules{};
+	uint32_t m_compiledCount{ 0 };
+	uint32_t m_cachedCount{ 0 };
+
+	std::string read_source(const std::filesystem::path& path) const;
+	void hash_includes(uint64_t& hash, const std::string& source, std::unordered_set<std::string>& visited) const;
+	std::vector<uint32_t> compile(const std::string& name, const std::string& source, const std::vector<std::string>& defines) const;
+	bool load_cached(const std::filesystem::path& path, std::vector<uint32_t>& code) const;
+	void write_cached(const std::filesystem::path& path, const std::vector<uint32_t>& code) const;
+};
+
+#endif // !SHADERMANAGER_H
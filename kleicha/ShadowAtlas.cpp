@@ -0,0 +1,100 @@
+#include "ShadowAtlas.h"
+
+#include <algorithm>
+#include <bit>
+#include <cmath>
+#include <numeric>
+#include <stdexcept>
+
+// number of minimum sized cells covered by the six faces of a light's tiles
+static uint64_t light_cells(uint32_t tileSize) {
+	uint64_t cellsPerSide{ tileSize / ShadowAtlas::MIN_TILE_SIZE };
+	return 6 * cellsPerSide * cellsPerSide;
+}
+
+// extracts the even bits of a morton code
+static uint32_t compact_bits(uint64_t code) {
+	code &= 0x5555555555555555ULL;
+	code = (code | (code >> 1)) & 0x3333333333333333ULL;
+	code = (code | (code >> 2)) & 0x0F0F0F0F0F0F0F0FULL;
+	code = (code | (code >> 4)) & 0x00FF00FF00FF00FFULL;
+	code = (code | (code >> 8)) & 0x0000FFFF0000FFFFULL;
+	code = (code | (code >> 16)) & 0x00000000FFFFFFFFULL;
+	return static_cast<uint32_t>(code);
+}
+
+void ShadowAtlas::init(VkDeviceSize memoryBudget, VkDeviceSize texelSize, uint32_t maxExtent) {
+	uint32_t extent{ std::bit_floor(static_cast<uint32_t>(std::sqrt(static_cast<double>(memoryBudget / texelSize)))) };
+	m_extent = std::min(extent, std::bit_floor(maxExtent));
+
+	if (m_extent < MIN_TILE_SIZE)
+		throw std::runtime_error{ "[Kleicha] Shadow atlas memory budget is too small to hold a single tile." };
+}
+
+void ShadowAtlas::pack(const std::vector<uint32_t>& desiredSizes) {
+	const uint64_t cellsPerSide{ m_extent / MIN_TILE_SIZE };
+	const uint64_t capacity{ cellsPerSide * cellsPerSide };
+
+	// every face of a light shares the same tile size
+	std::vector<uint32_t> sizes(desiredSizes.size());
+	uint64_t requiredCells{ 0 };
+	for (std::size_t i{ 0 }; i < desiredSizes.size(); ++i) {
+		if (desiredSizes[i] == 0)
+			continue;
+
+		sizes[i] = std::min(std::bit_ceil(std::clamp(desiredSizes[i], MIN_TILE_SIZE, MAX_TILE_SIZE)), m_extent);
+		requiredCells += light_cells(sizes[i]);
+	}
+
+	while (requiredCells > capacity) {
+		// find the largest tile, ties go to the light that asked for fewer texels
+		std::size_t largest{ sizes.size() };
+		for (std::size_t i{ 0 }; i < sizes.size(); ++i) {
+			if (sizes[i] == 0)
+				continue;
+			if (largest == sizes.size() || sizes[i] > sizes[largest] || (sizes[i] == sizes[largest] && desiredSizes[i] < desiredSizes[largest]))
+				largest = i;
+		}
+
+		requiredCells -= light_cells(sizes[largest]);
+
+		// every tile is already at the minimum size, the least important light loses its shadows
+		if (sizes[largest] == MIN_TILE_SIZE) {
+			sizes[largest] = 0;
+			continue;
+		}
+
+		sizes[largest] >>= 1;
+		requiredCells += light_cells(sizes[largest]);
+	}
+
+	// stable so that lights keep their place along the curve while their sizes don't change, leaving their cached tiles valid
+	std::vector<std::size_t> order(sizes.size());
+	std::iota(order.begin(), order.end(), std::size_t{ 0 });
+	std::stable_sort(order.begin(), order.end(), [&sizes](std::size_t a, std::size_t b) { return sizes[a] > sizes[b]; });
+
+	m_tiles.assign(sizes.size(), {});
+
+	// the cursor is always a multiple of the current tile's cell count as every tile before it was at least as large,
+	// so each tile starts at an aligned morton block which maps to a square region of the atlas
+	uint64_t cursor{ 0 };
+	for (std::size_t i : order) {
+		if (sizes[i] == 0)
+			break;
+
+		uint64_t faceCells{ light_cells(sizes[i]) / 6 };
+		for (auto& tile : m_tiles[i]) {
+			tile.m_uiX = compact_bits(cursor) * MIN_TILE_SIZE;
+			tile.m_uiY = compact_bits(cursor >> 1) * MIN_TILE_SIZE;
+			tile.m_uiSize = sizes[i];
+			cursor += faceCells;
+		}
+	}
+
+	m_usedCells = cursor;
+}
+
+float ShadowAtlas::get_occupancy() const {
+	const uint64_t cellsPerSide{ m_extent / MIN_TILE_SIZE };
+	return static_cast<float>(m_usedCells) / static_cast<float>(cellsPerSide * cellsPerSide);
+}
@@ -0,0 +1,40 @@
+#ifndef SHADOWATLAS_H
+#define SHADOWATLAS_H
+
+#include "Types.h"
+
+#include <array>
+#include <vector>
+
+// packs six square tiles per light (one for each cube face) into a single depth atlas. tile sizes are powers of two,
+// placing them largest first along a morton (z-order) curve keeps every tile aligned without gaps or overlaps.
+class ShadowAtlas {
+public:
+	static constexpr uint32_t MIN_TILE_SIZE{ 64 };
+	static constexpr uint32_t MAX_TILE_SIZE{ 1024 };
+
+	// picks the largest power of two extent whose texels fit within the memory budget
+	void init(VkDeviceSize memoryBudget, VkDeviceSize texelSize, uint32_t maxExtent);
+
+	// assigns every light a tile size from the size it would like in texels. the largest tiles are halved until all of them
+	// fit, lights that still don't fit at the minimum size are the least important and are left without tiles.
+	void pack(const std::vector<uint32_t>& desiredSizes);
+
+	const vkt::AtlasTile& get_tile(std::size_t lightIndex, uint32_t face) const {
+		return m_tiles[lightIndex][face];
+	}
+
+	uint32_t get_extent() const {
+		return m_extent;
+	}
+
+	// fraction of the atlas covered by tiles after the last pack
+	float get_occupancy() const;
+
+private:
+	uint32_t m_extent{};
+	uint64_t m_usedCells{};
+	std::vector<std::array<vkt::AtlasTile, 6>> m_tiles{};
+};
+
+#endif // !SHADOWATLAS_H
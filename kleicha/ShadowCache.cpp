@@ -0,0 +1,46 @@
+#include "ShadowCache.h"
+#include "Utils.h"
+
+void ShadowCache::resize(std::size_t lightCount) {
+	// new lights start out stale so they are rendered on their first frame
+	m_versions.resize(lightCount, INVALID_VERSION);
+	m_renderedVersions.resize(lightCount, INVALID_VERSION);
+}
+
+void ShadowCache::update(std::size_t lightIndex, const vkt::PointLight& light, const std::vector<vkt::ShadowCaster>& casters,
+	const std::vector<vkt::HostDrawData>& draws, const std::vector<vkt::Transform>& transforms) {
+
+	uint64_t hash{ utils::HASH_OFFSET_BASIS };
+	utils::hash_bytes(hash, &light.m_v3Position, sizeof(light.m_v3Position));
+	utils::hash_bytes(hash, &light.m_fFalloff, sizeof(light.m_fFalloff));
+	utils::hash_bytes(hash, &light.m_fRadius, sizeof(light.m_fRadius));
+	// a light whose tiles moved within the atlas must be re-rendered into its new tiles
+	utils::hash_bytes(hash, light.m_uv4ShadowTiles, sizeof(light.m_uv4ShadowTiles));
+
+	// the caster list already reflects the light's range, moving a caster in or out of range changes the list
+	for (const auto& caster : casters) {
+		utils::hash_bytes(hash, &caster, sizeof(caster));
+		const glm::mat4& model{ transforms[draws[caster.m_uiDrawIndex].m_uiTransformIndex].m_m4Model };
+		utils::hash_bytes(hash, &model, sizeof(model));
+	}
+
+	// reserve zero for invalidated entries
+	if (hash == INVALID_VERSION)
+		hash = 1;
+
+	m_versions[lightIndex] = hash;
+}
+
+void ShadowCache::invalidate_all() {
+	for (auto& version : m_renderedVersions)
+		version = INVALID_VERSION;
+}
+
+std::size_t ShadowCache::stale_count() const {
+	std::size_t count{ 0 };
+	for (std::size_t i{ 0 }; i < m_versions.size(); ++i) {
+		if (is_stale(i))
+			++count;
+	}
+	return count;
+}
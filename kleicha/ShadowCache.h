@@ -0,0 +1,41 @@
+#ifndef SHADOWCACHE_H
+#define SHADOWCACHE_H
+
+#include "Types.h"
+
+#include <vector>
+
+// tracks a version per light derived from everything that affects its shadow map. a light's shadow map only needs
+// to be re-rendered when its current version no longer matches the version it was last rendered with.
+class ShadowCache {
+public:
+	void resize(std::size_t lightCount);
+
+	// recomputes the light's version from its position, range, atlas tiles and the transforms of the casters within its range
+	void update(std::size_t lightIndex, const vkt::PointLight& light, const std::vector<vkt::ShadowCaster>& casters,
+		const std::vector<vkt::HostDrawData>& draws, const std::vector<vkt::Transform>& transforms);
+
+	bool is_stale(std::size_t lightIndex) const {
+		return m_renderedVersions[lightIndex] != m_versions[lightIndex];
+	}
+
+	// must be called once the light's shadow map has been recorded with its current version
+	void mark_rendered(std::size_t lightIndex) {
+		m_renderedVersions[lightIndex] = m_versions[lightIndex];
+	}
+
+	void invalidate(std::size_t lightIndex) {
+		m_renderedVersions[lightIndex] = INVALID_VERSION;
+	}
+
+	void invalidate_all();
+	std::size_t stale_count() const;
+
+private:
+	static constexpr uint64_t INVALID_VERSION{ 0 };
+
+	std::vector<uint64_t> m_versions{};
+	std::vector<uint64_t> m_renderedVersions{};
+};
+
+#endif // !SHADOWCACHE_H
@@ -1,3 +1,4 @@
+#include <algorithm>
 #include <stdexcept>
 #include "Utils.h"
 #include "Initializers.h"
@@ -40,9 +41,9 @@ VkPresentModeKHR SwapchainBuilder::get_swapchain_present_mode() const {
 
 vkt::Swapchain SwapchainBuilder::build() {
 
-	// choose number of swapchain images
-	uint32_t swapchainImageCount{ m_surfaceSupportDetails.capabilities.minImageCount + 1 };
-	if (swapchainImageCount > m_surfaceSupportDetails.capabilities.maxImageCount)
+	// choose number of swapchain images, a max image count of 0 means there's no limit
+	uint32_t swapchainImageCount{ std::max(m_surfaceSupportDetails.capabilities.minImageCount + 1, m_desiredMinImageCount) };
+	if (m_surfaceSupportDetails.capabilities.maxImageCount > 0 && swapchainImageCount > m_surfaceSupportDetails.capabilities.maxImageCount)
 		swapchainImageCount = m_surfaceSupportDetails.capabilities.maxImageCount;
 
 	VkSurfaceFormatKHR swapchainImageFormat{ get_swapchain_format() };
@@ -75,7 +76,7 @@ vkt::Swapchain SwapchainBuilder::build() {
 	swapchainInfo.compositeAlpha = VK_COMPOSITE_ALPHA_OPAQUE_BIT_KHR;
 	swapchainInfo.presentMode = swapchainPresentMode;
 	swapchainInfo.clipped = VK_TRUE;
-	swapchainInfo.oldSwapchain = VK_NULL_HANDLE;
+	swapchainInfo.oldSwapchain = m_oldSwapchain;
 
 	VkSwapchainKHR swapchain{};
 	VK_CHECK(vkCreateSwapchainKHR(m_device, &swapchainInfo, nullptr, &swapchain));
@@ -30,6 +30,19 @@ public:
 		return *this;
 	}
 
+	// clamped to what the surface supports
+	SwapchainBuilder& desired_min_image_count(uint32_t imageCount) {
+		m_desiredMinImageCount = imageCount;
+		return *this;
+	}
+
+	// the swapchain being replaced, lets the presentation engine hand its resources over. it's retired by the new swapchain
+	// but must still be destroyed by the caller.
+	SwapchainBuilder& old_swapchain(VkSwapchainKHR swapchain) {
+		m_oldSwapchain = swapchain;
+		return *this;
+	}
+
 private:
 	VkInstance m_instance{};
 	GLFWwindow* m_window{};
@@ -40,6 +53,8 @@ private:
 	VkSurfaceFormatKHR m_desiredImageFormat{};
 	VkImageUsageFlags m_desiredImageUsage{ VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT };
 	VkPresentModeKHR m_desiredPresentMode{};
+	uint32_t m_desiredMinImageCount{};
+	VkSwapchainKHR m_oldSwapchain{};
 
 	VkSurfaceFormatKHR get_swapchain_format() const;
 	VkExtent2D get_swapchain_image_extent() const;
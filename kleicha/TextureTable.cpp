@@ -0,0 +1,121 @@
+#include "TextureTable.h"
+#include "Utils.h"
+
+#include <algorithm>
+#include <cassert>
+
+void TextureTable::init(const vkt::Device& device, uint32_t reservedDescriptors, DescriptorBuffer* descriptorBuffer) {
+	m_device = device.device;
+	m_descriptorBuffer = descriptorBuffer;
+
+	VkPhysicalDeviceVulkan12Properties vk12Properties{ .sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_VULKAN_1_2_PROPERTIES };
+	VkPhysicalDeviceProperties2 properties{ .sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_PROPERTIES_2, .pNext = &vk12Properties };
+	vkGetPhysicalDeviceProperties2(device.physicalDevice.device, &properties);
+
+	// combined image samplers count as both a sampled image and a sampler
+	uint32_t limit{};
+	if (m_descriptorBuffer) {
+		// descriptor buffer layouts don't use update after bind, the regular limits and the range a bound buffer can address apply
+		const VkPhysicalDeviceLimits& limits{ properties.properties.limits };
+		limit = std::min({ limits.maxDescriptorSetSampledImages, limits.maxDescriptorSetSamplers, limits.maxPerStageDescriptorSampledImages,
+			limits.maxPerStageDescriptorSamplers, m_descriptorBuffer->get_max_combined_image_samplers() });
+	}
+	else
+		limit = std::min({ vk12Properties.maxDescriptorSetUpdateAfterBindSampledImages, vk12Properties.maxDescriptorSetUpdateAfterBindSamplers,
+			vk12Properties.maxPerStageDescriptorUpdateAfterBindSampledImages, vk12Properties.maxPerStageDescriptorUpdateAfterBindSamplers });
+	if (limit <= reservedDescriptors)
+		throw std::runtime_error{ "[TextureTable] The device doesn't support enough sampled image descriptors." };
+	m_uiCapacity = std::min(limit - reservedDescriptors, MAX_CAPACITY);
+
+	m_freeSlots.resize(m_uiCapacity);
+	for (uint32_t i{ 0 }; i < m_uiCapacity; ++i)
+		m_freeSlots[i] = m_uiCapacity - 1 - i;
+
+	fmt::println("[TextureTable] Bindless texture capacity is {}, written to a descriptor {}.", m_uiCapacity, m_descriptorBuffer ? "buffer" : "set");
+}
+
+void TextureTable::set_descriptor_set(VkDescriptorSet descriptorSet, uint32_t binding, VkSampler sampler) {
+	std::scoped_lock lock{ m_mutex };
+	m_descriptorSet = descriptorSet;
+	m_uiBinding = binding;
+	m_sampler = sampler;
+}
+
+uint32_t TextureTable::add(VkImageView imageView) {
+	std::scoped_lock lock{ m_mutex };
+	if (m_freeSlots.empty())
+		throw std::runtime_error{ fmt::format("[TextureTable] All {} texture slots are in use.", m_uiCapacity) };
+
+	uint32_t slot{ m_freeSlots.back() };
+	m_freeSlots.pop_back();
+	m_pendingWrites.push_back(PendingWrite{ .m_uiSlot = slot, .m_imageView = imageView });
+	return slot;
+}
+
+void TextureTable::remove(uint32_t slot, uint32_t frameNumber) {
+	std::scoped_lock lock{ m_mutex };
+	assert(slot < m_uiCapacity);
+	// a texture evicted before its write was flushed never reaches the set
+	std::erase_if(m_pendingWrites, [slot](const PendingWrite& write) { return write.m_uiSlot == slot; });
+
+	// keeps the slots sorted by frame so that collecting only ever looks at the front
+	assert(m_retiredSlots.empty() || m_retiredSlots.back().m_uiFrameNumber <= frameNumber);
+	m_retiredSlots.push_back(RetiredSlot{ .m_uiFrameNumber = frameNumber, .m_uiSlot = slot });
+}
+
+void TextureTable::replace(uint32_t slot, VkImageView imageView) {
+	std::scoped_lock lock{ m_mutex };
+	assert(slot < m_uiCapacity);
+	m_pendingWrites.push_back(PendingWrite{ .m_uiSlot = slot, .m_imageView = imageView });
+}
+
+std::size_t TextureTable::flush() {
+	std::scoped_lock lock{ m_mutex };
+	if (m_pendingWrites.empty())
+		return 0;
+
+	std::size_t written{ m_pendingWrites.size() };
+	if (m_descriptorBuffer) {
+		// no write structures to fill, each descriptor is copied into the mapped buffer as it's fetched
+		for (const auto& write : m_pendingWrites)
+			m_descriptorBuffer->write_combined_image_sampler(m_uiBinding, write.m_uiSlot, m_sampler, write.m_imageView, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL);
+		m_descriptorBuffer->flush();
+		m_pendingWrites.clear();
+		return written;
+	}
+
+	assert(m_descriptorSet);
+	std::vector<VkDescriptorImageInfo> imageInfos(m_pendingWrites.size());
+	std::vector<VkWriteDescriptorSet> writes(m_pendingWrites.size());
+	for (std::size_t i{ 0 }; i < m_pendingWrites.size(); ++i) {
+		imageInfos[i].sampler = m_sampler;
+		imageInfos[i].imageView = m_pendingWrites[i].m_imageView;
+		imageInfos[i].imageLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
+
+		writes[i] = VkWriteDescriptorSet{ .sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET };
+		writes[i].dstSet = m_descriptorSet;
+		writes[i].dstBinding = m_uiBinding;
+		writes[i].dstArrayElement = m_pendingWrites[i].m_uiSlot;
+		writes[i].descriptorCount = 1;
+		writes[i].descriptorType = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
+		writes[i].pImageInfo = &imageInfos[i];
+	}
+	vkUpdateDescriptorSets(m_device, static_cast<uint32_t>(writes.size()), writes.data(), 0, nullptr);
+
+	m_pendingWrites.clear();
+	return written;
+}
+
+void TextureTable::collect(uint32_t completedFrame) {
+	std::scoped_lock lock{ m_mutex };
+	// the stale descriptor stays in the slot until it's reused, partially bound slots may hold one as long as nothing samples them
+	while (!m_retiredSlots.empty() && m_retiredSlots.front().m_uiFrameNumber <= completedFrame) {
+		m_freeSlots.push_back(m_retiredSlots.front().m_uiSlot);
+		m_retiredSlots.pop_front();
+	}
+}
+
+uint32_t TextureTable::get_used() const {
+	std::scoped_lock lock{ m_mutex };
+	return m_uiCapacity - static_cast<uint32_t>(m_freeSlots.size());
+}
@@ -0,0 +1,71 @@
+#ifndef TEXTURETABLE_H
+#define TEXTURETABLE_H
+
+#include "Types.h"
+#include "DescriptorBuffer.h"
+
+#include <deque>
+#include <mutex>
+#include <vector>
+
+// the bindless texture array. slots are handed out from a free list and written with VK_DESCRIPTOR_BINDING_UPDATE_AFTER_BIND_BIT,
+// or straight into a descriptor buffer, so textures can be added and evicted while frames that bind the table are in flight.
+// any thread may add or remove textures, their writes are batched until the next flush. an evicted slot is only reused once
+// the frames that may still sample it have completed.
+class TextureTable {
+public:
+	// capacities beyond this only cost descriptor memory
+	static constexpr uint32_t MAX_CAPACITY{ 1u << 16 };
+
+	// reservedDescriptors are the other sampled image descriptors of the set the table is written to, they count against the same limits.
+	// with a descriptor buffer the table is written to it rather than to a descriptor set.
+	void init(const vkt::Device& device, uint32_t reservedDescriptors, DescriptorBuffer* descriptorBuffer = nullptr);
+	// the binding must have been created with the table's capacity and the partially bound flag, as well as the update after bind
+	// flag unless the table writes to a descriptor buffer, in which case the set is ignored
+	void set_descriptor_set(VkDescriptorSet descriptorSet, uint32_t binding, VkSampler sampler);
+
+	// returns the texture's slot, it may be sampled by frames submitted after the next flush
+	uint32_t add(VkImageView imageView);
+	// frameNumber is the last frame that may sample the slot, the image view must outlive that frame
+	void remove(uint32_t slot, uint32_t frameNumber);
+	// rewrites a slot in use with the next flush, only while no frame in flight samples it
+	void replace(uint32_t slot, VkImageView imageView);
+
+	// writes the descriptors of the textures added since the last flush, returns the number written
+	std::size_t flush();
+	// recycles the slots removed up to and including completedFrame
+	void collect(uint32_t completedFrame);
+
+	uint32_t get_capacity() const {
+		return m_uiCapacity;
+	}
+
+	uint32_t get_used() const;
+
+private:
+	struct PendingWrite {
+		uint32_t m_uiSlot{};
+		VkImageView m_imageView{};
+	};
+
+	struct RetiredSlot {
+		uint32_t m_uiFrameNumber{};
+		uint32_t m_uiSlot{};
+	};
+
+	VkDevice m_device{};
+	DescriptorBuffer* m_descriptorBuffer{};
+	VkDescriptorSet m_descriptorSet{};
+	uint32_t m_uiBinding{};
+	VkSampler m_sampler{};
+	uint32_t m_uiCapacity{};
+
+	// guards everything below, descriptor writes to the set are serialized by it as well
+	mutable std::mutex m_mutex{};
+	// popped from the back, so the lowest slots are handed out first
+	std::vector<uint32_t> m_freeSlots{};
+	std::vector<PendingWrite> m_pendingWrites{};
+	std::deque<RetiredSlot> m_retiredSlots{};
+};
+
+#endif // !TEXTURETABLE_H
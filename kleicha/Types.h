@@ -8,6 +8,7 @@
 #define GLM_ENABLE_EXPERIMENTAL
 #include <gtx/hash.hpp>
 #include <vector>
+#include <string>
 #include "vk_mem_alloc.h"
 #include "vulkan/vulkan.h"
 #include<vulkan/vk_enum_string_helper.h>
@@ -19,6 +20,9 @@ namespace vkt {
 	struct alignas(16) PushConstants {
 		glm::mat4 m_m4ViewProjection{};
 		uint32_t drawId{};
+		uint32_t lightId{};
+		// address of the frame's SceneAddresses
+		VkDeviceAddress m_sceneAddress{};
 	};
 
 	struct Instance {
@@ -26,6 +30,16 @@ namespace vkt {
 		VkDebugUtilsMessengerEXT debugMessenger{};
 		PFN_vkCreateDebugUtilsMessengerEXT pfnCreateMessenger{};
 		PFN_vkDestroyDebugUtilsMessengerEXT pfnDestroyMessenger{};
+		// the optional extensions that turned out to be supported
+		std::vector<std::string> enabledOptionalExtensions{};
+
+		bool is_extension_enabled(const char* extension) const {
+			for (const auto& enabledExtension : enabledOptionalExtensions) {
+				if (enabledExtension == extension)
+					return true;
+			}
+			return false;
+		}
 	};
 
 	// stores the surface support for our chosen physical device
@@ -47,6 +61,17 @@ namespace vkt {
 		PhysicalDevice physicalDevice{};
 		VkDevice device{};
 		VkQueue queue{};
+		std::vector<std::string> enabledExtensions{};
+		// core features, including the optional ones the device turned out to support
+		VkPhysicalDeviceFeatures enabledFeatures{};
+
+		bool is_extension_enabled(const char* extension) const {
+			for (const auto& enabledExtension : enabledExtensions) {
+				if (enabledExtension == extension)
+					return true;
+			}
+			return false;
+		}
 	};
 
 	struct Swapchain {
@@ -66,11 +91,6 @@ namespace vkt {
 		uint32_t mipLevels{ 1 };
 	};
 
-	struct CubeImage {
-		Image colorImage{};
-		Image depthImage{};
-	};
-
 	struct Buffer {
 		VkBuffer buffer{};
 		VmaAllocation allocation{};
@@ -98,6 +118,29 @@ namespace vkt {
 		uint32_t m_uiIndicesCount{};
 		uint32_t m_uiIndicesOffset{};
 		int32_t m_iVertexOffset{};
+		uint32_t m_uiTransformIndex{};
+		uint32_t m_uiMaterialIndex{};
+		// object space bounds of the mesh referenced by this draw
+		glm::vec3 m_v3BoundsMin{};
+		glm::vec3 m_v3BoundsMax{};
+	};
+
+	struct BoundingSphere {
+		glm::vec3 m_v3Center{};
+		float m_fRadius{};
+	};
+
+	// a draw that lies within a light's range along with the cube faces it can cast into
+	struct ShadowCaster {
+		uint32_t m_uiDrawIndex{};
+		uint32_t m_uiFaceMask{};
+	};
+
+	// square region of the shadow atlas in texels. a size of zero means no region was assigned.
+	struct AtlasTile {
+		uint32_t m_uiX{};
+		uint32_t m_uiY{};
+		uint32_t m_uiSize{};
 	};
 
 	struct Mesh {
@@ -109,9 +152,42 @@ namespace vkt {
 	};
 
 	struct GlobalData {
-		glm::vec3 m_v3CameraPosition{};
 		uint32_t m_uiNumPointLights{};
 		uint32_t m_uiUseEmissive{};
+		uint32_t m_uiUseShadows{};
+		uint32_t m_uiUseClusters{};
+		// view depth of the first cluster slice and the scale applied to log(depth / near) to find a depth's slice
+		float m_fClusterNear{};
+		float m_fClusterSliceScale{};
+		// size of a cluster's screen tile in pixels
+		alignas(8)glm::vec2 m_v2ClusterTileSize{};
+	};
+
+	// the main pass camera, kept out of the push constants so it can be rewritten after the commands were recorded. the
+	// position and forward direction shading uses are latched along with the view projection.
+	struct CameraData {
+		glm::mat4 m_m4ViewProjection{};
+		alignas(16)glm::vec3 m_v3Position{};
+		alignas(16)glm::vec3 m_v3Forward{};
+	};
+
+	// device addresses of every buffer the shaders read, so that a buffer can be swapped for another without rewriting descriptors
+	struct SceneAddresses {
+		VkDeviceAddress m_vertices{};
+		VkDeviceAddress m_draws{};
+		VkDeviceAddress m_globals{};
+		VkDeviceAddress m_transforms{};
+		VkDeviceAddress m_materials{};
+		VkDeviceAddress m_lights{};
+		VkDeviceAddress m_clusters{};
+		VkDeviceAddress m_clusterLights{};
+		VkDeviceAddress m_camera{};
+	};
+
+	// range of the cluster light index list holding the lights that overlap a cluster
+	struct Cluster {
+		uint32_t m_uiOffset{};
+		uint32_t m_uiCount{};
 	};
 
 	struct Transform {
@@ -136,6 +212,11 @@ namespace vkt {
 		glm::vec3 m_v3Position{};
 		alignas(16)glm::vec3 m_v3Color{};
 		alignas(16)glm::vec3 m_fFalloff{};
+		// shadow range, the atlas stores distance to the light linearly over [0, m_fRadius]
+		float m_fRadius{};
+		// atlas tile of each cube face (+X, -X, +Y, -Y, +Z, -Z) as texel offset (xy) and size (z). a size of zero disables the light's shadows.
+		glm::uvec4 m_uv4ShadowTiles[6]{};
+		glm::mat4 m_m4FaceViewProj[6]{};
 	};
 
 	struct alignas(16) Material {
@@ -166,14 +247,60 @@ namespace vkt {
 		VkCommandBuffer cmdBuffer{};
 		VkFence inFlightFence{};
 		VkSemaphore acquiredSemaphore{};
-		VkDescriptorSet descriptorSet{};
 
+		// camera, light count and toggles as seen by this frame, later frames rewrite their own copy while it's in flight
+		vkt::Buffer globalsBuffer{};
 		vkt::Buffer transformBuffer{};
 		vkt::Buffer materialBuffer{};
+		// sized for lightCapacity lights, grown once the light count exceeds it
 		vkt::Buffer lightBuffer{};
+		uint32_t lightCapacity{};
+		vkt::Buffer clusterBuffer{};
+		vkt::Buffer clusterLightBuffer{};
+		// the main pass view projection, small enough to be rewritten right before submission
+		vkt::Buffer cameraBuffer{};
+		// the frame's SceneAddresses, its address is pushed with every draw
+		vkt::Buffer sceneBuffer{};
+	};
 
-		std::vector<vkt::Image> shadowMaps{};
-		std::vector<vkt::CubeImage> cubeShadowMaps{};
+	// startup options, parsed from the command line
+	struct Config {
+		// number of randomly placed point lights spawned in addition to the scene's lights
+		uint32_t m_uiStressLights{};
+		// seeds the placement of the stress lights so that runs are repeatable
+		uint32_t m_uiStressSeed{ 1 };
+		// sweeps the active light count and records the frame time of each count with and without clustering
+		bool m_bLightBenchmark{ false };
+		std::string m_lightBenchmarkPath{ "light_benchmark.csv" };
+		// renders offscreen without a window, surface or swapchain and exits after a fixed number of frames
+		bool m_bHeadless{ false };
+		uint32_t m_uiHeadlessFrames{ 1000 };
+		// replays a recorded camera path with a fixed timestep and writes <m_benchmarkPath>.csv and .json
+		std::string m_cameraPath{};
+		uint32_t m_uiBenchmarkFrames{ 1000 };
+		std::string m_benchmarkPath{ "benchmark" };
+		// records the camera of an interactive session into a path that can be replayed
+		std::string m_recordCameraPath{};
+		// counts the primitives and shader invocations of each profiled pass, costs some gpu time on most drivers
+		bool m_bPipelineStatistics{ false };
+		// more frames in flight trade latency for throughput, between 1 and MAX_FRAMES_IN_FLIGHT
+		uint32_t m_uiFramesInFlight{ 2 };
+		// samples input and writes the camera right before submission instead of when the frame's commands are recorded
+		bool m_bLateLatch{ false };
+		// profiles cpu zones from startup and writes them as a chrome trace at exit, F2 writes the trace at any time
+		bool m_bCpuTrace{ false };
+		std::string m_cpuTracePath{ "cpu_trace.json" };
+		// writes per category and per heap memory usage along with vma's statistics as json at exit, F3 writes them at any time
+		bool m_bMemoryStats{ false };
+		std::string m_memoryStatsPath{ "memory_stats.json" };
+		// binds descriptors through VK_EXT_descriptor_buffer instead of a descriptor set, falls back to the set without the extension
+		bool m_bDescriptorBuffer{ false };
+		// rewrites every texture descriptor this many times at startup and reports the update throughput of the binding backend
+		uint32_t m_uiDescriptorBenchmarkRounds{};
+		// lowers the render resolution whenever the gpu misses this frame rate, 0 starts with dynamic resolution off
+		uint32_t m_uiDynamicResolutionFps{};
+		// lays down depth with a position only pass so that the main pass shades each pixel once with an equal depth test
+		bool m_bDepthPrepass{ false };
 	};
 
 	// chained and encapsulated device features struct
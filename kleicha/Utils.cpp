@@ -3,6 +3,8 @@
 
 
 #include <unordered_map>
+#include <algorithm>
+#include <limits>
 
 #pragma warning(push)
 #pragma warning(disable : 26495 6262 6054 4365)
@@ -28,28 +30,10 @@ namespace std {
 }
 
 namespace utils {
-    VkShaderModule create_shader_module(VkDevice device, const char* path) {
-        // opens an input file stream. Specify stream open mode
-        std::ifstream ifstrm{ path, std::ios::binary | std::ios::ate };
-        if (!ifstrm.is_open())
-            throw std::runtime_error{ "[Utils] Failed to open file stream with file: " + std::string{path} };
-
-        // file size in bytes
-        std::size_t fileSize{ static_cast<std::size_t>(ifstrm.tellg()) };
-
-        // driver expects the provided intermediate spir-v data to be a contiguous array of uint32_t (4 bytes)
-        std::vector<uint32_t> buffer(fileSize / sizeof(uint32_t));
-
-        // seek to top of file and read stream into our vector
-        ifstrm.seekg(0);
-        // std::vector::data returns pointer to beginning, read data into vector a byte at a time.
-        ifstrm.read(reinterpret_cast<char*>(buffer.data()), static_cast<std::streamsize>(fileSize));
-        ifstrm.close();
-
-        // create shader module
+    VkShaderModule create_shader_module(VkDevice device, const std::vector<uint32_t>& code) {
         VkShaderModuleCreateInfo shaderModuleInfo{ .sType = VK_STRUCTURE_TYPE_SHADER_MODULE_CREATE_INFO };
-        shaderModuleInfo.codeSize = buffer.size() * sizeof(uint32_t);
-        shaderModuleInfo.pCode = buffer.data();
+        shaderModuleInfo.codeSize = code.size() * sizeof(uint32_t);
+        shaderModuleInfo.pCode = code.data();
 
         VkShaderModule shaderModule{};
         VK_CHECK(vkCreateShaderModule(device, &shaderModuleInfo, nullptr, &shaderModule));
@@ -116,6 +100,11 @@ namespace utils {
         return buf;
     }
 
+    VkDeviceAddress get_buffer_device_address(VkDevice device, VkBuffer buffer) {
+        VkBufferDeviceAddressInfo bdaInfo{ .sType = VK_STRUCTURE_TYPE_BUFFER_DEVICE_ADDRESS_INFO, .buffer = buffer };
+        return vkGetBufferDeviceAddress(device, &bdaInfo);
+    }
+
     void update_set_buffer_descriptor(VkDevice device, VkDescriptorSet set, uint32_t binding, VkDescriptorType descriptorType, VkBuffer buffer, VkDeviceSize offset, VkDeviceSize range) {
         VkDescriptorBufferInfo descriptorBufferInfo{ init::create_descriptor_buffer_info(buffer, offset, range) };
 
@@ -151,28 +140,6 @@ namespace utils {
         vkUpdateDescriptorSets(device, 1, &writeDescriptorSetInfo, 0, nullptr);
     }
 
-    void update_set_image_sampler_descriptor(VkDevice device, VkDescriptorSet set, uint32_t binding, VkImageLayout imageSampledLayout, VkSampler sampler, const std::vector<vkt::CubeImage>& images) {
-
-        uint32_t imageCount{ static_cast<uint32_t>(images.size()) };
-
-        std::vector<VkDescriptorImageInfo> imageInfos(imageCount);
-
-        for (std::size_t i{ 0 }; i < imageCount; ++i) {
-            imageInfos[i].sampler = sampler;
-            imageInfos[i].imageView = images[i].colorImage.imageView;
-            imageInfos[i].imageLayout = imageSampledLayout;
-        }
-        VkWriteDescriptorSet writeDescriptorSetInfo{ .sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET };
-        writeDescriptorSetInfo.dstSet = set;
-        writeDescriptorSetInfo.dstBinding = binding;
-        writeDescriptorSetInfo.dstArrayElement = 0;
-        writeDescriptorSetInfo.descriptorCount = static_cast<uint32_t>(imageInfos.size());
-        writeDescriptorSetInfo.descriptorType = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
-        writeDescriptorSetInfo.pImageInfo = imageInfos.data();
-        vkUpdateDescriptorSets(device, 1, &writeDescriptorSetInfo, 0, nullptr);
-    }
-
-
     vkt::Mesh generate_cube_mesh() {
         return {
             .tInd { //triangles
@@ -677,4 +644,196 @@ namespace utils {
         vkCmdSetViewport(frame.cmdBuffer, 0, 1, &viewport);
         vkCmdSetScissor(frame.cmdBuffer, 0, 1, &scissor);
     }
+
+    void set_viewport_scissor(const vkt::Frame& frame, const vkt::AtlasTile& tile) {
+        VkViewport viewport{};
+        viewport.x = static_cast<float>(tile.m_uiX);
+        viewport.y = static_cast<float>(tile.m_uiY);
+        viewport.width = static_cast<float>(tile.m_uiSize);
+        viewport.height = static_cast<float>(tile.m_uiSize);
+        viewport.minDepth = 0.0f;
+        viewport.maxDepth = 1.0f;
+
+        VkRect2D scissor{};
+        scissor.offset.x = static_cast<int32_t>(tile.m_uiX);
+        scissor.offset.y = static_cast<int32_t>(tile.m_uiY);
+        scissor.extent = { tile.m_uiSize, tile.m_uiSize };
+
+        vkCmdSetViewport(frame.cmdBuffer, 0, 1, &viewport);
+        vkCmdSetScissor(frame.cmdBuffer, 0, 1, &scissor);
+    }
+
+    // distance at which the light's attenuated intensity drops below the cutoff. falloff stores the constant, linear and quadratic terms.
+    float compute_light_radius(const vkt::PointLight& light, float cutoffIntensity) {
+        float intensity{ std::max(light.m_v3Color.r, std::max(light.m_v3Color.g, light.m_v3Color.b)) };
+        if (intensity <= 0.0f)
+            return 0.0f;
+
+        // solve quadratic * d^2 + linear * d + (constant - intensity / cutoff) = 0 for d
+        float c{ light.m_fFalloff.x - intensity / cutoffIntensity };
+        float l{ light.m_fFalloff.y };
+        float q{ light.m_fFalloff.z };
+
+        if (c >= 0.0f)
+            return 0.0f;
+
+        if (q > 0.0f)
+            return (-l + std::sqrt(l * l - 4.0f * q * c)) / (2.0f * q);
+
+        if (l > 0.0f)
+            return -c / l;
+
+        // no distance based attenuation, the light reaches everything
+        return std::numeric_limits<float>::max();
+    }
+
+    vkt::BoundingSphere compute_bounding_sphere(const glm::vec3& boundsMin, const glm::vec3& boundsMax, const glm::mat4& model) {
+        glm::vec3 center{ model * glm::vec4{ (boundsMin + boundsMax) * 0.5f, 1.0f } };
+
+        // scale the object space radius by the largest axis scale of the model matrix
+        float scale{ std::max(glm::length(glm::vec3{ model[0] }), std::max(glm::length(glm::vec3{ model[1] }), glm::length(glm::vec3{ model[2] }))) };
+        float radius{ glm::length(boundsMax - boundsMin) * 0.5f * scale };
+
+        return vkt::BoundingSphere{ .m_v3Center = center, .m_fRadius = radius };
+    }
+
+    // returns a bitfield where bit i is set if the sphere overlaps cube face i (+X, -X, +Y, -Y, +Z, -Z) as seen from the light.
+    uint32_t compute_cube_face_mask(const glm::vec3& lightPosition, const vkt::BoundingSphere& sphere) {
+        glm::vec3 d{ sphere.m_v3Center - lightPosition };
+        float r{ sphere.m_fRadius };
+
+        // light is inside the sphere, every face can see it
+        if (glm::dot(d, d) <= r * r)
+            return 0b111111;
+
+        // each face frustum is bound by the planes |a| <= major axis, scaled by sqrt(2) as the plane normals aren't unit length
+        float rScaled{ r * 1.41421356f };
+        uint32_t faceMask{ 0 };
+        for (uint32_t axis{ 0 }; axis < 3; ++axis) {
+            float a{ d[static_cast<glm::length_t>((axis + 1) % 3)] };
+            float b{ d[static_cast<glm::length_t>((axis + 2) % 3)] };
+
+            for (uint32_t sign{ 0 }; sign < 2; ++sign) {
+                float major{ sign == 0 ? d[static_cast<glm::length_t>(axis)] : -d[static_cast<glm::length_t>(axis)] };
+
+                if (major + r <= 0.0f)
+                    continue;
+                if (major - a <= -rScaled || major + a <= -rScaled || major - b <= -rScaled || major + b <= -rScaled)
+                    continue;
+
+                faceMask |= 1u << (axis * 2 + sign);
+            }
+        }
+        return faceMask;
+    }
+
+    // approximates the light's importance by the screen space diameter in pixels of the sphere bounding its range
+    uint32_t compute_shadow_tile_size(const glm::vec3& cameraPosition, const glm::vec3& lightPosition, float lightRadius, uint32_t viewportHeight) {
+        if (lightRadius <= 0.0f)
+            return 0;
+
+        glm::vec3 d{ lightPosition - cameraPosition };
+        float distSq{ glm::dot(d, d) };
+        float radiusSq{ lightRadius * lightRadius };
+
+        // the camera is within the light's range
+        if (distSq <= radiusSq)
+            return viewportHeight;
+
+        // tangent of the sphere's angular radius. the camera's vertical field of view is 90 degrees so the tangent of its half angle is 1.
+        float tanAngularRadius{ lightRadius / std::sqrt(distSq - radiusSq) };
+        return static_cast<uint32_t>(tanAngularRadius * static_cast<float>(viewportHeight));
+    }
+
+    // face order matches compute_cube_face_mask: +X, -X, +Y, -Y, +Z, -Z
+    void compute_cube_face_view_projs(const glm::vec3& lightPosition, glm::mat4 (&faceViewProjs)[6]) {
+        static const glm::vec3 directions[6]{ {1.0f, 0.0f, 0.0f}, {-1.0f, 0.0f, 0.0f}, {0.0f, 1.0f, 0.0f}, {0.0f, -1.0f, 0.0f}, {0.0f, 0.0f, 1.0f}, {0.0f, 0.0f, -1.0f} };
+        static const glm::vec3 ups[6]{ {0.0f, 1.0f, 0.0f}, {0.0f, 1.0f, 0.0f}, {0.0f, 0.0f, 1.0f}, {0.0f, 0.0f, 1.0f}, {0.0f, 1.0f, 0.0f}, {0.0f, 1.0f, 0.0f} };
+
+        // a 90 degree field of view with a square aspect ratio covers exactly one face of the cube
+        glm::mat4 faceProj{ orthographicProj(glm::radians(90.0f), 1.0f, 1000.0f, 0.1f) * perspective(1000.0f, 0.1f) };
+        for (std::size_t i{ 0 }; i < 6; ++i)
+            faceViewProjs[i] = faceProj * lookAt(lightPosition, lightPosition + directions[i], ups[i]);
+    }
+
+    // reads the value following an option, e.g. the 64 in --lights 64
+    static const char* option_value(int argc, char** argv, int& i) {
+        if (i + 1 >= argc)
+            throw std::runtime_error{ "[Utils] Missing value for command line option " + std::string{ argv[i] } };
+        return argv[++i];
+    }
+
+    static uint32_t option_uint(int argc, char** argv, int& i) {
+        const char* option{ argv[i] };
+        const char* value{ option_value(argc, argv, i) };
+        try {
+            return static_cast<uint32_t>(std::stoul(value));
+        }
+        catch (const std::exception&) {
+            throw std::runtime_error{ "[Utils] Expected a number for command line option " + std::string{ option } + ", got " + value };
+        }
+    }
+
+    void hash_bytes(uint64_t& hash, const void* data, std::size_t size) {
+        const unsigned char* bytes{ static_cast<const unsigned char*>(data) };
+        for (std::size_t i{ 0 }; i < size; ++i) {
+            hash ^= bytes[i];
+            hash *= 1099511628211ULL;
+        }
+    }
+
+    vkt::Config parse_command_line(int argc, char** argv) {
+        vkt::Config config{};
+
+        for (int i{ 1 }; i < argc; ++i) {
+            std::string option{ argv[i] };
+
+            if (option == "--lights")
+                config.m_uiStressLights = option_uint(argc, argv, i);
+            else if (option == "--seed")
+                config.m_uiStressSeed = option_uint(argc, argv, i);
+            else if (option == "--light-benchmark")
+                config.m_bLightBenchmark = true;
+            else if (option == "--light-benchmark-out")
+                config.m_lightBenchmarkPath = option_value(argc, argv, i);
+            else if (option == "--headless")
+                config.m_bHeadless = true;
+            else if (option == "--frames")
+                config.m_uiHeadlessFrames = option_uint(argc, argv, i);
+            else if (option == "--camera-path")
+                config.m_cameraPath = option_value(argc, argv, i);
+            else if (option == "--benchmark-frames")
+                config.m_uiBenchmarkFrames = option_uint(argc, argv, i);
+            else if (option == "--benchmark-out")
+                config.m_benchmarkPath = option_value(argc, argv, i);
+            else if (option == "--record-camera-path")
+                config.m_recordCameraPath = option_value(argc, argv, i);
+            else if (option == "--pipeline-statistics")
+                config.m_bPipelineStatistics = true;
+            else if (option == "--frames-in-flight")
+                config.m_uiFramesInFlight = option_uint(argc, argv, i);
+            else if (option == "--late-latch")
+                config.m_bLateLatch = true;
+            else if (option == "--cpu-trace")
+                config.m_bCpuTrace = true;
+            else if (option == "--cpu-trace-out")
+                config.m_cpuTracePath = option_value(argc, argv, i);
+            else if (option == "--memory-stats")
+                config.m_bMemoryStats = true;
+            else if (option == "--memory-stats-out")
+                config.m_memoryStatsPath = option_value(argc, argv, i);
+            else if (option == "--descriptor-buffer")
+                config.m_bDescriptorBuffer = true;
+            else if (option == "--descriptor-benchmark")
+                config.m_uiDescriptorBenchmarkRounds = option_uint(argc, argv, i);
+            else if (option == "--dynamic-resolution")
+                config.m_uiDynamicResolutionFps = option_uint(argc, argv, i);
+            else if (option == "--depth-prepass")
+                config.m_bDepthPrepass = true;
+            else
+                throw std::runtime_error{ "[Utils] Unknown command line option " + option };
+        }
+
+        return config;
+    }
 }
\ No newline at end of file
@@ -22,7 +22,7 @@
     } while (0)
 
 namespace utils {
-    VkShaderModule create_shader_module(VkDevice device, const char* path);
+    VkShaderModule create_shader_module(VkDevice device, const std::vector<uint32_t>& code);
 
     void image_memory_barrier(VkCommandBuffer cmdBuffer, VkPipelineStageFlags2 srcStageMask, VkAccessFlags2 srcAccessMask,
         VkPipelineStageFlags2 dstStageMask, VkAccessFlags2 dstAccessMask, VkImageLayout oldLayout, VkImageLayout newLayout, VkImage image, uint32_t mipLevels);
@@ -39,11 +39,13 @@ namespace utils {
     vkt::Buffer create_buffer(VmaAllocator allocator, VkDeviceSize bufferSize, VkBufferUsageFlags bufferUsage,
                                 VmaMemoryUsage memoryUsage, VkMemoryPropertyFlags requiredFlags, VmaAllocationCreateFlags flags = 0);
 
+    // the buffer must have been created with VK_BUFFER_USAGE_SHADER_DEVICE_ADDRESS_BIT
+    VkDeviceAddress get_buffer_device_address(VkDevice device, VkBuffer buffer);
+
     void update_set_buffer_descriptor(VkDevice device, VkDescriptorSet set, uint32_t binding, VkDescriptorType descriptorType,
         VkBuffer buffer, VkDeviceSize offset = 0, VkDeviceSize range = VK_WHOLE_SIZE);
 
     void update_set_image_sampler_descriptor(VkDevice device, VkDescriptorSet set, uint32_t binding, VkImageLayout imageSampledLayout, VkSampler sampler, const std::vector<vkt::Image>& images);
-    void update_set_image_sampler_descriptor(VkDevice device, VkDescriptorSet set, uint32_t binding, VkImageLayout imageSampledLayout, VkSampler sampler, const std::vector<vkt::CubeImage>& images);
 
 
     glm::mat4 lookAt(glm::vec3 eye, glm::vec3 lookat, glm::vec3 up);
@@ -52,9 +54,23 @@ namespace utils {
     glm::mat4 orthographicProj(float vFov, float aspectRatio, float near, float far);
 
     void set_viewport_scissor(const vkt::Frame& frame, VkExtent2D extent);
+    void set_viewport_scissor(const vkt::Frame& frame, const vkt::AtlasTile& tile);
+
+    float compute_light_radius(const vkt::PointLight& light, float cutoffIntensity);
+    vkt::BoundingSphere compute_bounding_sphere(const glm::vec3& boundsMin, const glm::vec3& boundsMax, const glm::mat4& model);
+    uint32_t compute_cube_face_mask(const glm::vec3& lightPosition, const vkt::BoundingSphere& sphere);
+    uint32_t compute_shadow_tile_size(const glm::vec3& cameraPosition, const glm::vec3& lightPosition, float lightRadius, uint32_t viewportHeight);
+    void compute_cube_face_view_projs(const glm::vec3& lightPosition, glm::mat4 (&faceViewProjs)[6]);
 
     void compute_mesh_tangents(vkt::Mesh& mesh);
 
+    // 64-bit FNV-1a, start from HASH_OFFSET_BASIS and accumulate the bytes of each value into the running hash
+    inline constexpr uint64_t HASH_OFFSET_BASIS{ 14695981039346656037ULL };
+    void hash_bytes(uint64_t& hash, const void* data, std::size_t size);
+
+    // --lights <count> --seed <seed> --light-benchmark --light-benchmark-out <path>
+    vkt::Config parse_command_line(int argc, char** argv);
+
     bool load_gltf(const char* filePath, std::vector<vkt::Mesh>& meshes, std::vector<vkt::DrawData>& draws, std::vector<vkt::Transform>& transforms, std::vector<vkt::Material>& materials, std::vector<std::string>& texturePaths);
 }
 #endif // !UTILS_H
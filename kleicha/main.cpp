@@ -1,4 +1,5 @@
 #include "Kleicha.h"
+#include "Utils.h"
 
 #pragma warning(push, 0)
 #pragma warning(disable : 6285 26498)
@@ -7,11 +8,11 @@
 
 #include <stdexcept>
 
-int main()
+int main(int argc, char** argv)
 {
 	Kleicha kleicha{};
 	try {
-		kleicha.init();
+		kleicha.init(utils::parse_command_line(argc, argv));
 		kleicha.start();
 		kleicha.cleanup();
 	}
@@ -1,3 +1,5 @@
+#extension GL_EXT_buffer_reference : require
+
 struct Vertex {
 	vec3 v3Position;
 	vec2 v2UV;
@@ -6,11 +8,27 @@ struct Vertex {
 	vec3 v4Bitangent;
 };
 
+// froxel grid dimensions, must match LightClusters
+#define CLUSTER_GRID_X 16u
+#define CLUSTER_GRID_Y 9u
+#define CLUSTER_GRID_Z 24u
+
 struct GlobalData {
-	vec3 v3CameraPosition;
 	uint uiNumPointLights;
 	uint uiUseEmissive;
+	uint uiUseShadows;
+	uint uiUseClusters;
+	// view depth of the first cluster slice and the scale applied to log(depth / near) to find a depth's slice
+	float fClusterNear;
+	float fClusterSliceScale;
+	// size of a cluster's screen tile in pixels
+	vec2 v2ClusterTileSize;
+};
 
+// range of clusterLightIndices holding the lights that overlap a cluster
+struct Cluster {
+	uint uiOffset;
+	uint uiCount;
 };
 
 struct DrawData {
@@ -39,41 +57,76 @@ struct PointLight {
 	vec3 v3Position;
 	vec3 v3Intensity;
 	vec3 v3Falloff;
+	// shadow range, the atlas stores distance to the light linearly over [0, fRadius]
+	float fRadius;
+	// atlas tile of each cube face (+X, -X, +Y, -Y, +Z, -Z) as texel offset (xy) and size (z)
+	uvec4 uv4ShadowTiles[6];
+	mat4 m4FaceViewProj[6];
 };
 
-layout(binding = 0, set = 0) readonly buffer Vertices {
+// every buffer is reached through its device address, the frame's SceneAddresses are pushed with each draw
+layout(std430, buffer_reference, buffer_reference_align = 16) readonly buffer Vertices {
 	Vertex vertices[];
 };
 
-layout(binding = 1, set = 0) readonly buffer Draws {
+layout(std430, buffer_reference, buffer_reference_align = 8) readonly buffer Draws {
 	DrawData draws[];
 };
 
-layout(binding = 2, set = 0) readonly buffer Globals {
+layout(std430, buffer_reference, buffer_reference_align = 16) readonly buffer Globals {
 	GlobalData globals;
 };
 
-// view * model
-layout(binding = 0, set = 1) readonly buffer Transforms {
+layout(std430, buffer_reference, buffer_reference_align = 16) readonly buffer Transforms {
 	Transform transforms[];
 };
 
-layout(binding = 1, set = 1) readonly buffer Materials {
+layout(std430, buffer_reference, buffer_reference_align = 16) readonly buffer Materials {
 	Material materials[];
 };
 
-layout(binding = 2, set = 1) readonly buffer Lights {
+layout(std430, buffer_reference, buffer_reference_align = 16) readonly buffer Lights {
 	PointLight lights[];
 };
 
-layout(set = 0, binding = 3) uniform sampler2D texSampler[];
-layout(set = 0, binding = 3) uniform samplerCube texCubeSampler[];
+layout(std430, buffer_reference, buffer_reference_align = 8) readonly buffer Clusters {
+	Cluster clusters[];
+};
+
+layout(std430, buffer_reference, buffer_reference_align = 4) readonly buffer ClusterLights {
+	uint clusterLightIndices[];
+};
+
+// written by the cpu right before the frame is submitted when late latching, everything shading depends on the camera
+// through is in here so that it all comes from the same pose
+layout(std430, buffer_reference, buffer_reference_align = 16) readonly buffer Camera {
+	mat4 m4CameraViewProjection;
+	vec3 v3CameraPosition;
+	vec3 v3CameraForward;
+};
+
+// must match vkt::SceneAddresses
+layout(std430, buffer_reference, buffer_reference_align = 8) readonly buffer SceneAddresses {
+	Vertices pVertices;
+	Draws pDraws;
+	Globals pGlobals;
+	Transforms pTransforms;
+	Materials pMaterials;
+	Lights pLights;
+	Clusters pClusters;
+	ClusterLights pClusterLights;
+	Camera pCamera;
+};
+
+layout(set = 0, binding = 0) uniform sampler2D shadowAtlas;
 
-layout(set = 1, binding = 3) uniform sampler2D shadowSampler[];
-layout(set = 1, binding = 4) uniform samplerCube cubeShadowSampler[];
+layout(set = 0, binding = 1) uniform sampler2D texSampler[];
+layout(set = 0, binding = 1) uniform samplerCube texCubeSampler[];
 
 layout(push_constant) uniform constants {
-	// orthographic projection * perspective * view
+	// view projection of the shadow atlas face being rendered, the main pass reads m4CameraViewProjection instead
 	mat4 m4ViewProjection;
 	uint uidrawId;
+	uint uiLightId;
+	SceneAddresses pScene;
 }pc;
\ No newline at end of file
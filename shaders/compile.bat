@@ -1,3 +0,0 @@
-C:\VulkanSDK\1.4.313.1\Bin\glslc.exe light.vert -o vert_light.spv -g
-C:\VulkanSDK\1.4.313.1\Bin\glslc.exe light.frag -o frag_light.spv -g
-pause
\ No newline at end of file
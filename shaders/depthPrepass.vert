@@ -0,0 +1,17 @@
+#version 450
+#extension GL_GOOGLE_include_directive: require
+
+#include "common.h"
+
+// must match light.vert's position math exactly, the main pass tests against this depth with VK_COMPARE_OP_EQUAL
+invariant gl_Position;
+
+void main() {
+	SceneAddresses scene = pc.pScene;
+	DrawData dd = scene.pDraws.draws[pc.uidrawId];
+	Vertex vert = scene.pVertices.vertices[gl_VertexIndex];
+	Transform td = scene.pTransforms.transforms[dd.uiTransformIndex];
+
+	vec4 v4Position = td.m4Model * vec4(vert.v3Position, 1.0f);
+	gl_Position = scene.pCamera.m4CameraViewProjection * v4Position;
+}
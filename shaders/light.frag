@@ -7,6 +7,9 @@
 
 #define M_PI 3.1415926535897932384626433832795f
 
+// the atlas stores normalized distances, a constant offset is enough to avoid self-shadowing
+#define SHADOW_BIAS 0.005f
+
 layout(constant_id = 0) const uint uiUseBlinnPhong = 0;
 
 
@@ -22,6 +25,46 @@ vec3 lightFalloff(vec3 v3LightIntensity, vec3 v3Falloff, vec3 v3LightPosition, v
 	return v3LightIntensity / (v3Falloff.x + v3Falloff.y * fDist + v3Falloff.z * fDist * fDist);
 }
 
+// selects the cube face by the major axis of the light to point vector and compares against that face's atlas tile
+float shadowFactor(PointLight light, vec3 v3Position) {
+	vec3 v3LightToPoint = v3Position - light.v3Position;
+	vec3 v3Abs = abs(v3LightToPoint);
+
+	uint uiFace;
+	if (v3Abs.x >= v3Abs.y && v3Abs.x >= v3Abs.z)
+		uiFace = v3LightToPoint.x > 0.0f ? 0u : 1u;
+	else if (v3Abs.y >= v3Abs.z)
+		uiFace = v3LightToPoint.y > 0.0f ? 2u : 3u;
+	else
+		uiFace = v3LightToPoint.z > 0.0f ? 4u : 5u;
+
+	uvec4 uv4Tile = light.uv4ShadowTiles[uiFace];
+
+	// the light wasn't given any tiles in the atlas
+	if (uv4Tile.z == 0u)
+		return 1.0f;
+
+	vec4 v4Clip = light.m4FaceViewProj[uiFace] * vec4(v3Position, 1.0f);
+	vec2 v2TileUV = clamp((v4Clip.xy / v4Clip.w) * 0.5f + 0.5f, 0.0f, 1.0f);
+	ivec2 i2Texel = ivec2(uv4Tile.xy) + min(ivec2(v2TileUV * float(uv4Tile.z)), ivec2(uv4Tile.z - 1u));
+
+	float fOccluderDepth = texelFetch(shadowAtlas, i2Texel, 0).r;
+	float fDepth = clamp(1.0f - length(v3LightToPoint) / light.fRadius, 0.0f, 1.0f);
+
+	return (fDepth + SHADOW_BIAS >= fOccluderDepth) ? 1.0f : 0.0f;
+}
+
+// finds the froxel containing the fragment, screen tiles in x and y and exponential view depth slices in z
+uint clusterIndex(GlobalData globals, vec3 v3CameraPosition, vec3 v3CameraForward, vec3 v3Position) {
+	uvec2 uv2Tile = min(uvec2(gl_FragCoord.xy / globals.v2ClusterTileSize), uvec2(CLUSTER_GRID_X - 1u, CLUSTER_GRID_Y - 1u));
+
+	// everything in front of the first slice belongs to it
+	float fDepth = max(dot(v3Position - v3CameraPosition, v3CameraForward), globals.fClusterNear);
+	uint uiSlice = min(uint(log(fDepth / globals.fClusterNear) * globals.fClusterSliceScale), CLUSTER_GRID_Z - 1u);
+
+	return (uiSlice * CLUSTER_GRID_Y + uv2Tile.y) * CLUSTER_GRID_X + uv2Tile.x;
+}
+
 vec3 blinnPhong(vec3 v3Normal, vec3 v3LightDirection, vec3 v3ViewDirection, vec3 v3LightIrradiance, vec3 v3DiffuseColor, vec3 v3SpecularColor, float fRoughness) {
 
 	vec3 v3HalfVector = normalize(v3ViewDirection + v3LightDirection);
@@ -102,10 +145,13 @@ vec3 GGX(vec3 v3Normal, vec3 v3LightDirection, vec3 v3ViewDirection, vec3 v3Ligh
 }
 
 void main() {
-	DrawData dd = draws[pc.uidrawId];
-	Material md = materials[dd.uiMaterialIndex];
+	SceneAddresses scene = pc.pScene;
+	GlobalData globals = scene.pGlobals.globals;
+	DrawData dd = scene.pDraws.draws[pc.uidrawId];
+	Material md = scene.pMaterials.materials[dd.uiMaterialIndex];
 	
-	vec3 v3ViewDirection = normalize(globals.v3CameraPosition - v3InPosition);
+	vec3 v3CameraPosition = scene.pCamera.v3CameraPosition;
+	vec3 v3ViewDirection = normalize(v3CameraPosition - v3InPosition);
 	vec3 v3Normal = normalize(v3InNormal);
 
 	vec3 v3LightColor = vec3(0.0f);
@@ -114,13 +160,25 @@ void main() {
 	vec3 v3Specular = texture(texSampler[md.uiSpecularTexture], v2InUV).rgb;
 	float fRoughness = texture(texSampler[md.uiRoughnessTexture], v2InUV).r;
 
-	for (uint i = 0; i < globals.uiNumPointLights; ++i) {
-		PointLight light = lights[i];
+	// without clustering every light is shaded
+	uint uiLightOffset = 0u;
+	uint uiLightCount = globals.uiNumPointLights;
+	if (globals.uiUseClusters > 0) {
+		Cluster cluster = scene.pClusters.clusters[clusterIndex(globals, v3CameraPosition, scene.pCamera.v3CameraForward, v3InPosition)];
+		uiLightOffset = cluster.uiOffset;
+		uiLightCount = cluster.uiCount;
+	}
+
+	for (uint i = 0; i < uiLightCount; ++i) {
+		PointLight light = scene.pLights.lights[globals.uiUseClusters > 0 ? scene.pClusterLights.clusterLightIndices[uiLightOffset + i] : i];
 		vec3 v3LightDirection = normalize(light.v3Position - v3InPosition);
 		
 		// compute amount of light falling onto this point
 		vec3 v3LightIrradiance = lightFalloff(light.v3Intensity, light.v3Falloff, light.v3Position, v3InPosition);
 
+		if (globals.uiUseShadows > 0)
+			v3LightIrradiance *= shadowFactor(light, v3InPosition);
+
 		if (uiUseBlinnPhong > 0) {
 			float fRoughnessPhong = (2.0f / (fRoughness * fRoughness)) - 2.0f;
 			v3LightColor += blinnPhong(v3Normal, v3LightDirection, v3ViewDirection, v3LightIrradiance, v3Diffuse, v3Specular, fRoughnessPhong);
@@ -6,13 +6,17 @@ layout (location = 0) out vec3 v3OutPosition;
 layout (location = 1) out vec3 v3OutNormal;
 layout (location = 2) out vec2 v2OutUV;
 
+// the depth pre-pass computes the same position, the main pass' equal depth test relies on both producing identical depth
+invariant gl_Position;
+
 void main() {
-	DrawData dd = draws[pc.uidrawId];
-	Vertex vert = vertices[gl_VertexIndex];
-	Transform td = transforms[dd.uiTransformIndex];
+	SceneAddresses scene = pc.pScene;
+	DrawData dd = scene.pDraws.draws[pc.uidrawId];
+	Vertex vert = scene.pVertices.vertices[gl_VertexIndex];
+	Transform td = scene.pTransforms.transforms[dd.uiTransformIndex];
 
 	vec4 v4Position = td.m4Model * vec4(vert.v3Position, 1.0f);
-	gl_Position = pc.m4ViewProjection * v4Position;
+	gl_Position = scene.pCamera.m4CameraViewProjection * v4Position;
 	v3OutPosition = v4Position.xyz;
 
 	vec4 v4Normal = td.m4ModelInvTr * vec4(vert.v3Normal, 0.0f);
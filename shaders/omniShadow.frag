@@ -4,15 +4,11 @@
 
 #include "common.h"
 
-layout(location = 0) out float outColor;
-
-layout (location = 0) in vec4 inFragWorldPos;
-layout (location = 1) in flat uint inDrawId;
+layout (location = 0) in vec3 v3InPosition;
 
 void main() {
-	
-	// compute distance in world space from fragment world pos to light
-	vec3 lightToFragment = (inFragWorldPos.xyz - lights[pc.lightId].mPos);
+	PointLight light = pc.pScene.pLights.lights[pc.uiLightId];
 
-	outColor = length(lightToFragment);
+	// store the world space distance to the light normalized by its range. reversed so that closer occluders win the depth test
+	gl_FragDepth = clamp(1.0f - distance(v3InPosition, light.v3Position) / light.fRadius, 0.0f, 1.0f);
 }
@@ -1,24 +1,19 @@
 #version 450
-#extension GL_EXT_debug_printf : enable
-#extension GL_EXT_multiview : enable
 #extension GL_EXT_nonuniform_qualifier : require
-#extension GL_ARB_shader_draw_parameters : enable
 #extension GL_GOOGLE_include_directive: require
 
 #include "common.h"
 
-layout(location = 0) out vec4 outVertWorld;
-layout (location = 1) out flat uint outDrawId;
+layout (location = 0) out vec3 v3OutPosition;
 
 void main() {
-	DrawData dd = draws[pc.drawId];
-	Vertex vert = vertices[gl_VertexIndex];
+	SceneAddresses scene = pc.pScene;
+	DrawData dd = scene.pDraws.draws[pc.uidrawId];
+	Vertex vert = scene.pVertices.vertices[gl_VertexIndex];
 
-	vec3 vertPos = vert.position;
+	vec4 v4Position = scene.pTransforms.transforms[dd.uiTransformIndex].m4Model * vec4(vert.v3Position, 1.0f);
 
-	// we choose to perform out lighting computations in camera-space.
-	gl_Position =	lights[pc.lightId].cubeViewProjs[gl_ViewIndex] * transforms[dd.transformIndex].model * vec4(vertPos, 1.0f);
-	outVertWorld = transforms[dd.transformIndex].model * vec4(vertPos, 1.0f);
-
-	//debugPrintfEXT("%f | %f | %f\n", lights[0].mvPos.x, lights[0].mvPos.y, lights[0].mvPos.z);
-}
\ No newline at end of file
+	// m4ViewProjection holds the view projection of the cube face whose atlas tile is being rendered
+	gl_Position = pc.m4ViewProjection * v4Position;
+	v3OutPosition = v4Position.xyz;
+}
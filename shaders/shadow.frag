@@ -1,10 +0,0 @@
-#version 450
-#extension GL_EXT_nonuniform_qualifier : require
-#extension GL_GOOGLE_include_directive: require
-
-#include "common.h"
-
-layout (location = 0) in flat uint inDrawId;
-
-void main() {
-}
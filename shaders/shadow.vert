@@ -1,21 +0,0 @@
-#version 450
-#extension GL_EXT_debug_printf : enable
-#extension GL_EXT_nonuniform_qualifier : require
-#extension GL_ARB_shader_draw_parameters : enable
-#extension GL_GOOGLE_include_directive: require
-
-#include "common.h"
-
-layout (location = 0) out flat uint outDrawId;
-
-void main() {
-	DrawData dd = draws[pc.drawId];
-	Vertex vert = vertices[gl_VertexIndex];
-	Material md = materials[dd.materialIndex];
-
-	vec3 vertPos = vert.position;
-
-	// we choose to perform out lighting computations in camera-space.
-	gl_Position = lights[pc.lightId].viewProj * transforms[dd.transformIndex].model * vec4(vertPos, 1.0f);
-
-}
\ No newline at end of file